@@ -0,0 +1,395 @@
+#include "bc_encode.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	struct Fit_
+	{
+		float lo[4], hi[4];
+	};
+
+	// Fits a line through the texels (first aDims channels) and returns the
+	// extremes of the texels projected onto it.
+	Fit_ fit_principal_axis_( float const aPx[16][4], int aDims )
+	{
+		float mean[4] = {};
+		for( int i = 0; i < 16; ++i )
+			for( int c = 0; c < aDims; ++c )
+				mean[c] += aPx[i][c] / 16.f;
+
+		float cov[4][4] = {};
+		for( int i = 0; i < 16; ++i )
+		{
+			for( int a = 0; a < aDims; ++a )
+				for( int b = 0; b < aDims; ++b )
+					cov[a][b] += (aPx[i][a]-mean[a]) * (aPx[i][b]-mean[b]);
+		}
+
+		// Power iteration
+		float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+		for( int iter = 0; iter < 8; ++iter )
+		{
+			float next[4] = {};
+			for( int a = 0; a < aDims; ++a )
+				for( int b = 0; b < aDims; ++b )
+					next[a] += cov[a][b] * axis[b];
+
+			float len = 0.f;
+			for( int a = 0; a < aDims; ++a )
+				len += next[a]*next[a];
+			len = std::sqrt( len );
+
+			if( len < 1e-6f )
+				break;
+
+			for( int a = 0; a < aDims; ++a )
+				axis[a] = next[a] / len;
+		}
+
+		float tmin = std::numeric_limits<float>::max();
+		float tmax = std::numeric_limits<float>::lowest();
+		for( int i = 0; i < 16; ++i )
+		{
+			float t = 0.f;
+			for( int c = 0; c < aDims; ++c )
+				t += (aPx[i][c]-mean[c]) * axis[c];
+			tmin = std::min( tmin, t );
+			tmax = std::max( tmax, t );
+		}
+
+		Fit_ ret{};
+		for( int c = 0; c < aDims; ++c )
+		{
+			ret.lo[c] = std::clamp( mean[c] + axis[c]*tmin, 0.f, 255.f );
+			ret.hi[c] = std::clamp( mean[c] + axis[c]*tmax, 0.f, 255.f );
+		}
+		return ret;
+	}
+
+	// Least-squares endpoints given per-texel weights (weight of endpoint 1)
+	void refine_endpoints_( float const aPx[16][4], int aDims, float const aWeights[16], float aLo[4], float aHi[4] )
+	{
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ax[4] = {}, bx[4] = {};
+		for( int i = 0; i < 16; ++i )
+		{
+			float const b = aWeights[i];
+			float const a = 1.f - b;
+			aa += a*a; ab += a*b; bb += b*b;
+			for( int c = 0; c < aDims; ++c )
+			{
+				ax[c] += a * aPx[i][c];
+				bx[c] += b * aPx[i][c];
+			}
+		}
+
+		float const det = aa*bb - ab*ab;
+		if( std::abs( det ) < 1e-6f )
+			return;
+
+		for( int c = 0; c < aDims; ++c )
+		{
+			aLo[c] = std::clamp( (bb*ax[c] - ab*bx[c]) / det, 0.f, 255.f );
+			aHi[c] = std::clamp( (aa*bx[c] - ab*ax[c]) / det, 0.f, 255.f );
+		}
+	}
+
+	void to_float_( std::uint8_t const aRgba[64], float aPx[16][4] )
+	{
+		for( int i = 0; i < 16; ++i )
+			for( int c = 0; c < 4; ++c )
+				aPx[i][c] = aRgba[i*4+c];
+	}
+
+	// BC1 color block ------------------------------------------------------
+
+	std::uint16_t pack565_( float const aColor[4] )
+	{
+		auto const r = unsigned(std::lround( aColor[0] * 31.f / 255.f ));
+		auto const g = unsigned(std::lround( aColor[1] * 63.f / 255.f ));
+		auto const b = unsigned(std::lround( aColor[2] * 31.f / 255.f ));
+		return std::uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void unpack565_( std::uint16_t aPacked, float aColor[3] )
+	{
+		unsigned const r = (aPacked >> 11) & 31, g = (aPacked >> 5) & 63, b = aPacked & 31;
+		aColor[0] = float((r << 3) | (r >> 2));
+		aColor[1] = float((g << 2) | (g >> 4));
+		aColor[2] = float((b << 3) | (b >> 2));
+	}
+
+	// Encodes with the given (unquantized) endpoints. Returns the error.
+	float encode_bc1_endpoints_( float const aPx[16][4], float const aLo[4], float const aHi[4], std::uint8_t aOut[8], float aWeights[16] )
+	{
+		std::uint16_t c0 = pack565_( aHi ), c1 = pack565_( aLo );
+		if( c0 < c1 )
+			std::swap( c0, c1 );
+
+		float palette[4][3];
+		unpack565_( c0, palette[0] );
+		unpack565_( c1, palette[1] );
+		for( int c = 0; c < 3; ++c )
+		{
+			palette[2][c] = (2.f*palette[0][c] + palette[1][c]) / 3.f;
+			palette[3][c] = (palette[0][c] + 2.f*palette[1][c]) / 3.f;
+		}
+
+		// Weight of endpoint c1 for each index, for refinement
+		static constexpr float kWeights[4] = { 0.f, 1.f, 1.f/3.f, 2.f/3.f };
+
+		std::uint32_t bits = 0;
+		float error = 0.f;
+		for( int i = 0; i < 16; ++i )
+		{
+			int best = 0;
+			float bestErr = std::numeric_limits<float>::max();
+			int const candidates = c0 == c1 ? 1 : 4;
+			for( int k = 0; k < candidates; ++k )
+			{
+				float e = 0.f;
+				for( int c = 0; c < 3; ++c )
+					e += (aPx[i][c]-palette[k][c]) * (aPx[i][c]-palette[k][c]);
+				if( e < bestErr )
+				{
+					bestErr = e;
+					best = k;
+				}
+			}
+
+			bits |= std::uint32_t(best) << (2*i);
+			error += bestErr;
+			aWeights[i] = kWeights[best];
+		}
+
+		aOut[0] = std::uint8_t(c0 & 0xff);
+		aOut[1] = std::uint8_t(c0 >> 8);
+		aOut[2] = std::uint8_t(c1 & 0xff);
+		aOut[3] = std::uint8_t(c1 >> 8);
+		for( int i = 0; i < 4; ++i )
+			aOut[4+i] = std::uint8_t(bits >> (8*i));
+
+		return error;
+	}
+
+	void encode_bc1_color_( float const aPx[16][4], std::uint8_t aOut[8] )
+	{
+		auto fit = fit_principal_axis_( aPx, 3 );
+
+		float weights[16];
+		float const error = encode_bc1_endpoints_( aPx, fit.lo, fit.hi, aOut, weights );
+
+		// The weights are those of c1 relative to c0. The order of the
+		// endpoints passed to encode_bc1_endpoints_() does not matter, as it
+		// sorts them anyway.
+		float e0[4], e1[4];
+		std::copy( fit.hi, fit.hi+4, e0 );
+		std::copy( fit.lo, fit.lo+4, e1 );
+		refine_endpoints_( aPx, 3, weights, e0, e1 );
+
+		std::uint8_t refined[8];
+		float refinedWeights[16];
+		if( encode_bc1_endpoints_( aPx, e0, e1, refined, refinedWeights ) < error )
+			std::memcpy( aOut, refined, 8 );
+	}
+
+	// BC4-style alpha block ------------------------------------------------
+
+	void encode_alpha_( float const aPx[16][4], std::uint8_t aOut[8] )
+	{
+		float amin = 255.f, amax = 0.f;
+		for( int i = 0; i < 16; ++i )
+		{
+			amin = std::min( amin, aPx[i][3] );
+			amax = std::max( amax, aPx[i][3] );
+		}
+
+		auto const a0 = unsigned(amax), a1 = unsigned(amin);
+		aOut[0] = std::uint8_t(a0);
+		aOut[1] = std::uint8_t(a1);
+
+		float palette[8] = { float(a0), float(a1) };
+		for( int k = 1; k < 7; ++k )
+			palette[k+1] = float(((7-k)*a0 + k*a1) / 7);
+
+		std::uint64_t bits = 0;
+		if( a0 != a1 )
+		{
+			for( int i = 0; i < 16; ++i )
+			{
+				int best = 0;
+				float bestErr = std::numeric_limits<float>::max();
+				for( int k = 0; k < 8; ++k )
+				{
+					float const e = std::abs( aPx[i][3] - palette[k] );
+					if( e < bestErr )
+					{
+						bestErr = e;
+						best = k;
+					}
+				}
+				bits |= std::uint64_t(best) << (3*i);
+			}
+		}
+
+		for( int i = 0; i < 6; ++i )
+			aOut[2+i] = std::uint8_t(bits >> (8*i));
+	}
+
+	// BC7 mode 6 -----------------------------------------------------------
+
+	constexpr int kBc7Weights4_[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Mode6_
+	{
+		unsigned q[2][4]; // 7-bit endpoints
+		unsigned p[2];
+		int index[16];
+		float error;
+	};
+
+	Bc7Mode6_ encode_bc7_mode6_( float const aPx[16][4], float const aLo[4], float const aHi[4], unsigned aP0, unsigned aP1 )
+	{
+		Bc7Mode6_ ret{};
+		ret.p[0] = aP0;
+		ret.p[1] = aP1;
+
+		int e[2][4];
+		for( int c = 0; c < 4; ++c )
+		{
+			float const ends[2] = { aLo[c], aHi[c] };
+			for( int j = 0; j < 2; ++j )
+			{
+				auto const q = std::clamp( long(std::lround( (ends[j] - float(ret.p[j])) / 2.f )), 0l, 127l );
+				ret.q[j][c] = unsigned(q);
+				e[j][c] = int((q << 1) | ret.p[j]);
+			}
+		}
+
+		float palette[16][4];
+		for( int k = 0; k < 16; ++k )
+			for( int c = 0; c < 4; ++c )
+				palette[k][c] = float(((64-kBc7Weights4_[k])*e[0][c] + kBc7Weights4_[k]*e[1][c] + 32) >> 6);
+
+		for( int i = 0; i < 16; ++i )
+		{
+			float bestErr = std::numeric_limits<float>::max();
+			for( int k = 0; k < 16; ++k )
+			{
+				float err = 0.f;
+				for( int c = 0; c < 4; ++c )
+					err += (aPx[i][c]-palette[k][c]) * (aPx[i][c]-palette[k][c]);
+				if( err < bestErr )
+				{
+					bestErr = err;
+					ret.index[i] = k;
+				}
+			}
+			ret.error += bestErr;
+		}
+
+		return ret;
+	}
+
+	Bc7Mode6_ best_bc7_mode6_( float const aPx[16][4], float const aLo[4], float const aHi[4] )
+	{
+		Bc7Mode6_ best{};
+		best.error = std::numeric_limits<float>::max();
+		for( unsigned pbits = 0; pbits < 4; ++pbits )
+		{
+			auto const candidate = encode_bc7_mode6_( aPx, aLo, aHi, pbits & 1, pbits >> 1 );
+			if( candidate.error < best.error )
+				best = candidate;
+		}
+		return best;
+	}
+
+	struct BitWriter_
+	{
+		std::uint8_t* out;
+		unsigned pos = 0;
+
+		void put( unsigned aValue, unsigned aBits )
+		{
+			for( unsigned i = 0; i < aBits; ++i, ++pos )
+			{
+				if( (aValue >> i) & 1 )
+					out[pos/8] |= std::uint8_t(1u << (pos%8));
+			}
+		}
+	};
+}
+
+void encode_bc1_block( std::uint8_t const aRgba[64], std::uint8_t aOut[8] )
+{
+	float px[16][4];
+	to_float_( aRgba, px );
+	encode_bc1_color_( px, aOut );
+}
+
+void encode_bc3_block( std::uint8_t const aRgba[64], std::uint8_t aOut[16] )
+{
+	float px[16][4];
+	to_float_( aRgba, px );
+
+	// BC3 = BC4-style alpha block followed by a BC1 color block, which is
+	// always decoded in four-color mode. encode_bc1_color_() only produces
+	// c0 <= c1 if c0 == c1, in which case all indices are zero.
+	encode_alpha_( px, aOut );
+	encode_bc1_color_( px, aOut+8 );
+}
+
+void encode_bc7_block( std::uint8_t const aRgba[64], std::uint8_t aOut[16] )
+{
+	float px[16][4];
+	to_float_( aRgba, px );
+
+	auto const fit = fit_principal_axis_( px, 4 );
+	auto best = best_bc7_mode6_( px, fit.lo, fit.hi );
+
+	// One least-squares refinement of the endpoints
+	{
+		float weights[16];
+		for( int i = 0; i < 16; ++i )
+			weights[i] = kBc7Weights4_[best.index[i]] / 64.f;
+
+		float lo[4], hi[4];
+		std::copy( fit.lo, fit.lo+4, lo );
+		std::copy( fit.hi, fit.hi+4, hi );
+		refine_endpoints_( px, 4, weights, lo, hi );
+
+		auto const refined = best_bc7_mode6_( px, lo, hi );
+		if( refined.error < best.error )
+			best = refined;
+	}
+
+	// The MSB of the first index is implicit (zero). Swap endpoints if
+	// necessary.
+	if( best.index[0] & 8 )
+	{
+		for( int c = 0; c < 4; ++c )
+			std::swap( best.q[0][c], best.q[1][c] );
+		std::swap( best.p[0], best.p[1] );
+		for( int i = 0; i < 16; ++i )
+			best.index[i] = 15 - best.index[i];
+	}
+
+	std::memset( aOut, 0, 16 );
+	BitWriter_ bw{ aOut };
+	bw.put( 1u << 6, 7 ); // mode 6
+	for( int c = 0; c < 4; ++c )
+	{
+		bw.put( best.q[0][c], 7 );
+		bw.put( best.q[1][c], 7 );
+	}
+	bw.put( best.p[0], 1 );
+	bw.put( best.p[1], 1 );
+	bw.put( unsigned(best.index[0]), 3 );
+	for( int i = 1; i < 16; ++i )
+		bw.put( unsigned(best.index[i]), 4 );
+}
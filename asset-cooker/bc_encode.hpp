@@ -0,0 +1,23 @@
+#ifndef BC_ENCODE_HPP_3F6A1D8E_72B4_4C59_9E0D_5B8C2A7F41E6
+#define BC_ENCODE_HPP_3F6A1D8E_72B4_4C59_9E0D_5B8C2A7F41E6
+
+#include <cstdint>
+
+/* Block compression encoders
+ *
+ * Each function compresses one 4x4 block of RGBA8 texels (row-major, 64
+ * bytes) into the corresponding BCn block. The encoders work directly on
+ * the stored (sRGB encoded) values, like the hardware decoders do.
+ *
+ * These aim for reasonable quality at a reasonable speed, not for the best
+ * possible quality:
+ *  - BC1 and the color part of BC3 fit endpoints along the principal axis
+ *    of the block's colors, followed by one least-squares refinement.
+ *  - BC7 uses mode 6 only (single subset, RGBA endpoints, 4-bit indices),
+ *    trying all four p-bit combinations.
+ */
+void encode_bc1_block( std::uint8_t const aRgba[64], std::uint8_t aOut[8] );
+void encode_bc3_block( std::uint8_t const aRgba[64], std::uint8_t aOut[16] );
+void encode_bc7_block( std::uint8_t const aRgba[64], std::uint8_t aOut[16] );
+
+#endif // BC_ENCODE_HPP_3F6A1D8E_72B4_4C59_9E0D_5B8C2A7F41E6
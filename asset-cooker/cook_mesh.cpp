@@ -0,0 +1,766 @@
+#include "cook_mesh.hpp"
+
+#include <limits>
+#include <utility>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <rapidobj/rapidobj.hpp>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+
+namespace
+{
+	// Size of the simulated post-transform cache used by Tipsify. Actual
+	// hardware varies; 16 is the usual compromise.
+	constexpr std::size_t kVertexCacheSize_ = 16;
+
+	// Grid resolutions (cells along the longest axis) for the LODs. A LOD is
+	// dropped if it does not remove at least 20% of the previous level's
+	// triangles.
+	constexpr std::size_t kLodGrids_[] = { 128, 48, 16 };
+	constexpr float kLodMinReduction_ = 0.8f;
+
+	struct Vertex_
+	{
+		float position[3];
+		float color[3];
+		float normal[3];
+		float texcoord[2];
+	};
+
+	struct VertexHash_
+	{
+		std::size_t operator() (Vertex_ const& aVertex) const noexcept
+		{
+			return std::size_t(fnv1a64( &aVertex, sizeof(Vertex_) ));
+		}
+	};
+	struct VertexEqual_
+	{
+		bool operator() (Vertex_ const& aA, Vertex_ const& aB) const noexcept
+		{
+			return 0 == std::memcmp( &aA, &aB, sizeof(Vertex_) );
+		}
+	};
+
+	struct MeshletRange_
+	{
+		std::uint32_t firstIndex;
+		std::uint32_t indexCount;
+	};
+
+	std::vector<std::uint32_t> tipsify_( std::vector<std::uint32_t> const&, std::size_t );
+	std::vector<std::uint32_t> build_meshlets_( std::vector<Vertex_> const&, std::vector<std::uint32_t> const&, std::vector<MeshletRange_>& );
+	CookedMeshlet meshlet_bounds_( std::vector<Vertex_> const&, std::vector<std::uint32_t> const&, MeshletRange_ const& );
+	std::vector<std::uint32_t> cluster_lod_( std::vector<Vertex_> const&, std::vector<std::uint32_t> const&, std::size_t, float& );
+
+	std::string directory_of_( std::string const& aPath )
+	{
+		auto const slash = aPath.find_last_of( "/\\" );
+		return std::string::npos == slash ? std::string() : aPath.substr( 0, slash+1 );
+	}
+}
+
+std::vector<std::string> mesh_dependencies( std::string const& aObjPath )
+{
+	std::vector<std::string> ret{ aObjPath };
+
+	std::ifstream fin( aObjPath );
+	if( !fin )
+		throw Error( "mesh_dependencies(): unable to open '%s'", aObjPath.c_str() );
+
+	auto const dir = directory_of_( aObjPath );
+
+	std::string line;
+	while( std::getline( fin, line ) )
+	{
+		if( 0 != line.compare( 0, 7, "mtllib " ) )
+			continue;
+
+		auto name = line.substr( 7 );
+		while( !name.empty() && std::isspace( static_cast<unsigned char>(name.back()) ) )
+			name.pop_back();
+
+		if( !name.empty() )
+			ret.emplace_back( dir + name );
+	}
+
+	return ret;
+}
+
+void cook_mesh( std::string const& aObjPath, std::string const& aOutPath )
+{
+	auto result = rapidobj::ParseFile( aObjPath );
+	if( result.error )
+		throw Error( "Unable to load OBJ file '%s': %s", aObjPath.c_str(), result.error.code.message().c_str() );
+
+	rapidobj::Triangulate( result );
+
+	// Expand into unique vertices. This mirrors load_wavefront_obj() in the
+	// main program, so that cooked and uncooked meshes look the same.
+	std::vector<Vertex_> vertices;
+	std::vector<std::uint32_t> indices;
+	std::unordered_map<Vertex_,std::uint32_t,VertexHash_,VertexEqual_> unique;
+
+	bool hasTexcoords = false;
+	auto const& attribs = result.attributes;
+
+	for( auto const& shape : result.shapes )
+	{
+		for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
+		{
+			auto const& idx = shape.mesh.indices[i];
+
+			Vertex_ v{};
+			for( int j = 0; j < 3; ++j )
+				v.position[j] = attribs.positions[idx.position_index*3+j];
+
+			if( idx.normal_index >= 0 )
+			{
+				for( int j = 0; j < 3; ++j )
+					v.normal[j] = attribs.normals[idx.normal_index*3+j];
+			}
+			else
+			{
+				v.normal[1] = 1.f;
+			}
+
+			if( idx.texcoord_index >= 0 )
+			{
+				hasTexcoords = true;
+				v.texcoord[0] = attribs.texcoords[idx.texcoord_index*2+0];
+				v.texcoord[1] = attribs.texcoords[idx.texcoord_index*2+1];
+			}
+
+			auto const matId = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[i/3];
+			if( matId >= 0 )
+			{
+				auto const& mat = result.materials[matId];
+				for( int j = 0; j < 3; ++j )
+					v.color[j] = mat.ambient[j];
+			}
+
+			auto const [it, inserted] = unique.emplace( v, std::uint32_t(vertices.size()) );
+			if( inserted )
+				vertices.emplace_back( v );
+
+			indices.emplace_back( it->second );
+		}
+	}
+
+	if( indices.empty() )
+		throw Error( "cook_mesh(): '%s' contains no triangles", aObjPath.c_str() );
+
+	// Reorder triangles for the vertex cache, then group them into meshlets.
+	// Meshlets are compact patches, so the order within them is still cache
+	// friendly. Finally, reorder the vertices in the order in which they are
+	// first referenced.
+	indices = tipsify_( indices, vertices.size() );
+
+	std::vector<MeshletRange_> meshletRanges;
+	indices = build_meshlets_( vertices, indices, meshletRanges );
+
+	std::vector<std::uint32_t> remap( vertices.size(), ~std::uint32_t(0) );
+	std::vector<Vertex_> ordered;
+	ordered.reserve( vertices.size() );
+	for( auto& index : indices )
+	{
+		if( ~std::uint32_t(0) == remap[index] )
+		{
+			remap[index] = std::uint32_t(ordered.size());
+			ordered.emplace_back( vertices[index] );
+		}
+		index = remap[index];
+	}
+	vertices = std::move(ordered);
+
+	// Bounds
+	CookedMeshHeader header{};
+	header.magic = kCookedMeshMagic;
+	header.version = kCookedMeshVersion;
+	header.vertexCount = std::uint32_t(vertices.size());
+	header.hasTexcoords = hasTexcoords ? 1 : 0;
+
+	for( int j = 0; j < 3; ++j )
+	{
+		header.boundsMin[j] = std::numeric_limits<float>::max();
+		header.boundsMax[j] = std::numeric_limits<float>::lowest();
+	}
+	for( auto const& v : vertices )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			header.boundsMin[j] = std::min( header.boundsMin[j], v.position[j] );
+			header.boundsMax[j] = std::max( header.boundsMax[j], v.position[j] );
+		}
+	}
+
+	float radius2 = 0.f;
+	for( int j = 0; j < 3; ++j )
+		header.sphere[j] = 0.5f * (header.boundsMin[j] + header.boundsMax[j]);
+	for( auto const& v : vertices )
+	{
+		float d2 = 0.f;
+		for( int j = 0; j < 3; ++j )
+			d2 += (v.position[j]-header.sphere[j]) * (v.position[j]-header.sphere[j]);
+		radius2 = std::max( radius2, d2 );
+	}
+	header.sphere[3] = std::sqrt( radius2 );
+
+	// Meshlet bounds, for culling at runtime
+	std::vector<CookedMeshlet> meshlets;
+	meshlets.reserve( meshletRanges.size() );
+	for( auto const& range : meshletRanges )
+		meshlets.emplace_back( meshlet_bounds_( vertices, indices, range ) );
+
+	header.meshletCount = std::uint32_t(meshlets.size());
+
+	// LODs. All LODs share the vertex array; each has its own index range.
+	std::vector<std::uint32_t> allIndices = indices;
+	header.lods[0] = { 0, std::uint32_t(indices.size()), 0.f };
+	header.lodCount = 1;
+
+	std::size_t previousCount = indices.size();
+	for( auto const grid : kLodGrids_ )
+	{
+		if( header.lodCount == kCookedMaxLods )
+			break;
+
+		float error = 0.f;
+		auto lod = cluster_lod_( vertices, indices, grid, error );
+		if( lod.empty() )
+			break;
+		if( float(lod.size()) > kLodMinReduction_ * float(previousCount) )
+			continue;
+
+		lod = tipsify_( lod, vertices.size() );
+
+		header.lods[header.lodCount++] = { std::uint32_t(allIndices.size()), std::uint32_t(lod.size()), error };
+		allIndices.insert( allIndices.end(), lod.begin(), lod.end() );
+		previousCount = lod.size();
+	}
+
+	header.indexCount = std::uint32_t(allIndices.size());
+
+	// Layout: header, then each array aligned to 16 bytes
+	auto align_ = [] (std::uint64_t aOffset) { return (aOffset + 15) & ~std::uint64_t(15); };
+
+	std::uint64_t const vec3Bytes = vertices.size() * 3 * sizeof(float);
+	std::uint64_t const vec2Bytes = vertices.size() * 2 * sizeof(float);
+
+	header.positionsOffset = align_( sizeof(CookedMeshHeader) );
+	header.colorsOffset = align_( header.positionsOffset + vec3Bytes );
+	header.normalsOffset = align_( header.colorsOffset + vec3Bytes );
+	header.texcoordsOffset = align_( header.normalsOffset + vec3Bytes );
+	header.indicesOffset = align_( header.texcoordsOffset + (hasTexcoords ? vec2Bytes : 0) );
+	header.meshletsOffset = align_( header.indicesOffset + allIndices.size()*sizeof(std::uint32_t) );
+
+	std::vector<std::uint8_t> blob( header.meshletsOffset + meshlets.size()*sizeof(CookedMeshlet) );
+	std::memcpy( blob.data(), &header, sizeof(header) );
+
+	auto* positions = reinterpret_cast<float*>(blob.data() + header.positionsOffset);
+	auto* colors = reinterpret_cast<float*>(blob.data() + header.colorsOffset);
+	auto* normals = reinterpret_cast<float*>(blob.data() + header.normalsOffset);
+	auto* texcoords = reinterpret_cast<float*>(blob.data() + header.texcoordsOffset);
+	for( std::size_t i = 0; i < vertices.size(); ++i )
+	{
+		std::memcpy( positions + i*3, vertices[i].position, 3*sizeof(float) );
+		std::memcpy( colors + i*3, vertices[i].color, 3*sizeof(float) );
+		std::memcpy( normals + i*3, vertices[i].normal, 3*sizeof(float) );
+		if( hasTexcoords )
+			std::memcpy( texcoords + i*2, vertices[i].texcoord, 2*sizeof(float) );
+	}
+	std::memcpy( blob.data() + header.indicesOffset, allIndices.data(), allIndices.size()*sizeof(std::uint32_t) );
+	std::memcpy( blob.data() + header.meshletsOffset, meshlets.data(), meshlets.size()*sizeof(CookedMeshlet) );
+
+	write_file_bytes( aOutPath.c_str(), blob.data(), blob.size() );
+
+	std::printf( "  %zu vertices, %zu triangles, %u LOD(s), %u meshlets\n", vertices.size(), indices.size()/3, header.lodCount, header.meshletCount );
+}
+
+namespace
+{
+	/* Tipsify: fast, cache-size aware triangle reordering.
+	 *
+	 * See Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+	 * Locality and Reduced Overdraw", SIGGRAPH 2007. The algorithm fans
+	 * around a vertex, emitting all its remaining triangles, and then picks
+	 * the next fanning vertex among the ones that are likely to still be in
+	 * the cache. Runs in linear time.
+	 */
+	std::vector<std::uint32_t> tipsify_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount )
+	{
+		auto const triCount = aIndices.size() / 3;
+
+		// Vertex-triangle adjacency (CSR)
+		std::vector<std::uint32_t> live( aVertexCount, 0 );
+		for( auto const index : aIndices )
+			++live[index];
+
+		std::vector<std::uint32_t> adjOffset( aVertexCount+1, 0 );
+		for( std::size_t v = 0; v < aVertexCount; ++v )
+			adjOffset[v+1] = adjOffset[v] + live[v];
+
+		std::vector<std::uint32_t> adjacency( aIndices.size() );
+		{
+			std::vector<std::uint32_t> fill( adjOffset.begin(), adjOffset.end()-1 );
+			for( std::size_t i = 0; i < aIndices.size(); ++i )
+				adjacency[fill[aIndices[i]]++] = std::uint32_t(i / 3);
+		}
+
+		std::vector<std::uint32_t> cacheTime( aVertexCount, 0 );
+		std::vector<bool> emitted( triCount, false );
+		std::vector<std::uint32_t> deadEnd;
+		std::vector<std::uint32_t> candidates;
+
+		std::vector<std::uint32_t> ret;
+		ret.reserve( aIndices.size() );
+
+		std::uint32_t timestamp = std::uint32_t(kVertexCacheSize_) + 1;
+		std::size_t cursor = 0;
+
+		auto next_live_ = [&] () -> std::int64_t {
+			while( !deadEnd.empty() )
+			{
+				auto const d = deadEnd.back();
+				deadEnd.pop_back();
+				if( live[d] > 0 )
+					return d;
+			}
+			for( ; cursor < aVertexCount; ++cursor )
+			{
+				if( live[cursor] > 0 )
+					return std::int64_t(cursor);
+			}
+			return -1;
+		};
+
+		std::int64_t fan = next_live_();
+		while( fan >= 0 )
+		{
+			candidates.clear();
+
+			for( auto a = adjOffset[fan]; a < adjOffset[fan+1]; ++a )
+			{
+				auto const t = adjacency[a];
+				if( emitted[t] )
+					continue;
+
+				for( int k = 0; k < 3; ++k )
+				{
+					auto const v = aIndices[t*3+k];
+					ret.emplace_back( v );
+					deadEnd.emplace_back( v );
+					candidates.emplace_back( v );
+					--live[v];
+
+					if( timestamp - cacheTime[v] > kVertexCacheSize_ )
+						cacheTime[v] = timestamp++;
+				}
+
+				emitted[t] = true;
+			}
+
+			// Pick the candidate that will stay in the cache the longest
+			// while still having triangles left.
+			std::int64_t best = -1;
+			std::int64_t bestPriority = -1;
+			for( auto const v : candidates )
+			{
+				if( 0 == live[v] )
+					continue;
+
+				std::int64_t priority = 0;
+				if( timestamp - cacheTime[v] + 2*live[v] <= kVertexCacheSize_ )
+					priority = timestamp - cacheTime[v];
+
+				if( priority > bestPriority )
+				{
+					best = v;
+					bestPriority = priority;
+				}
+			}
+
+			fan = best >= 0 ? best : next_live_();
+		}
+
+		return ret;
+	}
+
+	/* Meshlets: greedy clustering of adjacent triangles
+	 *
+	 * Grows one meshlet at a time, up to kCookedMeshletMaxTriangles triangles
+	 * and kCookedMeshletMaxVertices vertices. The next triangle is picked
+	 * among those that share a vertex with the meshlet, by topology first
+	 * (see priority_ below; similar to meshoptimizer's), and then the one
+	 * closest to the meshlet's centroid, which keeps meshlets compact (tight
+	 * bounding spheres). A meshlet is cut short if no neighbouring triangle
+	 * fits. New meshlets start next to the previous one if possible, else at
+	 * the first triangle left in the input order.
+	 */
+	std::vector<std::uint32_t> build_meshlets_( std::vector<Vertex_> const& aVertices, std::vector<std::uint32_t> const& aIndices, std::vector<MeshletRange_>& aRanges )
+	{
+		auto const triCount = aIndices.size() / 3;
+
+		// Vertex-triangle adjacency (CSR), as in tipsify_()
+		std::vector<std::uint32_t> adjOffset( aVertices.size()+1, 0 );
+		for( auto const index : aIndices )
+			++adjOffset[index+1];
+		for( std::size_t v = 0; v < aVertices.size(); ++v )
+			adjOffset[v+1] += adjOffset[v];
+
+		std::vector<std::uint32_t> adjacency( aIndices.size() );
+		{
+			std::vector<std::uint32_t> fill( adjOffset.begin(), adjOffset.end()-1 );
+			for( std::size_t i = 0; i < aIndices.size(); ++i )
+				adjacency[fill[aIndices[i]]++] = std::uint32_t(i / 3);
+		}
+
+		std::vector<float> centroids( triCount * 3 );
+		for( std::size_t t = 0; t < triCount; ++t )
+		{
+			for( int j = 0; j < 3; ++j )
+			{
+				centroids[t*3+j] = (aVertices[aIndices[t*3+0]].position[j]
+					+ aVertices[aIndices[t*3+1]].position[j]
+					+ aVertices[aIndices[t*3+2]].position[j]) / 3.f;
+			}
+		}
+
+		std::vector<bool> emitted( triCount, false );
+		std::vector<std::uint32_t> meshletOf( aVertices.size(), ~std::uint32_t(0) );
+		std::vector<std::uint32_t> candidates;
+
+		// Triangles left per vertex
+		std::vector<std::uint32_t> live( aVertices.size() );
+		for( std::size_t v = 0; v < aVertices.size(); ++v )
+			live[v] = adjOffset[v+1] - adjOffset[v];
+
+		auto live_around_ = [&] (std::uint32_t aTri) {
+			return live[aIndices[aTri*3+0]] + live[aIndices[aTri*3+1]] + live[aIndices[aTri*3+2]];
+		};
+
+		std::vector<std::uint32_t> ret;
+		ret.reserve( aIndices.size() );
+		aRanges.clear();
+
+		std::size_t cursor = 0;
+		std::size_t remaining = triCount;
+		while( remaining > 0 )
+		{
+			auto const meshlet = std::uint32_t(aRanges.size());
+			aRanges.push_back( { std::uint32_t(ret.size()), 0 } );
+
+			std::size_t triangles = 0, vertices = 0;
+			float sum[3] = {};
+
+			// Lower is better: triangles that add no vertices, then those
+			// that finish off a vertex (which would otherwise be left as a
+			// sliver for a later meshlet), then by the vertices they add
+			auto priority_ = [&] (std::uint32_t aTri) {
+				std::size_t added = 0;
+				bool finishes = false;
+				for( int k = 0; k < 3; ++k )
+				{
+					auto const v = aIndices[aTri*3+k];
+					if( meshlet != meshletOf[v] )
+						++added;
+					if( 1 == live[v] )
+						finishes = true;
+				}
+
+				std::size_t const priority = 0 == added ? 0 : (finishes ? 1 : 1 + added);
+				return std::make_pair( priority, added );
+			};
+
+			// Seed: of the triangles left over from the previous meshlet's
+			// neighbours, the one with the fewest triangles around it, i.e.,
+			// next to the finished part of the mesh. Else the first triangle
+			// left.
+			std::int64_t next = -1;
+			for( auto const t : candidates )
+			{
+				if( !emitted[t] && (next < 0 || live_around_( t ) < live_around_( std::uint32_t(next) )) )
+					next = t;
+			}
+			if( next < 0 )
+			{
+				while( emitted[cursor] )
+					++cursor;
+				next = std::int64_t(cursor);
+			}
+
+			candidates.clear();
+			while( next >= 0 )
+			{
+				auto const tri = std::uint32_t(next);
+				for( int k = 0; k < 3; ++k )
+				{
+					auto const v = aIndices[tri*3+k];
+					ret.emplace_back( v );
+					--live[v];
+
+					if( meshlet != meshletOf[v] )
+					{
+						meshletOf[v] = meshlet;
+						++vertices;
+
+						for( auto a = adjOffset[v]; a < adjOffset[v+1]; ++a )
+						{
+							if( !emitted[adjacency[a]] && adjacency[a] != tri )
+								candidates.emplace_back( adjacency[a] );
+						}
+					}
+				}
+
+				emitted[tri] = true;
+				--remaining;
+				++triangles;
+				for( int j = 0; j < 3; ++j )
+					sum[j] += centroids[tri*3+j];
+
+				if( triangles == kCookedMeshletMaxTriangles )
+					break;
+
+				// Best neighbour that still fits. Emitted triangles are
+				// dropped from the candidates along the way.
+				next = -1;
+				std::size_t bestPriority = 0;
+				float bestDist = 0.f;
+				for( std::size_t c = 0; c < candidates.size(); )
+				{
+					auto const t = candidates[c];
+					if( emitted[t] )
+					{
+						candidates[c] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					++c;
+
+					auto const [priority, added] = priority_( t );
+					if( vertices + added > kCookedMeshletMaxVertices )
+						continue;
+					if( next >= 0 && priority > bestPriority )
+						continue;
+
+					float d2 = 0.f;
+					for( int j = 0; j < 3; ++j )
+					{
+						auto const d = centroids[t*3+j] - sum[j] / float(triangles);
+						d2 += d*d;
+					}
+
+					if( next < 0 || priority < bestPriority || d2 < bestDist )
+					{
+						next = t;
+						bestPriority = priority;
+						bestDist = d2;
+					}
+				}
+			}
+
+			aRanges.back().indexCount = std::uint32_t(ret.size()) - aRanges.back().firstIndex;
+		}
+
+		return ret;
+	}
+
+	/* Meshlet bounds
+	 *
+	 * The bounding sphere is centered on the meshlet's bounding box (as the
+	 * mesh's sphere). The normal cone's axis is the mean of the triangle
+	 * normals; its half angle that of the normal furthest from the axis.
+	 * At runtime, a meshlet is back-facing if, for a camera at c,
+	 *
+	 *   dot(center - c, axis) >= sin(half angle) * |center - c| + radius
+	 *
+	 * i.e., every direction from the camera into the sphere is within 90
+	 * degrees minus the half angle of the axis (see assets/meshlets.comp).
+	 */
+	CookedMeshlet meshlet_bounds_( std::vector<Vertex_> const& aVertices, std::vector<std::uint32_t> const& aIndices, MeshletRange_ const& aRange )
+	{
+		CookedMeshlet ret{};
+		ret.firstIndex = aRange.firstIndex;
+		ret.indexCount = aRange.indexCount;
+
+		auto const begin = aIndices.begin() + aRange.firstIndex;
+		auto const end = begin + aRange.indexCount;
+
+		float bmin[3], bmax[3];
+		for( int j = 0; j < 3; ++j )
+		{
+			bmin[j] = std::numeric_limits<float>::max();
+			bmax[j] = std::numeric_limits<float>::lowest();
+		}
+		for( auto it = begin; it != end; ++it )
+		{
+			for( int j = 0; j < 3; ++j )
+			{
+				bmin[j] = std::min( bmin[j], aVertices[*it].position[j] );
+				bmax[j] = std::max( bmax[j], aVertices[*it].position[j] );
+			}
+		}
+
+		float radius2 = 0.f;
+		for( int j = 0; j < 3; ++j )
+			ret.sphere[j] = 0.5f * (bmin[j] + bmax[j]);
+		for( auto it = begin; it != end; ++it )
+		{
+			float d2 = 0.f;
+			for( int j = 0; j < 3; ++j )
+				d2 += (aVertices[*it].position[j]-ret.sphere[j]) * (aVertices[*it].position[j]-ret.sphere[j]);
+			radius2 = std::max( radius2, d2 );
+		}
+		ret.sphere[3] = std::sqrt( radius2 );
+
+		// Unit normals of the (non-degenerate) triangles, counter-clockwise
+		// being front facing
+		std::vector<float> normals;
+		for( auto it = begin; it != end; it += 3 )
+		{
+			float const* a = aVertices[it[0]].position;
+			float const* b = aVertices[it[1]].position;
+			float const* c = aVertices[it[2]].position;
+
+			float const u[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+			float const v[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+			float const n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+
+			float const len = std::sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
+			if( len > 0.f )
+				normals.insert( normals.end(), { n[0]/len, n[1]/len, n[2]/len } );
+		}
+
+		// No cone unless one is found below
+		ret.cone[3] = 1.f;
+
+		float axis[3] = {};
+		for( std::size_t i = 0; i < normals.size(); i += 3 )
+		{
+			for( int j = 0; j < 3; ++j )
+				axis[j] += normals[i+j];
+		}
+
+		float const axisLen = std::sqrt( axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2] );
+		if( axisLen <= 0.f )
+			return ret;
+
+		float minDot = 1.f;
+		for( std::size_t i = 0; i < normals.size(); i += 3 )
+			minDot = std::min( minDot, (axis[0]*normals[i] + axis[1]*normals[i+1] + axis[2]*normals[i+2]) / axisLen );
+
+		if( minDot <= 0.f )
+			return ret;
+
+		for( int j = 0; j < 3; ++j )
+			ret.cone[j] = axis[j] / axisLen;
+		ret.cone[3] = std::sqrt( 1.f - minDot*minDot );
+
+		return ret;
+	}
+
+	/* Vertex clustering simplification
+	 *
+	 * Snaps vertices to a uniform grid and replaces every vertex by the
+	 * representative of its cell (the vertex closest to the cell's mean).
+	 * Triangles that collapse are dropped. Crude, but robust, and the
+	 * result references the existing vertex array.
+	 */
+	std::vector<std::uint32_t> cluster_lod_( std::vector<Vertex_> const& aVertices, std::vector<std::uint32_t> const& aIndices, std::size_t aGrid, float& aError )
+	{
+		float bmin[3], bmax[3];
+		for( int j = 0; j < 3; ++j )
+		{
+			bmin[j] = std::numeric_limits<float>::max();
+			bmax[j] = std::numeric_limits<float>::lowest();
+		}
+		for( auto const& v : aVertices )
+		{
+			for( int j = 0; j < 3; ++j )
+			{
+				bmin[j] = std::min( bmin[j], v.position[j] );
+				bmax[j] = std::max( bmax[j], v.position[j] );
+			}
+		}
+
+		float const extent = std::max( { bmax[0]-bmin[0], bmax[1]-bmin[1], bmax[2]-bmin[2] } );
+		if( extent <= 0.f )
+			return {};
+
+		float const cellSize = extent / float(aGrid);
+		aError = cellSize * std::sqrt( 3.f );
+
+		auto cell_of_ = [&] (Vertex_ const& aV) {
+			std::uint64_t key = 0;
+			for( int j = 0; j < 3; ++j )
+			{
+				auto const c = std::min<std::uint64_t>( std::uint64_t((aV.position[j]-bmin[j]) / cellSize ), aGrid );
+				key = (key << 21) | c;
+			}
+			return key;
+		};
+
+		struct Cell_
+		{
+			float sum[3];
+			std::uint32_t count;
+			std::uint32_t representative;
+			float bestDist;
+		};
+
+		std::unordered_map<std::uint64_t,Cell_> cells;
+		std::vector<std::uint64_t> cellOf( aVertices.size() );
+		for( std::size_t i = 0; i < aVertices.size(); ++i )
+		{
+			cellOf[i] = cell_of_( aVertices[i] );
+			auto& cell = cells[cellOf[i]];
+			for( int j = 0; j < 3; ++j )
+				cell.sum[j] += aVertices[i].position[j];
+			++cell.count;
+			cell.bestDist = std::numeric_limits<float>::max();
+		}
+
+		for( std::size_t i = 0; i < aVertices.size(); ++i )
+		{
+			auto& cell = cells[cellOf[i]];
+
+			float d2 = 0.f;
+			for( int j = 0; j < 3; ++j )
+			{
+				auto const d = aVertices[i].position[j] - cell.sum[j] / float(cell.count);
+				d2 += d*d;
+			}
+
+			if( d2 < cell.bestDist )
+			{
+				cell.bestDist = d2;
+				cell.representative = std::uint32_t(i);
+			}
+		}
+
+		std::vector<std::uint32_t> ret;
+		for( std::size_t t = 0; t+2 < aIndices.size(); t += 3 )
+		{
+			auto const a = cells[cellOf[aIndices[t+0]]].representative;
+			auto const b = cells[cellOf[aIndices[t+1]]].representative;
+			auto const c = cells[cellOf[aIndices[t+2]]].representative;
+
+			if( a == b || b == c || a == c )
+				continue;
+
+			ret.insert( ret.end(), { a, b, c } );
+		}
+
+		return ret;
+	}
+}
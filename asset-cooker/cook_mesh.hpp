@@ -0,0 +1,17 @@
+#ifndef COOK_MESH_HPP_0B9F3E52_6C1D_4E8B_B2A4_7D3E91C5F608
+#define COOK_MESH_HPP_0B9F3E52_6C1D_4E8B_B2A4_7D3E91C5F608
+
+#include <string>
+#include <vector>
+
+// Files that the cooked version of aObjPath depends on: the OBJ itself and
+// any material libraries it references.
+std::vector<std::string> mesh_dependencies( std::string const& aObjPath );
+
+// Converts a Wavefront OBJ into a cooked mesh (see support/cooked.hpp):
+// vertices are deduplicated, triangles are reordered for the post-transform
+// vertex cache, vertices are reordered for fetch locality and a few
+// simplified LODs are appended to the index buffer.
+void cook_mesh( std::string const& aObjPath, std::string const& aOutPath );
+
+#endif // COOK_MESH_HPP_0B9F3E52_6C1D_4E8B_B2A4_7D3E91C5F608
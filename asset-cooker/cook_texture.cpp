@@ -0,0 +1,146 @@
+#include "cook_texture.hpp"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+#include "../support/mipmap.hpp"
+
+#include "bc_encode.hpp"
+
+namespace
+{
+	// Compresses a level into rows of 4x4 blocks. Texels outside of the
+	// level (for sizes that are not a multiple of four) replicate the edge.
+	// Block rows are distributed over all hardware threads, as BC7 in
+	// particular is not cheap for large textures.
+	std::vector<std::uint8_t> compress_( Rgba8Image const& aImage, CookedTextureFormat aFormat )
+	{
+		std::size_t const blockBytes = cooked_block_bytes( aFormat );
+		std::uint32_t const bw = (aImage.width + 3) / 4;
+		std::uint32_t const bh = (aImage.height + 3) / 4;
+
+		std::vector<std::uint8_t> ret( std::size_t(bw) * bh * blockBytes );
+
+		auto compress_rows_ = [&] (std::uint32_t aFirst, std::uint32_t aStep) {
+			std::uint8_t texels[64];
+			for( std::uint32_t by = aFirst; by < bh; by += aStep )
+			{
+				for( std::uint32_t bx = 0; bx < bw; ++bx )
+				{
+					for( std::uint32_t i = 0; i < 16; ++i )
+					{
+						std::uint32_t const x = std::min( bx*4 + i%4, aImage.width-1 );
+						std::uint32_t const y = std::min( by*4 + i/4, aImage.height-1 );
+						std::memcpy( texels + i*4, &aImage.rgba[(std::size_t(y)*aImage.width + x)*4], 4 );
+					}
+
+					auto* out = &ret[(std::size_t(by)*bw + bx) * blockBytes];
+					switch( aFormat )
+					{
+						case CookedTextureFormat::bc1srgb: encode_bc1_block( texels, out ); break;
+						case CookedTextureFormat::bc3srgb: encode_bc3_block( texels, out ); break;
+						case CookedTextureFormat::bc7srgb: encode_bc7_block( texels, out ); break;
+						case CookedTextureFormat::rgba8srgb: break;
+					}
+				}
+			}
+		};
+
+		std::uint32_t const threadCount = std::max( 1u, std::min( std::thread::hardware_concurrency(), bh ) );
+
+		std::vector<std::thread> threads;
+		for( std::uint32_t t = 1; t < threadCount; ++t )
+			threads.emplace_back( compress_rows_, t, threadCount );
+		compress_rows_( 0, threadCount );
+
+		for( auto& thread : threads )
+			thread.join();
+
+		return ret;
+	}
+
+	CookedTextureFormat select_format_( TextureEncoding aEncoding, Rgba8Image const& aImage )
+	{
+		switch( aEncoding )
+		{
+			case TextureEncoding::rgba8: return CookedTextureFormat::rgba8srgb;
+			case TextureEncoding::bc1: return CookedTextureFormat::bc1srgb;
+			case TextureEncoding::bc3: return CookedTextureFormat::bc3srgb;
+			case TextureEncoding::bc7: return CookedTextureFormat::bc7srgb;
+			case TextureEncoding::automatic: break;
+		}
+
+		for( std::size_t i = 3; i < aImage.rgba.size(); i += 4 )
+		{
+			if( 255 != aImage.rgba[i] )
+				return CookedTextureFormat::bc7srgb;
+		}
+
+		return CookedTextureFormat::bc1srgb;
+	}
+}
+
+void cook_texture( std::string const& aImagePath, std::string const& aOutPath, TextureEncoding aEncoding )
+{
+	stbi_set_flip_vertically_on_load( true );
+
+	int w, h, channels;
+	stbi_uc* ptr = stbi_load( aImagePath.c_str(), &w, &h, &channels, 4 );
+	if( !ptr )
+		throw Error( "Unable to load image '%s'", aImagePath.c_str() );
+
+	if( mip_level_count( std::uint32_t(w), std::uint32_t(h) ) > kCookedMaxLevels )
+	{
+		stbi_image_free( ptr );
+		throw Error( "cook_texture(): '%s' is too large (%d x %d)", aImagePath.c_str(), w, h );
+	}
+
+	// Mip levels are filtered in linear space
+	auto levels = build_srgb_mip_chain( Rgba8Image{ std::uint32_t(w), std::uint32_t(h), std::vector<std::uint8_t>( ptr, ptr + std::size_t(w)*h*4 ) } );
+	stbi_image_free( ptr );
+
+	auto const format = select_format_( aEncoding, levels.front() );
+	if( CookedTextureFormat::rgba8srgb != format )
+	{
+		// Note: from here on, the levels' rgba arrays hold the blocks
+		for( auto& level : levels )
+			level.rgba = compress_( level, format );
+	}
+
+	CookedTextureHeader header{};
+	header.magic = kCookedTextureMagic;
+	header.version = kCookedTextureVersion;
+	header.format = format;
+	header.width = std::uint32_t(w);
+	header.height = std::uint32_t(h);
+	header.levelCount = std::uint32_t(levels.size());
+
+	std::uint64_t offset = (sizeof(CookedTextureHeader) + 15) & ~std::uint64_t(15);
+	for( std::size_t i = 0; i < levels.size(); ++i )
+	{
+		header.levels[i].offset = offset;
+		header.levels[i].size = levels[i].rgba.size();
+		header.levels[i].width = levels[i].width;
+		header.levels[i].height = levels[i].height;
+		offset = (offset + levels[i].rgba.size() + 15) & ~std::uint64_t(15);
+	}
+
+	std::vector<std::uint8_t> blob( offset );
+	std::memcpy( blob.data(), &header, sizeof(header) );
+	for( std::size_t i = 0; i < levels.size(); ++i )
+		std::memcpy( blob.data() + header.levels[i].offset, levels[i].rgba.data(), levels[i].rgba.size() );
+
+	write_file_bytes( aOutPath.c_str(), blob.data(), blob.size() );
+
+	static char const* const kFormatNames[] = { "RGBA8", "BC1", "BC3", "BC7" };
+	std::printf( "  %d x %d, %zu levels, %s, %zu bytes\n", w, h, levels.size(), kFormatNames[std::size_t(format)], blob.size() );
+}
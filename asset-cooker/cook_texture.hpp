@@ -0,0 +1,22 @@
+#ifndef COOK_TEXTURE_HPP_7A2D5C13_4B8E_4F6A_9C01_E35B8D2F6A47
+#define COOK_TEXTURE_HPP_7A2D5C13_4B8E_4F6A_9C01_E35B8D2F6A47
+
+#include <string>
+
+enum class TextureEncoding
+{
+	automatic, // BC1 for opaque images, BC7 otherwise
+	rgba8,
+	bc1,
+	bc3,
+	bc7
+};
+
+// Decodes an image (anything stb_image understands) and writes a cooked
+// texture (see support/cooked.hpp) with the full mip chain. Mip levels are
+// filtered in linear space; the image is assumed to be sRGB encoded. Like
+// load_texture_2d(), the image is flipped vertically. Each level is then
+// block compressed, unless aEncoding is rgba8.
+void cook_texture( std::string const& aImagePath, std::string const& aOutPath, TextureEncoding aEncoding );
+
+#endif // COOK_TEXTURE_HPP_7A2D5C13_4B8E_4F6A_9C01_E35B8D2F6A47
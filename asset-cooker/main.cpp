@@ -0,0 +1,172 @@
+#include <string>
+#include <vector>
+#include <functional>
+#include <typeinfo>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+
+#include "manifest.hpp"
+#include "cook_mesh.hpp"
+#include "cook_texture.hpp"
+
+namespace fs = std::filesystem;
+
+/* Offline asset cooker
+ *
+ * Converts the source assets in the asset directory into the formats
+ * described in support/cooked.hpp. Outputs go into a "cooked" subdirectory
+ * next to the sources, which is where the main program looks for them.
+ *
+ * Usage: asset-cooker [--force] [--texture-format=FMT] [ASSET_DIR]
+ *
+ * where FMT is one of auto (default), rgba8, bc1, bc3 or bc7. See
+ * cook_texture.hpp.
+ *
+ * Only outputs whose inputs (or cooking settings) changed are rebuilt; see
+ * manifest.hpp.
+ */
+
+namespace
+{
+	// Bump this when the cooking code changes in a way that affects the
+	// output. This forces all assets to be rebuilt.
+	constexpr std::uint64_t kCookerRevision_ = 2;
+
+	struct Job_
+	{
+		std::string output;
+		std::uint64_t settings;
+		std::vector<std::string> inputs;
+		std::function<void (std::string const&, std::string const&)> cook;
+	};
+
+	std::uint64_t settings_hash_( std::uint32_t aFormatVersion, std::uint64_t aOptions = 0 )
+	{
+		std::uint64_t const values[] = { kCookerRevision_, aFormatVersion, aOptions };
+		return fnv1a64( values, sizeof(values) );
+	}
+
+	TextureEncoding parse_texture_encoding_( char const* aName )
+	{
+		if( 0 == std::strcmp( aName, "auto" ) ) return TextureEncoding::automatic;
+		if( 0 == std::strcmp( aName, "rgba8" ) ) return TextureEncoding::rgba8;
+		if( 0 == std::strcmp( aName, "bc1" ) ) return TextureEncoding::bc1;
+		if( 0 == std::strcmp( aName, "bc3" ) ) return TextureEncoding::bc3;
+		if( 0 == std::strcmp( aName, "bc7" ) ) return TextureEncoding::bc7;
+
+		throw Error( "Unknown texture format '%s' (expected auto, rgba8, bc1, bc3 or bc7)", aName );
+	}
+
+	std::string lowercase_extension_( fs::path const& aPath )
+	{
+		auto ext = aPath.extension().string();
+		std::transform( ext.begin(), ext.end(), ext.begin(), [] (unsigned char aC) { return char(std::tolower(aC)); } );
+		return ext;
+	}
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+#	if defined(WIN32)
+	std::string assetDir = "../assets";
+#	else
+	std::string assetDir = "assets";
+#	endif
+
+	bool force = false;
+	TextureEncoding textureEncoding = TextureEncoding::automatic;
+	for( int i = 1; i < aArgc; ++i )
+	{
+		if( 0 == std::strcmp( aArgv[i], "--force" ) )
+			force = true;
+		else if( 0 == std::strncmp( aArgv[i], "--texture-format=", 17 ) )
+			textureEncoding = parse_texture_encoding_( aArgv[i] + 17 );
+		else if( '-' == aArgv[i][0] )
+			throw Error( "Unknown option '%s'\nUsage: %s [--force] [--texture-format=FMT] [ASSET_DIR]", aArgv[i], aArgv[0] );
+		else
+			assetDir = aArgv[i];
+	}
+
+	if( !fs::is_directory( assetDir ) )
+		throw Error( "Asset directory '%s' does not exist", assetDir.c_str() );
+
+	std::string const cookedDir = assetDir + "/cooked";
+	std::string const manifestPath = cookedDir + "/manifest.txt";
+
+	fs::create_directories( cookedDir );
+
+	// Collect jobs. Sort by path so that output is stable.
+	std::vector<fs::path> sources;
+	for( auto const& entry : fs::directory_iterator( assetDir ) )
+	{
+		if( entry.is_regular_file() )
+			sources.emplace_back( entry.path() );
+	}
+	std::sort( sources.begin(), sources.end() );
+
+	std::vector<Job_> jobs;
+	for( auto const& source : sources )
+	{
+		auto const ext = lowercase_extension_( source );
+		auto const path = source.generic_string();
+
+		if( ".obj" == ext )
+		{
+			jobs.emplace_back( Job_{ cooked_path( path, ".mesh" ), settings_hash_( kCookedMeshVersion ), mesh_dependencies( path ), &cook_mesh } );
+		}
+		else if( ".jpeg" == ext || ".jpg" == ext || ".png" == ext )
+		{
+			auto cook = [textureEncoding] (std::string const& aIn, std::string const& aOut) {
+				cook_texture( aIn, aOut, textureEncoding );
+			};
+			jobs.emplace_back( Job_{ cooked_path( path, ".tex" ), settings_hash_( kCookedTextureVersion, std::uint64_t(textureEncoding) ), { path }, cook } );
+		}
+	}
+
+	// Cook
+	auto manifest = Manifest::load( manifestPath );
+
+	std::size_t cooked = 0, skipped = 0, failed = 0;
+	for( auto const& job : jobs )
+	{
+		if( !force && manifest.up_to_date( job.output, job.settings, job.inputs ) )
+		{
+			++skipped;
+			continue;
+		}
+
+		std::printf( "Cooking %s -> %s\n", job.inputs.front().c_str(), job.output.c_str() );
+
+		try
+		{
+			job.cook( job.inputs.front(), job.output );
+			manifest.record( job.output, job.settings, job.inputs );
+			++cooked;
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "  FAILED: %s\n", eErr.what() );
+			++failed;
+		}
+	}
+
+	manifest.save( manifestPath );
+
+	std::printf( "%zu cooked, %zu up to date, %zu failed\n", cooked, skipped, failed );
+	return failed ? 1 : 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level Exception (%s):\n", typeid(eErr).name() );
+	std::fprintf( stderr, "%s\n", eErr.what() );
+	std::fprintf( stderr, "Bye.\n" );
+	return 1;
+}
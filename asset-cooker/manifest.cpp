@@ -0,0 +1,142 @@
+#include "manifest.hpp"
+
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	Manifest::Input stat_input_( std::string const& aPath, bool aHash );
+}
+
+Manifest Manifest::load( std::string const& aPath )
+{
+	Manifest ret;
+
+	std::ifstream fin( aPath );
+	if( !fin )
+		return ret;
+
+	std::string line;
+	while( std::getline( fin, line ) )
+	{
+		if( line.empty() || '#' == line[0] )
+			continue;
+
+		std::istringstream sin( line );
+
+		std::string output;
+		std::uint64_t settings;
+		Input input;
+		if( !(sin >> output >> std::hex >> settings >> input.path >> std::dec >> input.size >> input.mtime >> std::hex >> input.hash) )
+			throw Error( "Manifest: malformed line in '%s': %s", aPath.c_str(), line.c_str() );
+
+		auto& entry = ret.mEntries[output];
+		entry.settings = settings;
+		entry.inputs.emplace_back( std::move(input) );
+	}
+
+	return ret;
+}
+
+void Manifest::save( std::string const& aPath ) const
+{
+	// Sort by output name so that the file is stable between runs.
+	std::map<std::string,Entry const*> sorted;
+	for( auto const& entry : mEntries )
+		sorted[entry.first] = &entry.second;
+
+	std::ofstream fout( aPath );
+	if( !fout )
+		throw Error( "Manifest: unable to write '%s'", aPath.c_str() );
+
+	fout << "# asset-cooker manifest: output settings input size mtime hash\n";
+	for( auto const& [output, entry] : sorted )
+	{
+		for( auto const& input : entry->inputs )
+		{
+			fout << output << ' ' << std::hex << entry->settings << ' '
+				<< input.path << ' ' << std::dec << input.size << ' ' << input.mtime << ' '
+				<< std::hex << input.hash << '\n';
+		}
+	}
+
+	if( !fout )
+		throw Error( "Manifest: error while writing '%s'", aPath.c_str() );
+}
+
+bool Manifest::up_to_date( std::string const& aOutput, std::uint64_t aSettings, std::vector<std::string> const& aInputs )
+{
+	std::error_code ec;
+	if( !fs::exists( aOutput, ec ) )
+		return false;
+
+	auto const it = mEntries.find( aOutput );
+	if( mEntries.end() == it )
+		return false;
+
+	auto& entry = it->second;
+	if( entry.settings != aSettings || entry.inputs.size() != aInputs.size() )
+		return false;
+
+	for( std::size_t i = 0; i < aInputs.size(); ++i )
+	{
+		auto& known = entry.inputs[i];
+		if( known.path != aInputs[i] )
+			return false;
+
+		auto const current = stat_input_( known.path, false );
+		if( current.size == known.size && current.mtime == known.mtime )
+			continue;
+
+		// Timestamp or size differs. Only the content matters, though.
+		auto const hashed = stat_input_( known.path, true );
+		if( hashed.size != known.size || hashed.hash != known.hash )
+			return false;
+
+		known.mtime = hashed.mtime;
+	}
+
+	return true;
+}
+
+void Manifest::record( std::string const& aOutput, std::uint64_t aSettings, std::vector<std::string> const& aInputs )
+{
+	Entry entry;
+	entry.settings = aSettings;
+
+	for( auto const& input : aInputs )
+		entry.inputs.emplace_back( stat_input_( input, true ) );
+
+	mEntries[aOutput] = std::move(entry);
+}
+
+namespace
+{
+	Manifest::Input stat_input_( std::string const& aPath, bool aHash )
+	{
+		Manifest::Input ret{ aPath, 0, 0, 0 };
+
+		std::error_code ec;
+		auto const size = fs::file_size( aPath, ec );
+		if( ec )
+			return ret; // Missing inputs never match a recorded entry
+
+		ret.size = size;
+		ret.mtime = fs::last_write_time( aPath, ec ).time_since_epoch().count();
+
+		if( aHash )
+		{
+			auto const bytes = read_file_bytes( aPath.c_str() );
+			ret.hash = fnv1a64( bytes.data(), bytes.size() );
+		}
+
+		return ret;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef MANIFEST_HPP_8E41A7C2_93B5_4F0D_A6E1_2C7D54B90F3A
+#define MANIFEST_HPP_8E41A7C2_93B5_4F0D_A6E1_2C7D54B90F3A
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstdint>
+
+/* Dependency manifest
+ *
+ * Records, for each cooked output, the inputs it was built from (with size,
+ * modification time and content hash) and a hash of the settings used to
+ * build it. An output is rebuilt only if it is missing, if the settings
+ * changed, or if one of its inputs changed. A changed timestamp alone does
+ * not trigger a rebuild if the content hash is still the same.
+ *
+ * The manifest is a plain text file with one line per output and input:
+ *   <output> <settings> <input> <size> <mtime> <hash>
+ */
+class Manifest final
+{
+	public:
+		struct Input
+		{
+			std::string path;
+			std::uint64_t size;
+			std::int64_t mtime;
+			std::uint64_t hash;
+		};
+
+		struct Entry
+		{
+			std::uint64_t settings;
+			std::vector<Input> inputs;
+		};
+
+	public:
+		// Missing manifest files result in an empty manifest
+		static Manifest load( std::string const& aPath );
+		void save( std::string const& aPath ) const;
+
+		// Note: may refresh stored timestamps of inputs whose content did
+		// not change, hence non-const.
+		bool up_to_date(
+			std::string const& aOutput,
+			std::uint64_t aSettings,
+			std::vector<std::string> const& aInputs
+		);
+
+		void record(
+			std::string const& aOutput,
+			std::uint64_t aSettings,
+			std::vector<std::string> const& aInputs
+		);
+
+	private:
+		std::unordered_map<std::string,Entry> mEntries;
+};
+
+#endif // MANIFEST_HPP_8E41A7C2_93B5_4F0D_A6E1_2C7D54B90F3A
@@ -0,0 +1,26 @@
+// Uniform blocks shared by the shaders. These must match the C++ mirrors in
+// main/uniform_blocks.hpp. vec3s are padded to vec4s.
+
+// Per-frame data
+layout(std140, binding = 0) uniform FrameBlock
+{
+    vec4 uLightDir;                 // Direction for direction light "sun"
+    vec4 uLightDiffuse;             // LightDiffuse color for "sun"
+    vec4 uSceneAmbient;             // SceneAmbient color for "sun"
+};
+
+// Per-view data
+layout(std140, row_major, binding = 1) uniform ViewBlock
+{
+    mat4 uProjCamera;
+    vec4 uCameraPos;                // Camera Position
+    vec4 uViewport;                 // xy: origin, zw: size, in pixels
+
+    // Light clusters (see clusters.glsl)
+    uvec4 uClusterGrid;             // xyz: number of clusters
+    vec4 uClusterDepth;             // near, far, depth slice scale and bias
+
+    mat4 uInvProjCamera;            // World position from NDC (deferred.frag)
+
+    vec4 uFrustumPlanes[6];         // world space, normals inwards (cull.comp)
+};
@@ -0,0 +1,46 @@
+// Clustered point lights. The view frustum is split into clusters (tiles on
+// screen, exponentially spaced slices in depth), and the application lists
+// the lights that reach each cluster; see main/clustered_lights.hpp.
+
+#include "blocks.glsl"
+
+struct PointLight
+{
+    vec4 positionRadius;            // xyz: world position, w: radius
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout(std430, binding = 0) readonly buffer PointLights
+{
+    PointLight uPointLights[];
+};
+
+// Per cluster: first entry in uClusterLightIndices and number of lights
+layout(std430, binding = 1) readonly buffer ClusterRanges
+{
+    uvec2 uClusterRanges[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterLightIndices
+{
+    uint uClusterLightIndices[];
+};
+
+// Lights of the current fragment's cluster, given its depth buffer value
+uvec2 cluster_lights(float windowDepth)
+{
+    // View depth from window depth (default depth range)
+    float zNear = uClusterDepth.x;
+    float zFar = uClusterDepth.y;
+    float ndcZ = windowDepth * 2.0 - 1.0;
+    float depth = 2.0 * zNear * zFar / (zFar + zNear - ndcZ * (zFar - zNear));
+
+    vec3 cell = vec3(
+        (gl_FragCoord.xy - uViewport.xy) / uViewport.zw * vec2(uClusterGrid.xy),
+        log(depth) * uClusterDepth.z + uClusterDepth.w
+    );
+    uvec3 cluster = uvec3(clamp(cell, vec3(0.0), vec3(uClusterGrid.xyz - 1u)));
+
+    return uClusterRanges[cluster.x + uClusterGrid.x * (cluster.y + uClusterGrid.y * cluster.z)];
+}
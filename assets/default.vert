@@ -1,29 +1,57 @@
-#version 430
-
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iColor;
-layout(location = 2) in vec3 iNormal;
-layout(location = 3) in vec2 iTexCoord;
-
-layout(location = 0) uniform mat4 uProjCameraWorld;
-layout(location = 1) uniform mat3 uNormalMatrix;
-layout(location = 13) uniform mat4 uModelWorld;
-
-out vec3 v2fColor;
-out vec3 v2fNormal;
-out vec2 v2fTexCoord;
-out vec3 v2fWorldPos;
-
-void main()
-{
-  v2fColor = iColor;
-
-  v2fNormal = normalize(uNormalMatrix * iNormal);
-
-  v2fTexCoord = iTexCoord;
-
-  v2fWorldPos = vec3(uModelWorld * vec4(iPosition, 1.0));
-
-  gl_Position = uProjCameraWorld * vec4(iPosition.xyz, 1.0);
-
-}
+#version 430
+
+layout(location = 0) in vec3 iPosition;
+layout(location = 1) in vec3 iColor;
+layout(location = 2) in vec3 iNormal;
+layout(location = 3) in vec2 iTexCoord;
+
+#include "blocks.glsl"
+
+#ifdef USE_INSTANCES
+// Instances culled on the GPU (see cull.comp). The index of the instance
+// comes from the list of visible instances, bound as a per-instance vertex
+// attribute; the draw command's baseInstance selects the LOD's list.
+#include "instances.glsl"
+
+layout(location = 4) in uint iInstance;
+#else
+layout(location = 1) uniform mat3 uNormalMatrix;
+layout(location = 13) uniform mat4 uModelWorld;
+#endif
+
+// Explicit locations, so that the stage can be used in a program pipeline
+// (separable programs); see default.frag
+layout(location = 0) out vec3 v2fColor;
+layout(location = 1) out vec3 v2fNormal;
+layout(location = 2) out vec2 v2fTexCoord;
+layout(location = 3) out vec3 v2fWorldPos;
+
+// Required for separable programs
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+// Must match depth.vert exactly (depth pre-pass)
+invariant gl_Position;
+
+void main()
+{
+  v2fColor = iColor;
+
+#ifdef USE_INSTANCES
+  // Instances are rotated, translated and uniformly scaled only
+  mat4 modelWorld = uInstances[iInstance].modelWorld;
+  v2fNormal = normalize(mat3(modelWorld) * iNormal);
+#else
+  mat4 modelWorld = uModelWorld;
+  v2fNormal = normalize(uNormalMatrix * iNormal);
+#endif
+
+  v2fTexCoord = iTexCoord;
+
+  vec4 worldPos = modelWorld * vec4(iPosition, 1.0);
+  v2fWorldPos = worldPos.xyz;
+
+  gl_Position = uProjCamera * worldPos;
+
+}
@@ -0,0 +1,48 @@
+#version 430
+
+// Lighting pass of the deferred path: lights each pixel of the G-buffer
+// (see gbuffer.frag) once, with the same lights as default.frag. The point
+// lights come from the pixel's cluster.
+//
+// Permutations:
+//   USE_SPECULAR       - specular term for the point lights
+
+layout(location = 0) out vec3 oColor;
+layout(location = 7) uniform float uShininess;          // Shininess (USE_SPECULAR)
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+layout(binding = 1) uniform sampler2D uGBufferAlbedo;
+layout(binding = 2) uniform sampler2D uGBufferNormal;
+layout(binding = 3) uniform sampler2D uGBufferDepth;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    // Nothing was drawn here; keep the background
+    float depth = texelFetch(uGBufferDepth, pixel, 0).r;
+    if(depth >= 1.0)
+        discard;
+
+    // Decoded from sRGB to linear by the fetch
+    vec4 albedo = texelFetch(uGBufferAlbedo, pixel, 0);
+    vec3 normal = decode_normal(texelFetch(uGBufferNormal, pixel, 0).xy);
+
+    // World position from window coordinates and depth
+    vec2 ndc = (gl_FragCoord.xy - uViewport.xy) / uViewport.zw * 2.0 - 1.0;
+    vec4 world = uInvProjCamera * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 worldPos = world.xyz / world.w;
+
+    vec3 viewDir = normalize(uCameraPos.xyz - worldPos);
+
+    vec3 dirDiffuse = sun_diffuse(normal);
+
+    vec3 pointDiffuse, pointSpecular;
+    point_lights(normal, worldPos, viewDir, uShininess, depth, pointDiffuse, pointSpecular);
+
+    vec3 finalDiffuse = dirDiffuse + pointDiffuse;
+    vec3 finalSpecular = pointSpecular * albedo.a;
+    oColor = (uSceneAmbient.rgb + finalDiffuse + finalSpecular) * albedo.rgb;
+}
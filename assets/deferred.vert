@@ -0,0 +1,16 @@
+#version 430
+
+// Full-screen triangle for the lighting pass of the deferred path. Drawn
+// with glDrawArrays(GL_TRIANGLES, 0, 3) and no vertex attributes.
+
+// Required for separable programs
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+
+void main()
+{
+  vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 430
+
+// Depth pre-pass: positions only, no fragment stage. gl_Position must come
+// out bit-identical to default.vert, as the color pass then tests with
+// GL_EQUAL; hence the same expression and the invariant qualifier.
+
+layout(location = 0) in vec3 iPosition;
+
+#include "blocks.glsl"
+
+layout(location = 13) uniform mat4 uModelWorld;
+
+// Required for separable programs
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+invariant gl_Position;
+
+void main()
+{
+  vec4 worldPos = uModelWorld * vec4(iPosition, 1.0);
+  gl_Position = uProjCamera * worldPos;
+}
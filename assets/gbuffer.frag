@@ -0,0 +1,41 @@
+#version 430
+
+// Geometry pass of the deferred path: writes the surface to the G-buffer
+// instead of lighting it; see deferred.frag.
+//
+// Permutations, as in default.frag:
+//   USE_TEXTURE        - base color from uTexture instead of the vertex color
+//   USE_SPECULAR       - surface has a specular highlight
+
+layout(location = 0) in vec3 v2fColor;
+layout(location = 1) in vec3 v2fNormal;
+layout(location = 2) in vec2 v2fTexCoord;
+layout(location = 3) in vec3 v2fWorldPos;
+
+layout(location = 0) out vec4 oAlbedo;
+layout(location = 1) out vec2 oNormal;
+
+#include "gbuffer.glsl"
+
+#ifdef USE_TEXTURE
+layout(binding = 0) uniform sampler2D uTexture;
+#endif
+
+void main()
+{
+#ifdef USE_TEXTURE
+    vec3 baseColor = texture(uTexture, v2fTexCoord).rgb;
+#else
+    vec3 baseColor = v2fColor;
+#endif
+
+#ifdef USE_SPECULAR
+    float specular = 1.0;
+#else
+    float specular = 0.0;
+#endif
+
+    // Linear; encoded to sRGB by the attachment (see gbuffer.glsl)
+    oAlbedo = vec4(baseColor, specular);
+    oNormal = encode_normal(normalize(v2fNormal));
+}
@@ -0,0 +1,29 @@
+// G-buffer of the deferred path (see main/gbuffer.hpp):
+//   color attachment 0: SRGB8_ALPHA8 - rgb: base color (sRGB encoded; linear
+//                       when read), a: specular strength (linear)
+//   color attachment 1: RG16F - normal, octahedral encoding
+//   depth attachment:   DEPTH32F
+
+vec2 sign_not_zero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Octahedral encoding: the unit sphere is projected onto an octahedron,
+// whose lower half is folded over the upper one
+vec2 encode_normal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if(n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * sign_not_zero(n.xy);
+    return e;
+}
+
+vec3 decode_normal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * sign_not_zero(n.xy);
+    return normalize(n);
+}
@@ -0,0 +1,14 @@
+// Instances of a mesh that are culled on the GPU; see cull.comp and
+// main/culled_instances.hpp.
+
+struct Instance
+{
+    mat4 modelWorld;
+    vec4 boundsMin;                 // world space bounds
+    vec4 boundsMax;
+};
+
+layout(std430, row_major, binding = 3) readonly buffer Instances
+{
+    Instance uInstances[];
+};
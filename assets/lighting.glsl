@@ -0,0 +1,54 @@
+// Lighting helpers
+
+#include "blocks.glsl"
+#include "clusters.glsl"
+
+// Diffuse light from the directional light "sun"
+// Don't need spec lights for directional light
+vec3 sun_diffuse(vec3 normal)
+{
+    vec3 dirLightDir = normalize(uLightDir.xyz);
+    float diffDir = max(dot(normal, dirLightDir), 0.0);
+    return diffDir * uLightDiffuse.rgb;
+}
+
+// Distance attenuation of the point lights. Fades out smoothly to zero at
+// the light's radius, beyond which the light is not listed in any cluster.
+float point_light_attenuation(float dist, float radius)
+{
+    float falloff = 1.0 / (1.0 + 0.09 * dist + 0.032 * dist * dist);
+    float ratio = dist / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return falloff * window * window;
+}
+
+// Diffuse and (with USE_SPECULAR) specular light from the point lights of
+// the fragment's cluster. windowDepth is the fragment's depth buffer value.
+void point_lights(vec3 normal, vec3 worldPos, vec3 viewDir, float shininess, float windowDepth, out vec3 diffuse, out vec3 specular)
+{
+    diffuse = vec3(0.0);
+    specular = vec3(0.0);
+
+    uvec2 lights = cluster_lights(windowDepth);
+    for(uint i = 0u; i < lights.y; ++i)
+    {
+        PointLight light = uPointLights[uClusterLightIndices[lights.x + i]];
+
+        vec3 toLight = light.positionRadius.xyz - worldPos;
+        float dist = length(toLight);
+        if(dist >= light.positionRadius.w)
+            continue;
+
+        vec3 pointLightDir = toLight / dist;
+        float diffPoint = max(dot(normal, pointLightDir), 0.0);
+
+        float attenuation = point_light_attenuation(dist, light.positionRadius.w);
+
+        diffuse += diffPoint * light.diffuse.rgb * attenuation;
+#ifdef USE_SPECULAR
+        vec3 reflectDirPoint = reflect(-pointLightDir, normal);
+        float specPoint = pow(max(dot(viewDir, reflectDirPoint), 0.0), shininess);
+        specular += specPoint * light.specular.rgb * attenuation;
+#endif
+    }
+}
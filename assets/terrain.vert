@@ -0,0 +1,84 @@
+#version 430
+
+// CDLOD terrain (see main/cdlod_terrain.hpp): one instance of a square grid
+// patch per selected quadtree node. Heights and texture coordinates come from
+// maps baked from the terrain mesh. Towards the end of its level's distance
+// range, each vertex morphs onto the grid of the next coarser level, so that
+// neighbouring levels meet without cracks and switch levels without popping.
+
+layout(location = 0) in vec2 iGrid;     // patch vertex, in [0,1]^2
+layout(location = 1) in vec4 iNode;     // per instance; xy: node min, z: node size (map space), w: level
+
+#include "blocks.glsl"
+
+// Must match CdlodTerrain's mirror in main/cdlod_terrain.cpp
+layout(std140, binding = 2) uniform TerrainBlock
+{
+    vec4 uTerrainArea;              // xy: world x,z of the maps' origin, zw: their world size
+    vec4 uTerrainGrid;              // x: quads per patch side
+    vec4 uTerrainMorph[8];          // per level; x: morph start distance, y: 1/(morph end - start)
+};
+
+layout(binding = 5) uniform sampler2D uHeightmap;       // r: world height
+layout(binding = 6) uniform sampler2D uTexCoordMap;     // rg: the mesh's texture coordinates
+
+layout(location = 13) uniform mat4 uModelWorld;
+
+// Same interface as default.vert
+layout(location = 0) out vec3 v2fColor;
+layout(location = 1) out vec3 v2fNormal;
+layout(location = 2) out vec2 v2fTexCoord;
+layout(location = 3) out vec3 v2fWorldPos;
+
+// Required for separable programs
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+// The depth pre-pass uses this stage too, and tests with GL_EQUAL
+invariant gl_Position;
+
+float height_at(vec2 uv)
+{
+  return textureLod(uHeightmap, uv, 0.0).r;
+}
+
+void main()
+{
+  float quads = uTerrainGrid.x;
+  int level = int(iNode.w);
+
+  // Distance from the camera, from the unmorphed vertex. Vertices shared by
+  // neighbouring patches thus morph alike.
+  vec2 uv = iNode.xy + iGrid * iNode.z;
+  vec2 xz = uTerrainArea.xy + uv * uTerrainArea.zw;
+  vec3 unmorphed = (uModelWorld * vec4(xz.x, height_at(uv), xz.y, 1.0)).xyz;
+
+  vec2 morph = uTerrainMorph[level].xy;
+  float k = clamp((distance(unmorphed, uCameraPos.xyz) - morph.x) * morph.y, 0.0, 1.0);
+
+  // Odd grid vertices slide onto their even neighbour, which at k = 1 gives
+  // the coarser grid (with degenerate triangles)
+  vec2 odd = fract(iGrid * quads * 0.5) * 2.0 / quads;
+  uv = clamp(iNode.xy + (iGrid - odd * k) * iNode.z, 0.0, 1.0);
+  xz = uTerrainArea.xy + uv * uTerrainArea.zw;
+
+  // Normal from central differences, one texel apart
+  vec2 texel = 1.0 / vec2(textureSize(uHeightmap, 0));
+  vec2 slope = vec2(
+    height_at(uv + vec2(texel.x, 0.0)) - height_at(uv - vec2(texel.x, 0.0)),
+    height_at(uv + vec2(0.0, texel.y)) - height_at(uv - vec2(0.0, texel.y))
+  ) / (2.0 * texel * uTerrainArea.zw);
+  vec3 normal = vec3(-slope.x, 1.0, -slope.y);
+
+  v2fColor = vec3(1.0);
+
+  // The terrain is rotated and translated only
+  v2fNormal = normalize(mat3(uModelWorld) * normal);
+  v2fTexCoord = textureLod(uTexCoordMap, uv, 0.0).rg;
+
+  vec4 worldPos = uModelWorld * vec4(xz.x, height_at(uv), xz.y, 1.0);
+  v2fWorldPos = worldPos.xyz;
+
+  gl_Position = uProjCamera * worldPos;
+}
@@ -0,0 +1,14 @@
+#version 430
+
+// Bakes the texture coordinates of the terrain mesh, seen from above, for the
+// CDLOD terrain (see main/cdlod_terrain.hpp). Heights come from the depth
+// buffer of the same pass.
+
+layout(location = 2) in vec2 v2fTexCoord;
+
+layout(location = 0) out vec2 oTexCoord;
+
+void main()
+{
+  oTexCoord = v2fTexCoord;
+}
@@ -0,0 +1,59 @@
+#include "assets.hpp"
+
+#include <exception>
+
+#include <cstdio>
+
+#include "../support/cooked.hpp"
+
+#include "loadobj.hpp"
+#include "texture.hpp"
+
+namespace
+{
+	bool exists_( std::string const& aPath )
+	{
+		if( std::FILE* f = std::fopen( aPath.c_str(), "rb" ) )
+		{
+			std::fclose( f );
+			return true;
+		}
+		return false;
+	}
+}
+
+GpuMesh load_mesh_asset( char const* aObjPath )
+{
+	auto const cooked = cooked_path( aObjPath, ".mesh" );
+	if( exists_( cooked ) )
+	{
+		try
+		{
+			return create_gpu_mesh( read_cooked_mesh( cooked.c_str() ) );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Note: ignoring cooked mesh: %s\n", eErr.what() );
+		}
+	}
+
+	return create_gpu_mesh( load_wavefront_obj( aObjPath ) );
+}
+
+GLuint load_texture_asset( char const* aImagePath )
+{
+	auto const cooked = cooked_path( aImagePath, ".tex" );
+	if( exists_( cooked ) )
+	{
+		try
+		{
+			return load_cooked_texture_2d( cooked.c_str() );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Note: ignoring cooked texture: %s\n", eErr.what() );
+		}
+	}
+
+	return load_texture_2d( aImagePath );
+}
@@ -0,0 +1,15 @@
+#ifndef ASSETS_HPP_61E2B0D7_3F5C_4A19_8D4E_C92A7B05E3F1
+#define ASSETS_HPP_61E2B0D7_3F5C_4A19_8D4E_C92A7B05E3F1
+
+#include <glad.h>
+
+#include "mesh.hpp"
+
+// Load assets, preferring the versions produced by the asset-cooker. If
+// there is no cooked version next to the source asset (in the "cooked"
+// subdirectory), or if it cannot be loaded, the source asset is loaded and
+// processed at runtime instead.
+GpuMesh load_mesh_asset( char const* aObjPath );
+GLuint load_texture_asset( char const* aImagePath );
+
+#endif // ASSETS_HPP_61E2B0D7_3F5C_4A19_8D4E_C92A7B05E3F1
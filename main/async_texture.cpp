@@ -0,0 +1,458 @@
+#include "async_texture.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include <cstdio>
+#include <cstring>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+#include "../support/mipmap.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "texture.hpp"
+
+struct AsyncTextureLoader::Decoded_
+{
+	Id id;
+	std::string path;
+	std::string error;
+	bool fromCooked = false;
+
+	CookedTexture cooked;              // if a cooked version was loaded
+	std::vector<Rgba8Image> mips;      // otherwise: RGBA8 levels
+
+	CookedTextureFormat format = CookedTextureFormat::rgba8srgb;
+	std::uint32_t levelCount = 0;
+
+	struct Level
+	{
+		std::uint8_t const* data;
+		std::size_t size;
+		std::uint32_t width, height;
+	} levels[kCookedMaxLevels];
+};
+
+struct AsyncTextureLoader::Entry_
+{
+	std::string path;
+	GLuint placeholder = 0;
+	GLuint texture = 0;
+
+	// The decoded data is kept, so that evicted levels can be streamed in
+	// again later.
+	std::unique_ptr<Decoded_> data;
+	GLenum internalFormat = GL_NONE;
+
+	// Levels are numbered as in the source image. Level 0 of the texture
+	// object is baseLevel; levels from residentLevel on are uploaded. Levels
+	// are uploaded from coarse to fine, one row (or row of blocks) at a time.
+	std::uint32_t baseLevel = 0;
+	std::uint32_t residentLevel = 0;
+	std::uint32_t wantedLevel = 0;
+	std::uint32_t row = 0;
+
+	float requestedTexels = 0.f;
+	std::uint32_t idleFrames = 0;  // frames during which fewer levels were wanted
+};
+
+namespace
+{
+	// Levels that have not been wanted for this many frames are evicted.
+	// This avoids thrashing when the camera moves back and forth.
+	constexpr std::uint32_t kEvictFrames_ = 120;
+
+	bool file_exists_( std::string const& aPath )
+	{
+		if( std::FILE* f = std::fopen( aPath.c_str(), "rb" ) )
+		{
+			std::fclose( f );
+			return true;
+		}
+		return false;
+	}
+}
+
+AsyncTextureLoader::AsyncTextureLoader( std::size_t aUploadBytesPerFrame, std::size_t aWorkerCount )
+	: mUploadBytesPerFrame( aUploadBytesPerFrame )
+{
+	glGenBuffers( GLsizei(kPboCount_), mPbos );
+
+	for( std::size_t i = 0; i < std::max<std::size_t>( 1, aWorkerCount ); ++i )
+		mWorkers.emplace_back( [this] { worker_(); } );
+}
+
+AsyncTextureLoader::~AsyncTextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	for( auto& worker : mWorkers )
+		worker.join();
+
+	for( auto const& entry : mEntries )
+	{
+		if( 0 != entry.texture )
+			glDeleteTextures( 1, &entry.texture );
+	}
+
+	glDeleteBuffers( GLsizei(kPboCount_), mPbos );
+}
+
+AsyncTextureLoader::Id AsyncTextureLoader::load( char const* aPath, GLuint aPlaceholder )
+{
+	Id const id = mEntries.size();
+
+	Entry_ entry;
+	entry.path = aPath;
+	entry.placeholder = aPlaceholder;
+	mEntries.emplace_back( std::move(entry) );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mRequests.push_back( Request_{ id, aPath, true } );
+	}
+	mWake.notify_one();
+
+	return id;
+}
+
+void AsyncTextureLoader::request_resolution( Id aId, float aTexels ) noexcept
+{
+	auto& entry = mEntries[aId];
+	entry.requestedTexels = std::max( entry.requestedTexels, aTexels );
+}
+
+GLuint AsyncTextureLoader::texture( Id aId ) const noexcept
+{
+	auto const& entry = mEntries[aId];
+	if( !entry.data || entry.residentLevel >= entry.data->levelCount )
+		return entry.placeholder;
+
+	return entry.texture;
+}
+
+bool AsyncTextureLoader::ready( Id aId ) const noexcept
+{
+	auto const& entry = mEntries[aId];
+	return entry.data && entry.residentLevel <= entry.wantedLevel;
+}
+
+std::size_t AsyncTextureLoader::resident_bytes() const noexcept
+{
+	std::size_t bytes = 0;
+	for( auto const& entry : mEntries )
+	{
+		if( !entry.data || 0 == entry.texture )
+			continue;
+
+		for( std::uint32_t i = entry.baseLevel; i < entry.data->levelCount; ++i )
+			bytes += entry.data->levels[i].size;
+	}
+	return bytes;
+}
+
+void AsyncTextureLoader::update()
+{
+	// Pick up decoded textures
+	std::vector<std::unique_ptr<Decoded_>> finished;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		finished.swap( mFinished );
+	}
+
+	for( auto& decoded : finished )
+	{
+		auto& entry = mEntries[decoded->id];
+		if( !decoded->error.empty() )
+			throw Error( "AsyncTextureLoader: %s", decoded->error.c_str() );
+
+		entry.data = std::move(decoded);
+		begin_streaming_( entry );
+	}
+
+	// Update the wanted levels and upload slices until the budget for this
+	// frame is used up
+	std::size_t budget = mUploadBytesPerFrame;
+	bool touched = false;
+	for( auto& entry : mEntries )
+	{
+		if( !entry.data )
+			continue;
+
+		auto const& data = *entry.data;
+
+		// Coarsest level that still has the requested resolution
+		std::uint32_t const size = std::max( data.levels[0].width, data.levels[0].height );
+
+		std::uint32_t wanted = 0;
+		while( wanted+1 < data.levelCount && float(size >> (wanted+1)) >= entry.requestedTexels )
+			++wanted;
+
+		entry.wantedLevel = wanted;
+		entry.requestedTexels = 0.f;
+
+		if( wanted < entry.baseLevel )
+		{
+			// Need finer levels: grow right away
+			entry.idleFrames = 0;
+			reallocate_( entry, wanted );
+			touched = true;
+		}
+		else if( wanted > entry.baseLevel )
+		{
+			if( ++entry.idleFrames >= kEvictFrames_ )
+			{
+				entry.idleFrames = 0;
+				reallocate_( entry, wanted );
+				touched = true;
+			}
+		}
+		else
+		{
+			entry.idleFrames = 0;
+		}
+
+		if( 0 == budget || entry.residentLevel <= std::max( entry.baseLevel, wanted ) )
+			continue;
+
+		touched = true;
+		glBindTexture( GL_TEXTURE_2D, entry.texture );
+		while( budget > 0 && entry.residentLevel > std::max( entry.baseLevel, wanted ) )
+			upload_slice_( entry, budget );
+	}
+
+	if( touched )
+	{
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		OGL_CHECKPOINT_DEBUG();
+	}
+}
+
+void AsyncTextureLoader::begin_streaming_( Entry_& aEntry )
+{
+	auto& data = *aEntry.data;
+
+	try
+	{
+		aEntry.internalFormat = cooked_texture_internal_format( data.format, aEntry.path.c_str() );
+	}
+	catch( std::exception const& eErr )
+	{
+		if( !data.fromCooked )
+			throw;
+
+		// The cooked format is not supported here. Decode the source image
+		// instead, like load_texture_asset() does.
+		std::fprintf( stderr, "Note: ignoring cooked texture: %s\n", eErr.what() );
+		Request_ request{ data.id, aEntry.path, false };
+		aEntry.data.reset();
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mRequests.push_back( std::move(request) );
+		}
+		mWake.notify_one();
+		return;
+	}
+
+	// Nothing is allocated or resident yet. update() allocates the levels
+	// that are wanted.
+	aEntry.baseLevel = data.levelCount;
+	aEntry.residentLevel = data.levelCount;
+	aEntry.row = 0;
+}
+
+void AsyncTextureLoader::reallocate_( Entry_& aEntry, std::uint32_t aBaseLevel )
+{
+	auto const& data = *aEntry.data;
+
+	// Immutable storage for levels aBaseLevel and up. Slices are uploaded
+	// with glTex(Compressed)SubImage2D().
+	GLuint tex = 0;
+	glGenTextures( 1, &tex );
+	glBindTexture( GL_TEXTURE_2D, tex );
+	glTexStorage2D( GL_TEXTURE_2D, GLsizei(data.levelCount-aBaseLevel), aEntry.internalFormat, GLsizei(data.levels[aBaseLevel].width), GLsizei(data.levels[aBaseLevel].height) );
+
+	// Copy the complete levels that are kept. A partially uploaded level
+	// is restarted.
+	std::uint32_t const keep = std::max( aBaseLevel, aEntry.residentLevel );
+	if( 0 != aEntry.texture )
+	{
+		for( std::uint32_t i = keep; i < data.levelCount; ++i )
+		{
+			glCopyImageSubData(
+				aEntry.texture, GL_TEXTURE_2D, GLint(i-aEntry.baseLevel), 0, 0, 0,
+				tex, GL_TEXTURE_2D, GLint(i-aBaseLevel), 0, 0, 0,
+				GLsizei(data.levels[i].width), GLsizei(data.levels[i].height), 1
+			);
+		}
+
+		glDeleteTextures( 1, &aEntry.texture );
+	}
+
+	configure_texture_2d( GLint(data.levelCount-1-aBaseLevel) );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(std::min( keep, data.levelCount-1 ) - aBaseLevel) );
+
+	aEntry.texture = tex;
+	aEntry.baseLevel = aBaseLevel;
+	aEntry.residentLevel = keep;
+	aEntry.row = 0;
+}
+
+bool AsyncTextureLoader::upload_slice_( Entry_& aEntry, std::size_t& aBudget )
+{
+	auto& data = *aEntry.data;
+
+	std::uint32_t const levelIndex = aEntry.residentLevel-1;
+	auto const& level = data.levels[levelIndex];
+
+	std::size_t const blockBytes = cooked_block_bytes( data.format );
+	bool const compressed = 0 != blockBytes;
+
+	std::uint32_t const rows = compressed ? (level.height+3)/4 : level.height;
+	std::size_t const rowBytes = compressed ? std::size_t((level.width+3)/4) * blockBytes : std::size_t(level.width) * 4;
+
+	// Always make progress with at least one row per frame, but do not
+	// start a row that does not fit once something has been uploaded.
+	if( aBudget < rowBytes && aBudget < mUploadBytesPerFrame )
+	{
+		aBudget = 0;
+		return false;
+	}
+
+	std::uint32_t const count = std::min<std::uint32_t>( rows - aEntry.row, std::uint32_t(std::max<std::size_t>( 1, aBudget / rowBytes )) );
+	std::size_t const bytes = count * rowBytes;
+
+	// Orphan the buffer and fill it. Round-robin over a few buffers, so that
+	// the driver can overlap the copies with rendering.
+	GLuint const pbo = mPbos[mNextPbo];
+	mNextPbo = (mNextPbo+1) % kPboCount_;
+
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+	glBufferData( GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW );
+	if( void* dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT ) )
+	{
+		std::memcpy( dst, level.data + aEntry.row * rowBytes, bytes );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+	}
+
+	GLint const target = GLint(levelIndex - aEntry.baseLevel);
+	if( compressed )
+	{
+		GLint const y = GLint(aEntry.row * 4);
+		GLsizei const height = std::min( GLsizei(count * 4), GLsizei(level.height) - y );
+		glCompressedTexSubImage2D( GL_TEXTURE_2D, target, 0, y, GLsizei(level.width), height, aEntry.internalFormat, GLsizei(bytes), nullptr );
+	}
+	else
+	{
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+		glTexSubImage2D( GL_TEXTURE_2D, target, 0, GLint(aEntry.row), GLsizei(level.width), GLsizei(count), GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	}
+
+	aBudget -= std::min( aBudget, bytes );
+	aEntry.row += count;
+
+	if( aEntry.row < rows )
+		return false;
+
+	// Level complete: allow sampling from it
+	aEntry.row = 0;
+	aEntry.residentLevel = levelIndex;
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, target );
+	return true;
+}
+
+void AsyncTextureLoader::worker_()
+{
+	// Matches load_texture_2d(). This only affects the calling thread.
+	stbi_set_flip_vertically_on_load_thread( 1 );
+
+	for( ;; )
+	{
+		Request_ request;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mWake.wait( lock, [this] { return mQuit || !mRequests.empty(); } );
+
+			if( mQuit )
+				return;
+
+			request = std::move(mRequests.front());
+			mRequests.pop_front();
+		}
+
+		auto decoded = std::make_unique<Decoded_>();
+		decoded->id = request.id;
+		decoded->path = request.path;
+
+		auto const cookedPath = cooked_path( decoded->path, ".tex" );
+		if( request.allowCooked && file_exists_( cookedPath ) )
+		{
+			try
+			{
+				decoded->cooked = read_cooked_texture( cookedPath.c_str() );
+				decoded->fromCooked = true;
+			}
+			catch( std::exception const& eErr )
+			{
+				std::fprintf( stderr, "Note: ignoring cooked texture: %s\n", eErr.what() );
+			}
+		}
+
+		try
+		{
+			if( decoded->fromCooked )
+			{
+				auto const& header = *decoded->cooked.header;
+				decoded->format = header.format;
+				decoded->levelCount = header.levelCount;
+				for( std::uint32_t i = 0; i < header.levelCount; ++i )
+				{
+					auto const& level = header.levels[i];
+					decoded->levels[i] = { decoded->cooked.level_data( i ), std::size_t(level.size), level.width, level.height };
+				}
+			}
+			else
+			{
+				// The mip chain is built here rather than with
+				// glGenerateMipmap(), since the levels are uploaded (and
+				// possibly evicted) individually.
+				int w, h, channels;
+				stbi_uc* ptr = stbi_load( decoded->path.c_str(), &w, &h, &channels, 4 );
+				if( !ptr )
+					throw Error( "Unable to load image '%s'", decoded->path.c_str() );
+
+				if( mip_level_count( std::uint32_t(w), std::uint32_t(h) ) > kCookedMaxLevels )
+				{
+					stbi_image_free( ptr );
+					throw Error( "Image '%s' is too large (%d x %d)", decoded->path.c_str(), w, h );
+				}
+
+				decoded->mips = build_srgb_mip_chain( Rgba8Image{ std::uint32_t(w), std::uint32_t(h), std::vector<std::uint8_t>( ptr, ptr + std::size_t(w)*h*4 ) } );
+				stbi_image_free( ptr );
+
+				decoded->levelCount = std::uint32_t(decoded->mips.size());
+				for( std::uint32_t i = 0; i < decoded->levelCount; ++i )
+				{
+					auto const& mip = decoded->mips[i];
+					decoded->levels[i] = { mip.rgba.data(), mip.rgba.size(), mip.width, mip.height };
+				}
+			}
+		}
+		catch( std::exception const& eErr )
+		{
+			decoded->error = eErr.what();
+		}
+
+		std::lock_guard<std::mutex> lock( mMutex );
+		mFinished.emplace_back( std::move(decoded) );
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef ASYNC_TEXTURE_HPP_4E9B2C71_0D3A_4F85_A6C8_1B7E5D29F034
+#define ASYNC_TEXTURE_HPP_4E9B2C71_0D3A_4F85_A6C8_1B7E5D29F034
+
+#include <glad.h>
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include <cstdint>
+#include <cstdlib>
+
+/* Asynchronous, progressive texture loading
+ *
+ * Textures are read and decoded on worker threads (cooked versions are
+ * preferred, like load_texture_asset() does). The decoded levels are then
+ * streamed to the GPU from the main thread through a small ring of pixel
+ * unpack buffers, a few rows at a time, such that at most a fixed number of
+ * bytes are uploaded per frame.
+ *
+ * Levels are uploaded from the smallest one up. GL_TEXTURE_BASE_LEVEL is
+ * clamped to the finest level that is complete, so the texture can be used
+ * as soon as its 1x1 level is in. Finer levels are only loaded when they
+ * are requested via request_resolution(). Storage for levels that have not
+ * been requested for a while is released again (by moving the remaining
+ * levels into a smaller texture), so that resident GPU memory follows what
+ * is visible. The decoded data stays in system memory.
+ *
+ * Until the first level has been uploaded, a placeholder texture stands in.
+ * The texture object may change when levels are added or evicted, so query
+ * texture() each frame.
+ *
+ * All methods must be called from the thread that owns the GL context.
+ */
+class AsyncTextureLoader final
+{
+	public:
+		using Id = std::size_t;
+
+	public:
+		explicit AsyncTextureLoader(
+			std::size_t aUploadBytesPerFrame = 4*1024*1024,
+			std::size_t aWorkerCount = 2
+		);
+
+		~AsyncTextureLoader();
+
+		AsyncTextureLoader( AsyncTextureLoader const& ) = delete;
+		AsyncTextureLoader& operator= (AsyncTextureLoader const&) = delete;
+
+	public:
+		// Starts loading a texture. texture() returns aPlaceholder until the
+		// texture can be used. The placeholder is not owned by the loader.
+		Id load( char const* aPath, GLuint aPlaceholder );
+
+		// Requests a resolution of at least aTexels along the larger side of
+		// the texture (e.g., the number of pixels it covers on screen). Call
+		// each frame in which the texture is used; the largest request of a
+		// frame wins. Without requests, only the smallest level is kept.
+		void request_resolution( Id, float aTexels ) noexcept;
+
+		// Call once per frame: picks up decoded textures, adds or evicts
+		// levels based on the previous frame's requests and uploads the next
+		// slices. Throws Error if a texture failed to load.
+		void update();
+
+		GLuint texture( Id ) const noexcept;
+
+		// True once all requested levels are resident
+		bool ready( Id ) const noexcept;
+
+		// GPU memory currently allocated for the textures, in bytes
+		std::size_t resident_bytes() const noexcept;
+
+	private:
+		struct Decoded_;
+		struct Entry_;
+
+		struct Request_
+		{
+			Id id;
+			std::string path;
+			bool allowCooked;
+		};
+
+		void worker_();
+		void begin_streaming_( Entry_& );
+		void reallocate_( Entry_&, std::uint32_t aBaseLevel );
+		bool upload_slice_( Entry_&, std::size_t& aBudget );
+
+	private:
+		std::size_t mUploadBytesPerFrame;
+
+		std::vector<Entry_> mEntries;
+
+		static constexpr std::size_t kPboCount_ = 3;
+		GLuint mPbos[kPboCount_] = {};
+		std::size_t mNextPbo = 0;
+
+		// Shared with the workers
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		bool mQuit = false;
+		std::deque<Request_> mRequests;
+		std::vector<std::unique_ptr<Decoded_>> mFinished;
+
+		std::vector<std::thread> mWorkers;
+};
+
+#endif // ASYNC_TEXTURE_HPP_4E9B2C71_0D3A_4F85_A6C8_1B7E5D29F034
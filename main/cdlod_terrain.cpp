@@ -0,0 +1,417 @@
+#include "cdlod_terrain.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "../support/error.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "shader_bindings.hpp"
+#include "uniform_blocks.hpp"
+
+namespace
+{
+	namespace terrainVert_ = shader_bindings::terrain_vert;
+	namespace defaultVert_ = shader_bindings::default_vert;
+
+	// Distance range of level 0, in diagonals of a level 0 node. Must be
+	// large enough that neighbouring patches differ by at most one level,
+	// and that a patch has fully morphed where it meets the next level.
+	constexpr float kLodRangeScale_ = 4.f;
+
+	// Fraction of a level's range (from the previous level's) after which
+	// its vertices start to morph
+	constexpr float kMorphStart_ = 0.66f;
+
+	// Mirror of TerrainBlock in terrain.vert (std140)
+	struct TerrainBlock_
+	{
+		Vec4f area;       // xy: world x,z of the maps' origin, zw: their world size
+		Vec4f grid;       // x: quads per patch side
+		Vec4f morph[CdlodTerrain::kMaxLevels]; // x: morph start, y: 1/(morph end - start)
+	};
+
+	static_assert( sizeof(TerrainBlock_) == 160 );
+
+	GLuint create_map_( GLenum aFormat, GLsizei aSize )
+	{
+		GLuint tex = 0;
+		glGenTextures( 1, &tex );
+		glBindTexture( GL_TEXTURE_2D, tex );
+		glTexStorage2D( GL_TEXTURE_2D, 1, aFormat, aSize, aSize );
+
+		// Sampled with textureLod( ..., 0 ) only
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+		return tex;
+	}
+}
+
+CdlodTerrain::CdlodTerrain( GpuMesh const& aMesh, ProgramPipeline& aBake, std::uint32_t aResolution )
+	: mResolution( aResolution )
+	, mLevels( 1 )
+	, mOriginX( aMesh.boundsMin.x )
+	, mOriginZ( aMesh.boundsMin.z )
+	, mSizeX( aMesh.boundsMax.x - aMesh.boundsMin.x )
+	, mSizeZ( aMesh.boundsMax.z - aMesh.boundsMin.z )
+{
+	if( aResolution < kPatchQuads || 0 != (aResolution & (aResolution - 1)) )
+		throw Error( "CdlodTerrain: resolution %u is not a power of two of at least %u", aResolution, kPatchQuads );
+	if( !(mSizeX > 0.f && mSizeZ > 0.f) )
+		throw Error( "CdlodTerrain: mesh has no extent in x or z" );
+
+	// The root node covers the whole map
+	while( (kPatchQuads << mLevels) <= aResolution )
+		++mLevels;
+
+	if( mLevels > kMaxLevels )
+		throw Error( "CdlodTerrain: resolution %u needs %u levels, more than %u", aResolution, mLevels, kMaxLevels );
+
+	std::vector<float> heights;
+	bake_( aMesh, aBake, heights );
+	build_bounds_( heights );
+
+	GLsizei const size = GLsizei(mResolution);
+	mHeightmap = create_map_( GL_R32F, size );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, GL_FLOAT, heights.data() );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	// Level ranges double. The top level has no end, and does not morph.
+	float const leafDiagonal = float(kPatchQuads) / float(mResolution) * std::sqrt( mSizeX*mSizeX + mSizeZ*mSizeZ );
+
+	TerrainBlock_ block{};
+	block.area = Vec4f{ mOriginX, mOriginZ, mSizeX, mSizeZ };
+	block.grid = Vec4f{ float(kPatchQuads), 0.f, 0.f, 0.f };
+
+	float previous = 0.f;
+	for( std::uint32_t level = 0; level < mLevels; ++level )
+	{
+		if( level + 1 == mLevels )
+		{
+			mRanges[level] = std::numeric_limits<float>::max();
+			block.morph[level] = Vec4f{ std::numeric_limits<float>::max(), 0.f, 0.f, 0.f };
+			break;
+		}
+
+		mRanges[level] = kLodRangeScale_ * leafDiagonal * float(1u << level);
+
+		float const start = previous + kMorphStart_ * (mRanges[level] - previous);
+		block.morph[level] = Vec4f{ start, 1.f / (mRanges[level] - start), 0.f, 0.f };
+		previous = mRanges[level];
+	}
+
+	glGenBuffers( 1, &mTerrainBlock );
+	glBindBuffer( GL_UNIFORM_BUFFER, mTerrainBlock );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof(block), &block, GL_STATIC_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+	create_patch_();
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+CdlodTerrain::~CdlodTerrain()
+{
+	gl_state::delete_vertex_array( mVao );
+
+	GLuint const buffers[] = { mNodeBuffer, mPatchIndices, mPatchVertices, mTerrainBlock };
+	glDeleteBuffers( 4, buffers );
+
+	gl_state::delete_texture( mTexCoordMap );
+	gl_state::delete_texture( mHeightmap );
+}
+
+void CdlodTerrain::select( Frustum const& aFrustum, Vec3f aCamera )
+{
+	mNodes.clear();
+	mStats = Stats{};
+
+	select_( mLevels - 1, 0, 0, aFrustum, aCamera );
+
+	mStats.patches = mNodes.size();
+	mStats.triangles = mNodes.size() * 2 * kPatchQuads * kPatchQuads;
+
+	// New storage for the nodes: draws of the previous view may still be
+	// reading the old ones
+	glBindBuffer( GL_ARRAY_BUFFER, mNodeBuffer );
+	glBufferData( GL_ARRAY_BUFFER, mNodes.size() * sizeof(Vec4f), mNodes.data(), GL_STREAM_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	gl_state::bind_texture( terrainVert_::uHeightmap, mHeightmap );
+	gl_state::bind_texture( terrainVert_::uTexCoordMap, mTexCoordMap );
+	glBindBufferBase( GL_UNIFORM_BUFFER, terrainVert_::TerrainBlock, mTerrainBlock );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+RenderQueue::Draw CdlodTerrain::draw( ProgramPipeline& aPipeline, float aDepth ) const
+{
+	RenderQueue::Draw draw;
+	draw.pipeline = &aPipeline;
+	draw.vao = mVao;
+	draw.indexed = true;
+	draw.count = mPatchIndexCount;
+	draw.depth = aDepth;
+	draw.instanceCount = GLsizei(mNodes.size());
+	return draw;
+}
+
+std::size_t CdlodTerrain::patch_count() const noexcept
+{
+	return mNodes.size();
+}
+std::uint32_t CdlodTerrain::level_count() const noexcept
+{
+	return mLevels;
+}
+
+CdlodTerrain::Stats CdlodTerrain::stats() const noexcept
+{
+	return mStats;
+}
+
+void CdlodTerrain::bake_( GpuMesh const& aMesh, ProgramPipeline& aBake, std::vector<float>& aHeights )
+{
+	GLsizei const size = GLsizei(mResolution);
+
+	// Targets: the texture coordinates, kept as the texture coordinate map,
+	// and the depth, which becomes the heights
+	mTexCoordMap = create_map_( GL_RG32F, size );
+	GLuint const depth = create_map_( GL_DEPTH_COMPONENT32F, size );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	GLuint framebuffer = 0;
+	glGenFramebuffers( 1, &framebuffer );
+	gl_state::bind_framebuffer( framebuffer );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexCoordMap, 0 );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0 );
+
+	GLenum const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+	{
+		gl_state::bind_framebuffer( 0 );
+		glDeleteFramebuffers( 1, &framebuffer );
+		glDeleteTextures( 1, &depth );
+		throw Error( "CdlodTerrain: bake framebuffer incomplete: 0x%x", status );
+	}
+
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport );
+	glViewport( 0, 0, size, size );
+
+	gl_state::color_mask( true );
+	gl_state::depth_mask( true );
+	gl_state::depth_func( GL_LESS );
+
+	float const clearTexCoord[] = { 0.f, 0.f, 0.f, 0.f };
+	float const clearDepth = 1.f;
+	glClearBufferfv( GL_COLOR, 0, clearTexCoord );
+	glClearBufferfv( GL_DEPTH, 0, &clearDepth );
+
+	// Orthographic view from above: x and z of the bounds to [-1,1], and
+	// heights from the top (depth 0) to the bottom (depth 1), with a margin
+	// so that neither is clipped. The depth test keeps the highest surface.
+	float const margin = 0.01f * (aMesh.boundsMax.y - aMesh.boundsMin.y) + 1e-3f;
+	float const maxY = aMesh.boundsMax.y + margin;
+	float const sizeY = maxY - (aMesh.boundsMin.y - margin);
+
+	ViewBlock view{};
+	view.projCamera = Mat44f{ {
+		2.f / mSizeX, 0.f, 0.f, -2.f * mOriginX / mSizeX - 1.f,
+		0.f, 0.f, 2.f / mSizeZ, -2.f * mOriginZ / mSizeZ - 1.f,
+		0.f, -2.f / sizeY, 0.f, 2.f * maxY / sizeY - 1.f,
+		0.f, 0.f, 0.f, 1.f
+	} };
+
+	GLuint viewBuffer = 0;
+	glGenBuffers( 1, &viewBuffer );
+	glBindBuffer( GL_UNIFORM_BUFFER, viewBuffer );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof(view), &view, GL_STATIC_DRAW );
+	glBindBufferBase( GL_UNIFORM_BUFFER, kViewBlockBinding, viewBuffer );
+
+	// From above, the terrain's triangles may face either way
+	gl_state::set_enabled( GL_CULL_FACE, false );
+
+	aBake.bind();
+	aBake.set( defaultVert_::uModelWorld, kIdentity44f );
+	draw_gpu_mesh( aMesh );
+
+	gl_state::set_enabled( GL_CULL_FACE, true );
+
+	// Depth back to heights. Texels that the mesh does not cover are at the
+	// bottom.
+	aHeights.resize( std::size_t(size) * size );
+	glBindTexture( GL_TEXTURE_2D, depth );
+	glGetTexImage( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, aHeights.data() );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	for( auto& height : aHeights )
+		height = maxY - height * sizeY;
+
+	gl_state::bind_framebuffer( 0 );
+	glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	glDeleteBuffers( 1, &viewBuffer );
+	glDeleteFramebuffers( 1, &framebuffer );
+	glDeleteTextures( 1, &depth );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+void CdlodTerrain::build_bounds_( std::vector<float> const& aHeights )
+{
+	std::int64_t const size = mResolution;
+	std::uint32_t const leaves = mResolution / kPatchQuads;
+
+	mBounds.assign( mLevels, {} );
+
+	// Level 0: the texels under a node's vertices, which sample bilinearly
+	// between their two neighbouring texels per axis
+	mBounds[0].resize( std::size_t(leaves) * leaves );
+	for( std::uint32_t z = 0; z < leaves; ++z )
+	{
+		for( std::uint32_t x = 0; x < leaves; ++x )
+		{
+			std::int64_t const x0 = std::max<std::int64_t>( 0, std::int64_t(x) * kPatchQuads - 1 );
+			std::int64_t const z0 = std::max<std::int64_t>( 0, std::int64_t(z) * kPatchQuads - 1 );
+			std::int64_t const x1 = std::min<std::int64_t>( size - 1, std::int64_t(x + 1) * kPatchQuads );
+			std::int64_t const z1 = std::min<std::int64_t>( size - 1, std::int64_t(z + 1) * kPatchQuads );
+
+			Bounds_ bounds{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+			for( std::int64_t tz = z0; tz <= z1; ++tz )
+			{
+				for( std::int64_t tx = x0; tx <= x1; ++tx )
+				{
+					float const height = aHeights[std::size_t(tz * size + tx)];
+					bounds.minY = std::min( bounds.minY, height );
+					bounds.maxY = std::max( bounds.maxY, height );
+				}
+			}
+
+			mBounds[0][z * leaves + x] = bounds;
+		}
+	}
+
+	// Higher levels: union of the four children
+	for( std::uint32_t level = 1; level < mLevels; ++level )
+	{
+		std::uint32_t const nodes = leaves >> level;
+		std::uint32_t const children = nodes * 2;
+
+		auto const& below = mBounds[level - 1];
+		mBounds[level].resize( std::size_t(nodes) * nodes );
+		for( std::uint32_t z = 0; z < nodes; ++z )
+		{
+			for( std::uint32_t x = 0; x < nodes; ++x )
+			{
+				Bounds_ bounds{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+				for( std::uint32_t i = 0; i < 4; ++i )
+				{
+					Bounds_ const& child = below[(2*z + i/2) * children + 2*x + i%2];
+					bounds.minY = std::min( bounds.minY, child.minY );
+					bounds.maxY = std::max( bounds.maxY, child.maxY );
+				}
+
+				mBounds[level][z * nodes + x] = bounds;
+			}
+		}
+	}
+}
+
+void CdlodTerrain::create_patch_()
+{
+	// Vertices in [0,1]^2; triangles counter-clockwise seen from above
+	std::vector<Vec2f> vertices;
+	vertices.reserve( (kPatchQuads + 1) * (kPatchQuads + 1) );
+	for( std::uint32_t z = 0; z <= kPatchQuads; ++z )
+	{
+		for( std::uint32_t x = 0; x <= kPatchQuads; ++x )
+			vertices.push_back( Vec2f{ float(x) / kPatchQuads, float(z) / kPatchQuads } );
+	}
+
+	std::vector<std::uint32_t> indices;
+	indices.reserve( 6 * kPatchQuads * kPatchQuads );
+	for( std::uint32_t z = 0; z < kPatchQuads; ++z )
+	{
+		for( std::uint32_t x = 0; x < kPatchQuads; ++x )
+		{
+			std::uint32_t const i = z * (kPatchQuads + 1) + x;
+			std::uint32_t const below = i + kPatchQuads + 1;
+
+			indices.insert( indices.end(), { i, below, i + 1 } );
+			indices.insert( indices.end(), { i + 1, below, below + 1 } );
+		}
+	}
+
+	mPatchIndexCount = GLsizei(indices.size());
+
+	glGenBuffers( 1, &mPatchVertices );
+	glBindBuffer( GL_ARRAY_BUFFER, mPatchVertices );
+	glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof(Vec2f), vertices.data(), GL_STATIC_DRAW );
+
+	glGenBuffers( 1, &mNodeBuffer );
+	glGenBuffers( 1, &mPatchIndices );
+
+	glGenVertexArrays( 1, &mVao );
+	gl_state::bind_vertex_array( mVao );
+
+	glEnableVertexAttribArray( terrainVert_::iGrid );
+	glVertexAttribPointer( terrainVert_::iGrid, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
+
+	// One node per instance
+	glBindBuffer( GL_ARRAY_BUFFER, mNodeBuffer );
+	glEnableVertexAttribArray( terrainVert_::iNode );
+	glVertexAttribPointer( terrainVert_::iNode, 4, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glVertexAttribDivisor( terrainVert_::iNode, 1 );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mPatchIndices );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint32_t), indices.data(), GL_STATIC_DRAW );
+
+	gl_state::bind_vertex_array( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+Aabb CdlodTerrain::node_bounds_( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aZ ) const
+{
+	std::uint32_t const nodes = (mResolution / kPatchQuads) >> aLevel;
+	float const size = 1.f / float(nodes);
+	Bounds_ const& bounds = mBounds[aLevel][aZ * nodes + aX];
+
+	return Aabb{
+		{ mOriginX + aX * size * mSizeX, bounds.minY, mOriginZ + aZ * size * mSizeZ },
+		{ mOriginX + (aX + 1) * size * mSizeX, bounds.maxY, mOriginZ + (aZ + 1) * size * mSizeZ }
+	};
+}
+
+void CdlodTerrain::select_( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aZ, Frustum const& aFrustum, Vec3f aCamera )
+{
+	++mStats.nodesVisited;
+
+	Aabb const bounds = node_bounds_( aLevel, aX, aZ );
+	if( !intersects( aFrustum, bounds ) )
+		return;
+
+	// The node is drawn at its own level unless part of it is within the
+	// range of the level below, in which case its children are selected
+	float const below = 0 == aLevel ? 0.f : mRanges[aLevel - 1];
+	if( 0 == aLevel || distance_squared( bounds, aCamera ) > below * below )
+	{
+		float const size = float(kPatchQuads << aLevel) / float(mResolution);
+		mNodes.push_back( Vec4f{ aX * size, aZ * size, size, float(aLevel) } );
+		++mStats.patchesPerLevel[aLevel];
+		return;
+	}
+
+	for( std::uint32_t i = 0; i < 4; ++i )
+		select_( aLevel - 1, 2*aX + i%2, 2*aZ + i/2, aFrustum, aCamera );
+}
@@ -0,0 +1,126 @@
+#ifndef CDLOD_TERRAIN_HPP_5D0EE7D2_C380_41C3_88F9_B5BCFE5FFB37
+#define CDLOD_TERRAIN_HPP_5D0EE7D2_C380_41C3_88F9_B5BCFE5FFB37
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/frustum.hpp"
+
+#include "../support/program_pipeline.hpp"
+#include "../support/render_queue.hpp"
+
+#include "mesh.hpp"
+
+/* Continuous distance-dependent LOD (CDLOD) terrain
+ *
+ * After F. Strugar, "Continuous Distance-Dependent Level of Detail for
+ * Rendering Heightmaps" (2009). The terrain is a quadtree over a heightmap.
+ * Every node, at any level, is drawn with the same grid patch of
+ * kPatchQuads x kPatchQuads quads, as an instance of a single draw (see
+ * assets/terrain.vert), so that a node's triangles get twice as large with
+ * each level up. Each level covers a range of distances from the camera,
+ * doubling per level; select() picks, per view, the nodes in the frustum at
+ * the level of their distance. Towards the end of its range, a patch's
+ * vertices morph onto the grid of the next level, so that levels blend
+ * continuously and neighbouring patches meet without cracks.
+ *
+ * Triangle density thus follows the distance from the camera, and the
+ * number of patches per level is bounded; a terrain four times the area
+ * costs one more level.
+ *
+ * There is no heightmap among the assets, so the maps are baked from the
+ * terrain mesh: the constructor renders it from above, keeping the depth
+ * (heights) and the texture coordinates, so the terrain's texture applies
+ * as before. Overhangs are lost. The maps cover the mesh's x/z bounds, in
+ * its own coordinates.
+ */
+class CdlodTerrain final
+{
+	public:
+		static constexpr std::uint32_t kPatchQuads = 32;   // per side; a power of two
+		static constexpr std::uint32_t kMaxLevels = 8;     // see TerrainBlock in terrain.vert
+
+		// Of the last select()
+		struct Stats
+		{
+			std::size_t nodesVisited = 0;
+			std::size_t patches = 0;
+			std::size_t triangles = 0;
+			std::size_t patchesPerLevel[kMaxLevels] = {};
+		};
+
+	public:
+		// Bakes aResolution x aResolution maps (a power of two, at least
+		// kPatchQuads) from aMesh. aBake is the pipeline of default.vert and
+		// terrain_bake.frag. Changes the viewport, framebuffer, and uniform
+		// block bindings; throws Error if the resolution is not supported.
+		CdlodTerrain( GpuMesh const& aMesh, ProgramPipeline& aBake, std::uint32_t aResolution = 1024 );
+		~CdlodTerrain();
+
+		CdlodTerrain( CdlodTerrain const& ) = delete;
+		CdlodTerrain& operator= (CdlodTerrain const&) = delete;
+
+	public:
+		// Selects the patches of a view and uploads them. Each select()
+		// orphans the previous patches, so draws of earlier views are not
+		// affected. Binds the maps and the terrain block, which must stay
+		// bound until the view's draws have executed.
+		void select( Frustum const& aFrustum, Vec3f aCamera );
+
+		// Draw of the patches of the last select(), with a pipeline whose
+		// vertex stage is terrain.vert. Not textured; set Draw::texture to
+		// the terrain's texture as needed.
+		RenderQueue::Draw draw( ProgramPipeline& aPipeline, float aDepth ) const;
+
+		std::size_t patch_count() const noexcept;
+		std::uint32_t level_count() const noexcept;
+
+		Stats stats() const noexcept;
+
+	private:
+		struct Bounds_
+		{
+			float minY, maxY;
+		};
+
+		void bake_( GpuMesh const&, ProgramPipeline&, std::vector<float>& aHeights );
+		void build_bounds_( std::vector<float> const& aHeights );
+		void create_patch_();
+
+		Aabb node_bounds_( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aZ ) const;
+		void select_( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aZ, Frustum const&, Vec3f aCamera );
+
+	private:
+		std::uint32_t mResolution;
+		std::uint32_t mLevels;
+
+		float mOriginX, mOriginZ;      // world x,z of the maps' [0,0] corner
+		float mSizeX, mSizeZ;
+		float mRanges[kMaxLevels];     // per level, the distance up to which it is used
+
+		// Per level, per node (row-major, z then x): height bounds
+		std::vector<std::vector<Bounds_>> mBounds;
+
+		GLuint mHeightmap = 0;         // R32F
+		GLuint mTexCoordMap = 0;       // RG32F
+		GLuint mTerrainBlock = 0;
+
+		GLuint mPatchVertices = 0;
+		GLuint mPatchIndices = 0;
+		GLsizei mPatchIndexCount = 0;
+
+		GLuint mNodeBuffer = 0;        // per-instance nodes, see terrain.vert
+		GLuint mVao = 0;
+
+		std::vector<Vec4f> mNodes;     // of the last select()
+		Stats mStats;
+};
+
+#endif // CDLOD_TERRAIN_HPP_5D0EE7D2_C380_41C3_88F9_B5BCFE5FFB37
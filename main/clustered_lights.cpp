@@ -0,0 +1,188 @@
+#include "clustered_lights.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	namespace clusters_ = shader_bindings::clusters_glsl;
+}
+
+ClusteredLights::ClusteredLights()
+{
+	glGenBuffers( 1, &mLightBuffer );
+	glGenBuffers( 1, &mRangeBuffer );
+	glGenBuffers( 1, &mIndexBuffer );
+
+	mRanges.resize( 2 * kClusterCount );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	glDeleteBuffers( 1, &mIndexBuffer );
+	glDeleteBuffers( 1, &mRangeBuffer );
+	glDeleteBuffers( 1, &mLightBuffer );
+}
+
+void ClusteredLights::set_lights( std::vector<PointLight> const& aLights )
+{
+	mLightSpheres.clear();
+	for( auto const& light : aLights )
+		mLightSpheres.emplace_back( light.positionRadius );
+
+	upload_( mLightBuffer, mLightCapacity, aLights.data(), aLights.size() * sizeof(PointLight) );
+}
+
+void ClusteredLights::build( View const& aView, ViewBlock& aBlock )
+{
+	float const logDepthRatio = std::log( aView.zFar / aView.zNear );
+	float const sliceScale = kClusterZ / logDepthRatio;
+	float const sliceBias = -kClusterZ * std::log( aView.zNear ) / logDepthRatio;
+
+	float sliceDepths[kClusterZ+1];
+	for( std::uint32_t s = 0; s <= kClusterZ; ++s )
+		sliceDepths[s] = aView.zNear * std::exp( s * logDepthRatio / kClusterZ );
+
+	auto const slice_ = [&] (float aDepth) {
+		int const s = int(std::floor( std::log( aDepth ) * sliceScale + sliceBias ));
+		return std::clamp( s, 0, int(kClusterZ)-1 );
+	};
+
+	float const tanY = std::tan( aView.fovY / 2.f );
+	float const tanX = tanY * aView.aspect;
+
+	// Tiles covered by [aMin, aMax] (view space) over depths aNear..aFar.
+	// x/depth is monotonic in depth, so the extremes are at either depth.
+	auto const tiles_ = [] (float aMin, float aMax, float aNear, float aFar, float aTan, std::uint32_t aCount, int& aFirst, int& aLast) {
+		float const lo = std::min( aMin / aNear, aMin / aFar ) / aTan;
+		float const hi = std::max( aMax / aNear, aMax / aFar ) / aTan;
+
+		aFirst = int(std::floor( (lo * .5f + .5f) * aCount ));
+		aLast = int(std::floor( (hi * .5f + .5f) * aCount ));
+		if( aLast < 0 || aFirst >= int(aCount) )
+			return false;
+
+		aFirst = std::max( aFirst, 0 );
+		aLast = std::min( aLast, int(aCount)-1 );
+		return true;
+	};
+
+	// Collect (cluster, light) pairs
+	mPairs.clear();
+	std::fill( mRanges.begin(), mRanges.end(), 0 );
+
+	mStats = Stats{};
+	mStats.lights = mLightSpheres.size();
+
+	for( std::size_t i = 0; i < mLightSpheres.size(); ++i )
+	{
+		Vec4f const& sphere = mLightSpheres[i];
+		Vec4f const center = aView.world2camera * Vec4f{ sphere.x, sphere.y, sphere.z, 1.f };
+		float const radius = sphere.w;
+
+		// The camera looks along -z
+		float const depth = -center.z;
+		if( depth + radius < aView.zNear || depth - radius > aView.zFar )
+			continue;
+
+		float const depthMin = std::max( depth - radius, aView.zNear );
+		float const depthMax = std::min( depth + radius, aView.zFar );
+
+		bool visible = false;
+		for( int s = slice_( depthMin ), last = slice_( depthMax ); s <= last; ++s )
+		{
+			float const nearDepth = std::max( depthMin, sliceDepths[s] );
+			float const farDepth = std::min( depthMax, sliceDepths[s+1] );
+
+			int x0, x1, y0, y1;
+			if( !tiles_( center.x - radius, center.x + radius, nearDepth, farDepth, tanX, kClusterX, x0, x1 ) )
+				continue;
+			if( !tiles_( center.y - radius, center.y + radius, nearDepth, farDepth, tanY, kClusterY, y0, y1 ) )
+				continue;
+
+			for( int y = y0; y <= y1; ++y )
+			{
+				for( int x = x0; x <= x1; ++x )
+				{
+					std::uint32_t const cluster = x + kClusterX * (y + kClusterY * s);
+					mPairs.emplace_back( cluster );
+					mPairs.emplace_back( std::uint32_t(i) );
+					++mRanges[2*cluster+1];
+				}
+			}
+
+			visible = true;
+		}
+
+		if( visible )
+			++mStats.visibleLights;
+	}
+
+	// Counting sort of the pairs by cluster
+	std::uint32_t offset = 0;
+	for( std::uint32_t c = 0; c < kClusterCount; ++c )
+	{
+		std::uint32_t const count = mRanges[2*c+1];
+		mRanges[2*c+0] = offset;
+		mStats.maxPerCluster = std::max<std::size_t>( mStats.maxPerCluster, count );
+		offset += count;
+	}
+
+	mIndices.resize( offset );
+	for( std::size_t p = 0; p < mPairs.size(); p += 2 )
+	{
+		// Fills each list back to front, counting down; the counts are
+		// restored from the offsets below
+		std::uint32_t const cluster = mPairs[p];
+		std::uint32_t const slot = mRanges[2*cluster] + mRanges[2*cluster+1] - 1;
+		mIndices[slot] = mPairs[p+1];
+		--mRanges[2*cluster+1];
+	}
+	for( std::uint32_t c = 0; c < kClusterCount; ++c )
+	{
+		std::uint32_t const next = c+1 < kClusterCount ? mRanges[2*(c+1)] : offset;
+		mRanges[2*c+1] = next - mRanges[2*c];
+	}
+
+	mStats.entries = offset;
+
+	upload_( mRangeBuffer, mRangeCapacity, mRanges.data(), mRanges.size() * sizeof(std::uint32_t) );
+	upload_( mIndexBuffer, mIndexCapacity, mIndices.data(), mIndices.size() * sizeof(std::uint32_t) );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, clusters_::PointLights, mLightBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, clusters_::ClusterRanges, mRangeBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, clusters_::ClusterLightIndices, mIndexBuffer );
+
+	aBlock.clusterGrid[0] = kClusterX;
+	aBlock.clusterGrid[1] = kClusterY;
+	aBlock.clusterGrid[2] = kClusterZ;
+	aBlock.clusterGrid[3] = 0;
+	aBlock.clusterDepth = Vec4f{ aView.zNear, aView.zFar, sliceScale, sliceBias };
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+ClusteredLights::Stats ClusteredLights::stats() const noexcept
+{
+	return mStats;
+}
+
+void ClusteredLights::upload_( GLuint aBuffer, GLsizeiptr& aCapacity, void const* aData, std::size_t aSize )
+{
+	// Orphan the previous contents, which the GPU may still be reading (the
+	// lists are rebuilt for each view). Buffers always get some storage, even
+	// without lights, as the shaders index into them.
+	GLsizeiptr const size = GLsizeiptr(std::max<std::size_t>( aSize, sizeof(std::uint32_t) ));
+	aCapacity = std::max( aCapacity, size );
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, aBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, aCapacity, nullptr, GL_STREAM_DRAW );
+	if( aSize )
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(aSize), aData );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
@@ -0,0 +1,105 @@
+#ifndef CLUSTERED_LIGHTS_HPP_5F2A9C1E_7B34_4D86_A0E5_C93D18B6F247
+#define CLUSTERED_LIGHTS_HPP_5F2A9C1E_7B34_4D86_A0E5_C93D18B6F247
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "shader_bindings.hpp"
+#include "uniform_blocks.hpp"
+
+// C++ mirror of the std430 PointLight struct in assets/clusters.glsl
+struct PointLight
+{
+	Vec4f positionRadius; // xyz: world position, w: radius of influence
+	Vec4f diffuse;
+	Vec4f specular;
+};
+
+static_assert( sizeof(PointLight) == 48 );
+
+/* Clustered point lights
+ *
+ * Splits the view frustum into a grid of clusters: kClusterX by kClusterY
+ * tiles on screen, and kClusterZ slices in depth. Slices are spaced
+ * exponentially between the near and far planes, so that clusters stay
+ * roughly cube-shaped. Each cluster lists the point lights whose sphere of
+ * influence may overlap it; the fragment shader only evaluates the lights of
+ * its own cluster (see assets/clusters.glsl).
+ *
+ * The lists are built on the CPU, once per view. Per depth slice, a light is
+ * added to the tiles covered by the screen bounds of its bounding box, which
+ * is conservative but cheap enough for a few hundred lights.
+ */
+class ClusteredLights final
+{
+	public:
+		static constexpr std::uint32_t kClusterX = 16;
+		static constexpr std::uint32_t kClusterY = 9;
+		static constexpr std::uint32_t kClusterZ = 24;
+		static constexpr std::uint32_t kClusterCount = kClusterX * kClusterY * kClusterZ;
+
+		struct View
+		{
+			Mat44f world2camera;
+			float fovY;          // vertical, in radians
+			float aspect;
+			float zNear, zFar;
+		};
+
+		struct Stats
+		{
+			std::size_t lights = 0;
+			std::size_t visibleLights = 0;   // lights in at least one cluster
+			std::size_t entries = 0;         // total length of the light lists
+			std::size_t maxPerCluster = 0;
+		};
+
+	public:
+		ClusteredLights();
+		~ClusteredLights();
+
+		ClusteredLights( ClusteredLights const& ) = delete;
+		ClusteredLights& operator= (ClusteredLights const&) = delete;
+
+	public:
+		// Uploads the frame's lights (world space). Call before build().
+		void set_lights( std::vector<PointLight> const& aLights );
+
+		// Builds and uploads the light lists of a view, binds the buffers to
+		// their shader storage bindings and fills in the cluster parameters
+		// of the view's uniform block.
+		void build( View const& aView, ViewBlock& aBlock );
+
+		// Of the last build()
+		Stats stats() const noexcept;
+
+	private:
+		void upload_( GLuint aBuffer, GLsizeiptr& aCapacity, void const* aData, std::size_t aSize );
+
+	private:
+		GLuint mLightBuffer = 0;
+		GLuint mRangeBuffer = 0;
+		GLuint mIndexBuffer = 0;
+
+		GLsizeiptr mLightCapacity = 0;
+		GLsizeiptr mRangeCapacity = 0;
+		GLsizeiptr mIndexCapacity = 0;
+
+		std::vector<Vec4f> mLightSpheres;        // positions and radii, world space
+
+		// Scratch, kept between builds to avoid allocations
+		std::vector<std::uint32_t> mPairs;       // (cluster, light), interleaved
+		std::vector<std::uint32_t> mRanges;      // (first, count) per cluster
+		std::vector<std::uint32_t> mIndices;
+
+		Stats mStats;
+};
+
+#endif // CLUSTERED_LIGHTS_HPP_5F2A9C1E_7B34_4D86_A0E5_C93D18B6F247
@@ -0,0 +1,166 @@
+#include "culled_instances.hpp"
+
+#include <limits>
+
+
+#include "../vmlib/aabb.hpp"
+
+#include "../support/error.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "shader_bindings.hpp"
+
+namespace
+{
+	namespace cull_ = shader_bindings::cull_comp;
+	namespace instances_ = shader_bindings::instances_glsl;
+
+	// DrawElementsIndirectCommand; DrawArraysIndirectCommand is padded to
+	// the same size (see cull.comp)
+	constexpr std::size_t kCommandSize_ = 5;
+
+	constexpr GLuint kWorkGroupSize_ = 64; // local_size_x in cull.comp
+
+	static_assert( sizeof(CulledInstances::Instance) == 96 );
+}
+
+CulledInstances::CulledInstances( GpuMesh const& aMesh, std::vector<Mat44f> const& aModelWorld )
+	: mMesh( aMesh )
+	, mCount( aModelWorld.size() )
+{
+	if( 0 == mCount )
+		throw Error( "CulledInstances: no instances" );
+
+	Aabb const meshBounds = mesh_bounds( aMesh );
+
+	std::vector<Instance> instances;
+	instances.reserve( mCount );
+	for( auto const& model : aModelWorld )
+	{
+		Aabb const bounds = transform( model, meshBounds );
+		instances.push_back( {
+			model,
+			Vec4f{ bounds.min.x, bounds.min.y, bounds.min.z, 1.f },
+			Vec4f{ bounds.max.x, bounds.max.y, bounds.max.z, 1.f }
+		} );
+	}
+
+	// One command per LOD. Each LOD's list of visible instances starts at
+	// lod * mCount, which the command's baseInstance selects.
+	mCommands.assign( kCommandSize_ * aMesh.lodCount, 0 );
+	for( std::size_t lod = 0; lod < aMesh.lodCount; ++lod )
+	{
+		GLuint* command = mCommands.data() + kCommandSize_ * lod;
+		GLuint const baseInstance = GLuint(lod * mCount);
+
+		command[0] = GLuint(aMesh.lods[lod].count);
+		command[1] = 0; // instanceCount
+		command[2] = GLuint(aMesh.lods[lod].first);
+		if( aMesh.indexed )
+		{
+			command[3] = 0; // baseVertex
+			command[4] = baseInstance;
+		}
+		else
+			command[3] = baseInstance;
+	}
+
+	glGenBuffers( 1, &mInstanceBuffer );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mInstanceBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(instances.size() * sizeof(Instance)), instances.data(), GL_STATIC_DRAW );
+
+	glGenBuffers( 1, &mVisibleBuffer );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mVisibleBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(aMesh.lodCount * mCount * sizeof(GLuint)), nullptr, GL_DYNAMIC_COPY );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	glGenBuffers( 1, &mCommandBuffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, GLsizeiptr(mCommands.size() * sizeof(GLuint)), mCommands.data(), GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	mVao = create_instanced_vao( aMesh, mVisibleBuffer );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+CulledInstances::~CulledInstances()
+{
+	gl_state::delete_vertex_array( mVao );
+	glDeleteBuffers( 1, &mCommandBuffer );
+	glDeleteBuffers( 1, &mVisibleBuffer );
+	glDeleteBuffers( 1, &mInstanceBuffer );
+}
+
+void CulledInstances::cull( ShaderProgram& aCull, float aPixelsPerUnit, HiZBuffer const* aHiZ )
+{
+	// Reset the instance counts. Earlier draws from the buffer complete
+	// first (the driver orders the update after them).
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer );
+	glBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, GLsizeiptr(mCommands.size() * sizeof(GLuint)), mCommands.data() );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	float lodErrors[4];
+	for( std::size_t lod = 0; lod < 4; ++lod )
+		lodErrors[lod] = lod < mMesh.lodCount ? mMesh.lods[lod].error : std::numeric_limits<float>::infinity();
+
+	aCull.set( cull_::uInstanceCount, int(mCount) );
+	aCull.set( cull_::uPixelsPerUnit, aPixelsPerUnit );
+	aCull.set( cull_::uLodErrors, Vec4f{ lodErrors[0], lodErrors[1], lodErrors[2], lodErrors[3] } );
+
+	aCull.set( cull_::uHiZLevels, aHiZ ? int(aHiZ->levels()) : 0 );
+	if( aHiZ )
+		gl_state::bind_texture( cull_::uHiZ, aHiZ->pyramidTexture() );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, instances_::Instances, mInstanceBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, cull_::DrawCommands, mCommandBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, cull_::VisibleInstances, mVisibleBuffer );
+
+	gl_state::use_program( aCull.programId() );
+	glDispatchCompute( GLuint((mCount + kWorkGroupSize_-1) / kWorkGroupSize_), 1, 1 );
+
+	// The commands are read by the indirect draws, the lists as vertex
+	// attributes, and the commands are reset by the next cull()
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void CulledInstances::draw( ProgramPipeline& aPipeline )
+{
+	aPipeline.bind();
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, instances_::Instances, mInstanceBuffer );
+	gl_state::bind_vertex_array( mVao );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer );
+	GLsizei const drawCount = GLsizei(mMesh.lodCount);
+	GLsizei const stride = GLsizei(kCommandSize_ * sizeof(GLuint));
+	if( mMesh.indexed )
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, drawCount, stride );
+	else
+		glMultiDrawArraysIndirect( GL_TRIANGLES, nullptr, drawCount, stride );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+std::size_t CulledInstances::instance_count() const noexcept
+{
+	return mCount;
+}
+
+std::size_t CulledInstances::visible_count() const
+{
+	std::vector<GLuint> commands( mCommands.size() );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer );
+	glGetBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, GLsizeiptr(commands.size() * sizeof(GLuint)), commands.data() );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	std::size_t count = 0;
+	for( std::size_t lod = 0; lod < mMesh.lodCount; ++lod )
+		count += commands[kCommandSize_ * lod + 1];
+	return count;
+}
@@ -0,0 +1,81 @@
+#ifndef CULLED_INSTANCES_HPP_8B41E6C2_0D57_4A93_B2F8_6E3C19A7D504
+#define CULLED_INSTANCES_HPP_8B41E6C2_0D57_4A93_B2F8_6E3C19A7D504
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdlib>
+
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "../support/program.hpp"
+#include "../support/program_pipeline.hpp"
+
+#include "mesh.hpp"
+#include "hiz_buffer.hpp"
+
+/* Instances of a mesh, culled and drawn by the GPU
+ *
+ * The instances (model matrix and world bounds) are in a shader storage
+ * buffer. Per view, cull() runs assets/cull.comp, which tests each instance
+ * against the view frustum and, optionally, a depth pyramid of occluders
+ * (see HiZBuffer), picks its LOD, and appends the visible ones to the LOD's
+ * list. Each LOD has an indirect draw command, whose instanceCount
+ * the compute shader increments. draw() then draws all LODs with a single
+ * glMultiDraw*Indirect(), so the CPU cost does not depend on the number of
+ * instances; nothing is read back.
+ *
+ * The draws need a pipeline with the USE_INSTANCES variant of default.vert.
+ * Instances are not drawn in the depth pre-pass.
+ */
+class CulledInstances final
+{
+	public:
+		// C++ mirror of the std430 Instance struct in assets/instances.glsl
+		struct Instance
+		{
+			Mat44f modelWorld;
+			Vec4f boundsMin;
+			Vec4f boundsMax;
+		};
+
+	public:
+		// The mesh must outlive the instances. Model matrices may only
+		// rotate, translate and uniformly scale.
+		CulledInstances( GpuMesh const& aMesh, std::vector<Mat44f> const& aModelWorld );
+		~CulledInstances();
+
+		CulledInstances( CulledInstances const& ) = delete;
+		CulledInstances& operator= (CulledInstances const&) = delete;
+
+	public:
+		// Culls the instances against the current view, whose uniform block
+		// must be bound, and against the occluders in aHiZ, if any (built
+		// for the same view). aCull is the program of assets/cull.comp.
+		void cull( ShaderProgram& aCull, float aPixelsPerUnit, HiZBuffer const* aHiZ = nullptr );
+
+		// Draws the instances that passed the last cull()
+		void draw( ProgramPipeline& );
+
+		std::size_t instance_count() const noexcept;
+
+		// Number of instances that passed the last cull(). Reads back the
+		// draw commands, which waits for the GPU; for statistics only.
+		std::size_t visible_count() const;
+
+	private:
+		GpuMesh const& mMesh;
+		std::size_t mCount;
+
+		GLuint mInstanceBuffer = 0;
+		GLuint mVisibleBuffer = 0;
+		GLuint mCommandBuffer = 0;
+		GLuint mVao = 0;
+
+		// Initial commands, with zero instances
+		std::vector<GLuint> mCommands;
+};
+
+#endif // CULLED_INSTANCES_HPP_8B41E6C2_0D57_4A93_B2F8_6E3C19A7D504
@@ -0,0 +1,88 @@
+#include "gbuffer.hpp"
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	GLuint create_attachment_( GLenum aFormat, GLsizei aWidth, GLsizei aHeight )
+	{
+		GLuint tex = 0;
+		glGenTextures( 1, &tex );
+		glBindTexture( GL_TEXTURE_2D, tex );
+		glTexStorage2D( GL_TEXTURE_2D, 1, aFormat, aWidth, aHeight );
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+		return tex;
+	}
+}
+
+GBuffer::GBuffer()
+{
+	glGenFramebuffers( 1, &mFramebuffer );
+}
+
+GBuffer::~GBuffer()
+{
+	GLuint const textures[] = { mAlbedo, mNormal, mDepth };
+	glDeleteTextures( 3, textures );
+	glDeleteFramebuffers( 1, &mFramebuffer );
+}
+
+void GBuffer::resize( GLsizei aWidth, GLsizei aHeight )
+{
+	if( aWidth == mWidth && aHeight == mHeight )
+		return;
+
+	// Texture storage is immutable, so recreate the attachments
+	GLuint const textures[] = { mAlbedo, mNormal, mDepth };
+	glDeleteTextures( 3, textures );
+
+	// sRGB, so the 8 bits are spent where they are visible; the base color
+	// is encoded on write (GL_FRAMEBUFFER_SRGB) and decoded when sampled
+	mAlbedo = create_attachment_( GL_SRGB8_ALPHA8, aWidth, aHeight );
+	mNormal = create_attachment_( GL_RG16F, aWidth, aHeight );
+	mDepth = create_attachment_( GL_DEPTH_COMPONENT32F, aWidth, aHeight );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, mFramebuffer );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAlbedo, 0 );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormal, 0 );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepth, 0 );
+
+	GLenum const buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers( 2, buffers );
+
+	GLenum const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+		throw Error( "G-buffer framebuffer incomplete: 0x%x", status );
+
+	mWidth = aWidth;
+	mHeight = aHeight;
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GLuint GBuffer::framebufferId() const noexcept
+{
+	return mFramebuffer;
+}
+
+GLuint GBuffer::albedoTexture() const noexcept
+{
+	return mAlbedo;
+}
+GLuint GBuffer::normalTexture() const noexcept
+{
+	return mNormal;
+}
+GLuint GBuffer::depthTexture() const noexcept
+{
+	return mDepth;
+}
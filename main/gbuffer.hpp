@@ -0,0 +1,45 @@
+#ifndef GBUFFER_HPP_3C8E51A7_94D2_4B6F_8A03_E7D25C9F164B
+#define GBUFFER_HPP_3C8E51A7_94D2_4B6F_8A03_E7D25C9F164B
+
+#include <glad.h>
+
+/* G-buffer of the deferred render path
+ *
+ * A framebuffer with the attachments described in assets/gbuffer.glsl: base
+ * color and specular strength, an octahedral-encoded normal, and depth. The
+ * geometry pass (gbuffer.frag) fills it; the lighting pass (deferred.frag)
+ * reads it with texelFetch(), and reconstructs the world position from the
+ * depth, so the attachments are not filtered or mipmapped. The base color is
+ * stored as sRGB, which relies on GL_FRAMEBUFFER_SRGB being enabled during
+ * the geometry pass; reads decode it back to linear.
+ */
+class GBuffer final
+{
+	public:
+		GBuffer();
+		~GBuffer();
+
+		GBuffer( GBuffer const& ) = delete;
+		GBuffer& operator= (GBuffer const&) = delete;
+
+	public:
+		// (Re-)allocates the attachments if the size changed. Throws Error if
+		// the framebuffer is incomplete.
+		void resize( GLsizei aWidth, GLsizei aHeight );
+
+		GLuint framebufferId() const noexcept;
+
+		GLuint albedoTexture() const noexcept;
+		GLuint normalTexture() const noexcept;
+		GLuint depthTexture() const noexcept;
+
+	private:
+		GLuint mFramebuffer = 0;
+		GLuint mAlbedo = 0;
+		GLuint mNormal = 0;
+		GLuint mDepth = 0;
+
+		GLsizei mWidth = 0, mHeight = 0;
+};
+
+#endif // GBUFFER_HPP_3C8E51A7_94D2_4B6F_8A03_E7D25C9F164B
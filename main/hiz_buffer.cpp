@@ -0,0 +1,131 @@
+#include "hiz_buffer.hpp"
+
+#include <algorithm>
+
+#include "../support/error.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "shader_bindings.hpp"
+
+namespace
+{
+	namespace hiz_ = shader_bindings::hiz_comp;
+
+	constexpr GLuint kWorkGroupSize_ = 8; // local_size_x/y in hiz.comp
+
+	GLuint create_texture_( GLenum aFormat, GLint aLevels, GLsizei aWidth, GLsizei aHeight )
+	{
+		GLuint tex = 0;
+		glGenTextures( 1, &tex );
+		glBindTexture( GL_TEXTURE_2D, tex );
+		glTexStorage2D( GL_TEXTURE_2D, aLevels, aFormat, aWidth, aHeight );
+
+		// Only read with texelFetch()
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+		return tex;
+	}
+
+	// Size of a pyramid level, for a framebuffer of size aSize. Level 0 is
+	// half the size; as with all mipmaps, sizes are rounded down.
+	GLsizei level_size_( GLsizei aSize, GLint aLevel )
+	{
+		return std::max( 1, std::max( 1, aSize / 2 ) >> aLevel );
+	}
+}
+
+HiZBuffer::HiZBuffer()
+{
+	glGenFramebuffers( 1, &mFramebuffer );
+}
+
+HiZBuffer::~HiZBuffer()
+{
+	GLuint const textures[] = { mDepth, mPyramid };
+	glDeleteTextures( 2, textures );
+	glDeleteFramebuffers( 1, &mFramebuffer );
+}
+
+void HiZBuffer::resize( GLsizei aWidth, GLsizei aHeight )
+{
+	if( aWidth == mWidth && aHeight == mHeight )
+		return;
+
+	// Texture storage is immutable, so recreate the textures
+	GLuint const textures[] = { mDepth, mPyramid };
+	glDeleteTextures( 2, textures );
+
+	GLsizei const size = std::max( level_size_( aWidth, 0 ), level_size_( aHeight, 0 ) );
+
+	mLevels = 1;
+	while( (size >> mLevels) > 0 )
+		++mLevels;
+
+	mDepth = create_texture_( GL_DEPTH_COMPONENT32F, 1, aWidth, aHeight );
+	mPyramid = create_texture_( GL_R32F, mLevels, level_size_( aWidth, 0 ), level_size_( aHeight, 0 ) );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, mFramebuffer );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepth, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+
+	GLenum const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+		throw Error( "Hi-Z framebuffer incomplete: 0x%x", status );
+
+	mWidth = aWidth;
+	mHeight = aHeight;
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GLuint HiZBuffer::framebufferId() const noexcept
+{
+	return mFramebuffer;
+}
+
+void HiZBuffer::build( ShaderProgram& aDownsample )
+{
+	gl_state::use_program( aDownsample.programId() );
+
+	for( GLint level = 0; level < mLevels; ++level )
+	{
+		// Level 0 from the depth attachment, the others from the level below
+		if( 0 == level )
+		{
+			gl_state::bind_texture( hiz_::uSource, mDepth );
+			aDownsample.set( hiz_::uSourceLevel, 0 );
+		}
+		else
+		{
+			gl_state::bind_texture( hiz_::uSource, mPyramid );
+			aDownsample.set( hiz_::uSourceLevel, level-1 );
+		}
+
+		glBindImageTexture( hiz_::uTarget, mPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F );
+
+		GLsizei const w = level_size_( mWidth, level );
+		GLsizei const h = level_size_( mHeight, level );
+		glDispatchCompute( GLuint(w + kWorkGroupSize_-1) / kWorkGroupSize_, GLuint(h + kWorkGroupSize_-1) / kWorkGroupSize_, 1 );
+
+		glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+GLuint HiZBuffer::pyramidTexture() const noexcept
+{
+	return mPyramid;
+}
+GLint HiZBuffer::levels() const noexcept
+{
+	return mLevels;
+}
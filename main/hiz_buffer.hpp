@@ -0,0 +1,55 @@
+#ifndef HIZ_BUFFER_HPP_D52A7F19_3B86_4E0C_91A4_7C2E68B3F0D1
+#define HIZ_BUFFER_HPP_D52A7F19_3B86_4E0C_91A4_7C2E68B3F0D1
+
+#include <glad.h>
+
+#include "../support/program.hpp"
+
+/* Hierarchical depth (Hi-Z) buffer for occlusion culling
+ *
+ * The occluders (e.g., the terrain) are drawn depth-only into a full size
+ * depth attachment, using the same viewport as the view. build() then
+ * reduces that depth into a mipmapped R32F texture, the depth pyramid, where
+ * each texel holds the farthest depth of the pixels that it covers. Level 0
+ * has half the resolution of the framebuffer.
+ *
+ * An object whose nearest depth is behind the farthest depth of the texels
+ * under its screen rectangle is hidden by the occluders; see cull.comp.
+ * Occluders are drawn each frame before the test, so the result is
+ * conservative and needs no reprojection.
+ */
+class HiZBuffer final
+{
+	public:
+		HiZBuffer();
+		~HiZBuffer();
+
+		HiZBuffer( HiZBuffer const& ) = delete;
+		HiZBuffer& operator= (HiZBuffer const&) = delete;
+
+	public:
+		// (Re-)allocates the textures if the size changed. Throws Error if
+		// the framebuffer is incomplete. Binds directly, behind the back of
+		// gl_state; call before gl_state::begin_frame().
+		void resize( GLsizei aWidth, GLsizei aHeight );
+
+		// Depth-only framebuffer for the occluders
+		GLuint framebufferId() const noexcept;
+
+		// Builds the pyramid from the occluders' depth. aDownsample is the
+		// program of assets/hiz.comp.
+		void build( ShaderProgram& aDownsample );
+
+		GLuint pyramidTexture() const noexcept;
+		GLint levels() const noexcept;
+
+	private:
+		GLuint mFramebuffer = 0;
+		GLuint mDepth = 0;
+		GLuint mPyramid = 0;
+
+		GLsizei mWidth = 0, mHeight = 0;
+		GLint mLevels = 0;
+};
+
+#endif // HIZ_BUFFER_HPP_D52A7F19_3B86_4E0C_91A4_7C2E68B3F0D1
@@ -2,6 +2,8 @@
 #include <GLFW/glfw3.h>
 
 #include <typeinfo>
+#include <memory>
+#include <algorithm>
 #include <stdexcept>
 
 #include <cstdio>
@@ -11,6 +13,12 @@
 
 #include "../support/error.hpp"
 #include "../support/program.hpp"
+#include "../support/program_cache.hpp"
+#include "../support/shader_variants.hpp"
+#include "../support/file_watcher.hpp"
+#include "../support/uniform_buffer.hpp"
+#include "../support/render_queue.hpp"
+#include "../support/gl_state.hpp"
 #include "../support/checkpoint.hpp"
 #include "../support/debug_output.hpp"
 
@@ -18,8 +26,22 @@
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
 #include "../vmlib/mat33.hpp"
+#include "../vmlib/aabb.hpp"
 
 #include "defaults.hpp"
+#include "assets.hpp"
+#include "async_texture.hpp"
+#include "cdlod_terrain.hpp"
+#include "clustered_lights.hpp"
+#include "culled_instances.hpp"
+#include "gbuffer.hpp"
+#include "hiz_buffer.hpp"
+#include "meshlet_culler.hpp"
+#include "occlusion_queries.hpp"
+#include "resources.hpp"
+#include "scene_index.hpp"
+#include "shader_bindings.hpp"
+#include "uniform_blocks.hpp"
 #include "loadobj.hpp"
 #include "mesh.hpp"
 #include "spaceship.hpp"
@@ -35,7 +57,7 @@ namespace
 
 	struct State_
 	{
-		ShaderProgram* prog;
+		ShaderVariants* shaders;
 
 		struct Camera_
 		{
@@ -67,8 +89,57 @@ namespace
 
 		double lastPrintTime = 0.0; // Last print time for cam pos
 		uint viewCount = 1;
+
+		bool deferred = false; // render path; toggled with G
+		bool depthPrepass = false; // toggled with P
+		bool instances = true; // GPU-culled beacons; toggled with I
+		bool occlusionCulling = true; // of the beacons; toggled with O
+		bool occlusionQueries = true; // of the ship and pads; toggled with B
+		bool meshletCulling = true; // of cooked meshes; toggled with M
+		bool cdlodTerrain = true; // terrain renderer (else the mesh); toggled with T
 	};
 
+	// Per-object uniforms of the lit shader (see shader_bindings.hpp)
+	namespace litVert_ = shader_bindings::default_vert;
+	namespace litFrag_ = shader_bindings::default_frag;
+	namespace gbufferFrag_ = shader_bindings::gbuffer_frag;
+	namespace deferredFrag_ = shader_bindings::deferred_frag;
+	namespace depthVert_ = shader_bindings::depth_vert;
+	namespace terrainVert_ = shader_bindings::terrain_vert;
+
+	// Both render paths bind the object's texture to the same unit
+	static_assert(gbufferFrag_::uTexture == litFrag_::uTexture);
+
+	// The render queue sets the model matrix of each draw at one location
+	static_assert(depthVert_::uModelWorld.value == litVert_::uModelWorld.value);
+	static_assert(terrainVert_::uModelWorld.value == litVert_::uModelWorld.value);
+
+	// Objects in the scene index
+	constexpr std::uint32_t kObjectTerrain_ = 0;
+	constexpr std::uint32_t kObjectShip_ = 1;
+	constexpr std::uint32_t kObjectPad1_ = 2;
+	constexpr std::uint32_t kObjectPad2_ = 3;
+	constexpr std::uint32_t kObjectCount_ = 4;
+
+	constexpr char const* kObjectNames_[kObjectCount_] = { "terrain", "space ship", "landing pad 1", "landing pad 2" };
+
+	// Render queue passes, in order
+	constexpr std::uint32_t kPassDepthPrepass_ = 0;
+	constexpr std::uint32_t kPassOpaque_ = 1;
+	constexpr std::uint32_t kPassOccluders_ = 2; // into the Hi-Z buffer
+
+	void submit_mesh_(RenderQueue&, std::uint32_t aPass, ProgramPipeline&, GLuint aTexture, GpuMesh const&, GLuint aVao, Mat44f const& aModel, float aDepth, std::size_t aLod = 0, GLuint aCondition = 0, MeshletCuller const* aMeshlets = nullptr);
+
+	// Projection of the views
+	constexpr float kFovY_ = 60.f * kPi_ / 180.f;
+	constexpr float kNear_ = 0.1f;
+	constexpr float kFar_ = 200.f;
+
+	// Occlusion queries: the camera counts as inside of an object's bounds
+	// within this distance, which covers the corners of the near plane up to
+	// an aspect ratio of about six (see OcclusionQueries)
+	constexpr float kOcclusionCameraMargin_ = 4.f * kNear_;
+
 	void glfw_callback_error_( int, char const* );
 
 	void glfw_callback_key_(GLFWwindow*, int, int, int, int);
@@ -173,19 +244,44 @@ int main() try
 	setup_gl_debug_output();
 #	endif // ~ !NDEBUG
 
+	if( !setup_parallel_shader_compile() )
+		std::fprintf( stderr, "Note: GL_KHR_parallel_shader_compile not supported; shaders compile serially\n" );
+
 	// Setup paths
 #if defined(WIN32)
 	const char* defaultVertexShaderPath = "../assets/default.vert";
 	const char* defaultFragmentShaderPath = "../assets/default.frag";
+	const char* gbufferFragmentShaderPath = "../assets/gbuffer.frag";
+	const char* deferredVertexShaderPath = "../assets/deferred.vert";
+	const char* deferredFragmentShaderPath = "../assets/deferred.frag";
+	const char* depthVertexShaderPath = "../assets/depth.vert";
+	const char* cullComputeShaderPath = "../assets/cull.comp";
+	const char* hizComputeShaderPath = "../assets/hiz.comp";
+	const char* meshletComputeShaderPath = "../assets/meshlets.comp";
+	const char* terrainVertexShaderPath = "../assets/terrain.vert";
+	const char* terrainBakeFragmentShaderPath = "../assets/terrain_bake.frag";
 	const char* terrainObjPath = "../assets/parlahti.obj";
 	const char* textureObjPath = "../assets/L4343A-4k.jpeg";
 	const char* launchpadObjPath = "../assets/landingpad.obj";
+	const char* placeholderTexturePath = "../assets/white.png";
+	const char* programCacheDir = "../shadercache";
 #else
 	const char* defaultVertexShaderPath = "assets/default.vert";
 	const char* defaultFragmentShaderPath = "assets/default.frag";
+	const char* gbufferFragmentShaderPath = "assets/gbuffer.frag";
+	const char* deferredVertexShaderPath = "assets/deferred.vert";
+	const char* deferredFragmentShaderPath = "assets/deferred.frag";
+	const char* depthVertexShaderPath = "assets/depth.vert";
+	const char* cullComputeShaderPath = "assets/cull.comp";
+	const char* hizComputeShaderPath = "assets/hiz.comp";
+	const char* meshletComputeShaderPath = "assets/meshlets.comp";
+	const char* terrainVertexShaderPath = "assets/terrain.vert";
+	const char* terrainBakeFragmentShaderPath = "assets/terrain_bake.frag";
 	const char* terrainObjPath = "assets/parlahti.obj";
 	const char* textureObjPath = "assets/L4343A-4k.jpeg";
 	const char* launchpadObjPath = "assets/landingpad.obj";
+	const char* placeholderTexturePath = "assets/white.png";
+	const char* programCacheDir = "shadercache";
 #endif
 
 	// Global GL state
@@ -208,13 +304,158 @@ int main() try
 
 	glViewport( 0, 0, iwidth, iheight );
 
-	// Loads the shader program
-	ShaderProgram prog( {
+	// Loads the shader programs. The lit shader is specialized with #defines
+	// (see default.frag) instead of branching on uniforms at runtime. Its
+	// stages are separable programs, combined into program pipelines, so
+	// that the variants share a single vertex program. Linked programs are
+	// cached on disk, which skips compilation on later runs.
+	ProgramBinaryCache programCache( programCacheDir );
+
+	ShaderVariants litShaders( {
 			{ GL_VERTEX_SHADER, defaultVertexShaderPath },
 			{ GL_FRAGMENT_SHADER, defaultFragmentShaderPath }
-			} );
+			}, &programCache, true );
+
+	// All variants are submitted before any is used, so that they compile in
+	// parallel where the driver supports it. Per-object uniforms use the
+	// generated locations in shader_bindings.hpp. Per-frame and per-view
+	// data is in uniform blocks (see uniform_blocks.hpp), streamed through a
+	// ring buffer.
+	auto const texturedVariant = litShaders.variant({ "USE_TEXTURE", "USE_SPECULAR" });
+	auto const specularVariant = litShaders.variant({ "USE_SPECULAR" });
+	auto const instancedVariant = litShaders.variant({ "USE_SPECULAR", "USE_INSTANCES" });
+	litShaders.submit_all();
+
+	// Deferred render path (toggled with G): the geometry pass writes the
+	// same objects, with the same variants, into a G-buffer, which a
+	// full-screen pass then lights (see gbuffer.frag and deferred.frag)
+	ShaderVariants gbufferShaders( {
+			{ GL_VERTEX_SHADER, defaultVertexShaderPath },
+			{ GL_FRAGMENT_SHADER, gbufferFragmentShaderPath }
+			}, &programCache, true );
+	auto const gbufferTexturedVariant = gbufferShaders.variant({ "USE_TEXTURE", "USE_SPECULAR" });
+	auto const gbufferSpecularVariant = gbufferShaders.variant({ "USE_SPECULAR" });
+	auto const gbufferInstancedVariant = gbufferShaders.variant({ "USE_SPECULAR", "USE_INSTANCES" });
+	gbufferShaders.submit_all();
+
+	ShaderVariants deferredShaders( {
+			{ GL_VERTEX_SHADER, deferredVertexShaderPath },
+			{ GL_FRAGMENT_SHADER, deferredFragmentShaderPath }
+			}, &programCache, true );
+	auto const deferredVariant = deferredShaders.variant({ "USE_SPECULAR" });
+	deferredShaders.submit_all();
+
+	// Depth pre-pass (toggled with P): vertex stage only
+	ShaderVariants depthShaders( {
+			{ GL_VERTEX_SHADER, depthVertexShaderPath }
+			}, &programCache, true );
+	auto const depthVariant = depthShaders.variant({});
+	depthShaders.submit_all();
+
+	// GPU culling of instanced meshes (see CulledInstances)
+	ShaderVariants cullShaders( {
+			{ GL_COMPUTE_SHADER, cullComputeShaderPath }
+			}, &programCache );
+	auto const cullVariant = cullShaders.variant({});
+	cullShaders.submit_all();
+
+	// Hi-Z depth pyramid for occlusion culling (see HiZBuffer)
+	ShaderVariants hizShaders( {
+			{ GL_COMPUTE_SHADER, hizComputeShaderPath }
+			}, &programCache );
+	auto const hizVariant = hizShaders.variant({});
+	hizShaders.submit_all();
+
+	// Meshlet culling of cooked meshes (see MeshletCuller)
+	ShaderVariants meshletShaders( {
+			{ GL_COMPUTE_SHADER, meshletComputeShaderPath }
+			}, &programCache );
+	auto const meshletVariant = meshletShaders.variant({});
+	meshletShaders.submit_all();
+
+	// CDLOD terrain (toggled with T; see CdlodTerrain): the terrain's stage
+	// with the lit, G-buffer and no fragment stages, and the bake of its
+	// maps from the terrain mesh
+	ShaderVariants terrainShaders( {
+			{ GL_VERTEX_SHADER, terrainVertexShaderPath },
+			{ GL_FRAGMENT_SHADER, defaultFragmentShaderPath }
+			}, &programCache, true );
+	auto const terrainVariant = terrainShaders.variant({ "USE_TEXTURE", "USE_SPECULAR" });
+	terrainShaders.submit_all();
+
+	ShaderVariants terrainGbufferShaders( {
+			{ GL_VERTEX_SHADER, terrainVertexShaderPath },
+			{ GL_FRAGMENT_SHADER, gbufferFragmentShaderPath }
+			}, &programCache, true );
+	auto const terrainGbufferVariant = terrainGbufferShaders.variant({ "USE_TEXTURE", "USE_SPECULAR" });
+	terrainGbufferShaders.submit_all();
+
+	ShaderVariants terrainDepthShaders( {
+			{ GL_VERTEX_SHADER, terrainVertexShaderPath }
+			}, &programCache, true );
+	auto const terrainDepthVariant = terrainDepthShaders.variant({});
+	terrainDepthShaders.submit_all();
+
+	ShaderVariants terrainBakeShaders( {
+			{ GL_VERTEX_SHADER, defaultVertexShaderPath },
+			{ GL_FRAGMENT_SHADER, terrainBakeFragmentShaderPath }
+			}, &programCache, true );
+	auto const terrainBakeVariant = terrainBakeShaders.variant({});
+	terrainBakeShaders.submit_all();
+
+	ProgramPipeline& litTextured = litShaders.pipeline(texturedVariant);
+	ProgramPipeline& litSpecular = litShaders.pipeline(specularVariant);
+	ProgramPipeline& gbufferTextured = gbufferShaders.pipeline(gbufferTexturedVariant);
+	ProgramPipeline& gbufferSpecular = gbufferShaders.pipeline(gbufferSpecularVariant);
+	ProgramPipeline& deferredLighting = deferredShaders.pipeline(deferredVariant);
+	ProgramPipeline& depthOnly = depthShaders.pipeline(depthVariant);
+	ProgramPipeline& litInstanced = litShaders.pipeline(instancedVariant);
+	ProgramPipeline& gbufferInstanced = gbufferShaders.pipeline(gbufferInstancedVariant);
+	ShaderProgram& cullInstances = cullShaders.program(cullVariant);
+	ShaderProgram& hizDownsample = hizShaders.program(hizVariant);
+	ShaderProgram& cullMeshlets = meshletShaders.program(meshletVariant);
+	ProgramPipeline& terrainLit = terrainShaders.pipeline(terrainVariant);
+	ProgramPipeline& terrainGbuffer = terrainGbufferShaders.pipeline(terrainGbufferVariant);
+	ProgramPipeline& terrainDepth = terrainDepthShaders.pipeline(terrainDepthVariant);
+	ProgramPipeline& terrainBake = terrainBakeShaders.pipeline(terrainBakeVariant);
+
+	std::printf("Lit shader: %zu variants from %zu programs\n", litShaders.variant_count(), litShaders.program_count());
+
+	ShaderVariants* const allShaders[] = { &litShaders, &gbufferShaders, &deferredShaders, &depthShaders, &cullShaders, &hizShaders, &meshletShaders,
+		&terrainShaders, &terrainGbufferShaders, &terrainDepthShaders, &terrainBakeShaders };
+
+	// Watch the shader sources and their includes for changes (hot reload;
+	// see main loop)
+	FileWatcher shaderWatcher;
+	for (ShaderVariants* shaders : allShaders)
+	{
+		for (auto const& file : shaders->dependencies())
+			shaderWatcher.watch(file);
+	}
+
+	UniformRingBuffer uniformBuffer(16 * 1024);
+
+	// Point lights are in shader storage buffers, and listed per cluster of
+	// each view, so that fragments only evaluate the lights near them
+	ClusteredLights clusteredLights;
+
+	RenderQueue renderQueue(litFrag_::uTexture, litVert_::uModelWorld);
+
+	// Allocated when the deferred path is first used
+	GBuffer gbuffer;
+
+	// Occluder depth and its pyramid; allocated when first used
+	HiZBuffer hizBuffer;
+
+	// Occlusion queries of the objects, for up to two views (split screen)
+	OcclusionQueries occlusionQueries(kObjectCount_, 2, kOcclusionCameraMargin_);
+
+	// The lighting pass draws a full-screen triangle without attributes,
+	// which still requires a VAO to be bound
+	GLuint fullscreenVao = 0;
+	glGenVertexArrays(1, &fullscreenVao);
 
-	state.prog = &prog;
+	state.shaders = &litShaders;
 	state.camera.mode = 0;
 	state.camera.pos = {25.f, 5.f, -10.f};
 	state.camera.pitch = 0.f;
@@ -251,25 +492,96 @@ int main() try
 	*/
 
 	// Create vertex buffers and VAO
-	auto terrain_mesh = load_wavefront_obj(terrainObjPath);
-	GLuint terrain_vao = create_vao(terrain_mesh);
-	std::size_t terrainVertexCount = terrain_mesh.positions.size();
+	// Cooked versions of the assets are used if the asset-cooker has been
+	// run; otherwise the OBJs and the texture are processed here. Assets are
+	// loaded through the registry, which loads each at most once and frees
+	// them with the last handle.
+	ResourceRegistry resources;
 
-	// Load terrain texture
-	auto textureObjectId = load_texture_2d(textureObjPath);
+	auto const terrainMesh = resources.mesh(terrainObjPath);
+	GpuMesh const& terrain = *terrainMesh;
+
+	// Load terrain texture. The (large) texture is decoded in the background
+	// and streamed in over a few frames; the white placeholder is used until
+	// then. The streamed texture does not go through the registry: its
+	// texture object changes as levels are streamed in (and evicted), so it
+	// cannot be shared as a single handle. It is loaded only once here.
+	auto const placeholderTexture = resources.texture(placeholderTexturePath);
+
+	AsyncTextureLoader textureLoader;
+	auto const terrainTexture = textureLoader.load(textureObjPath, *placeholderTexture);
 
 	auto spaceship_mesh = make_spaceship();
 	GLuint spaceship_vao = create_vao(spaceship_mesh);
 	std::size_t spaceshipVertexCount = spaceship_mesh.positions.size();
 
 	// Landingpad
-	auto landingpad_mesh = load_wavefront_obj(launchpadObjPath);
-	GLuint landingpad_vao = create_vao(landingpad_mesh);
-	std::size_t landingpadVertexCount = landingpad_mesh.positions.size();
+	auto const landingpadMesh = resources.mesh(launchpadObjPath);
+	GpuMesh const& landingpad = *landingpadMesh;
+
+	auto const resourceStats = resources.stats();
+	std::printf("Resources: %zu loaded for %zu requests\n", resourceStats.loads, resourceStats.requests);
 
 	Mat44f landingpadTransform1 = make_translation({ -43.0f, -0.97f, 8.f });
 	Mat44f landingpadTransform2 = make_translation({ 25.0f, -0.97f, -6.f });
 
+	// Spatial index of the scene, for culling and picking. The space ship
+	// is moved in the index as it flies.
+	Aabb objectBounds[kObjectCount_];
+	objectBounds[kObjectTerrain_] = mesh_bounds(terrain);
+	objectBounds[kObjectShip_] = mesh_bounds(spaceship_mesh);
+	objectBounds[kObjectPad1_] = transform(landingpadTransform1, mesh_bounds(landingpad));
+	objectBounds[kObjectPad2_] = transform(landingpadTransform2, mesh_bounds(landingpad));
+
+	SceneIndex sceneIndex;
+	sceneIndex.insert(objectBounds[kObjectTerrain_], kObjectTerrain_);
+	sceneIndex.insert(objectBounds[kObjectPad1_], kObjectPad1_);
+	sceneIndex.insert(objectBounds[kObjectPad2_], kObjectPad2_);
+	SceneIndex::Proxy const shipProxy = sceneIndex.insert(objectBounds[kObjectShip_], kObjectShip_);
+
+	std::vector<std::uint32_t> visibleObjects;
+
+	// Beacons: a grid of small landing pads over the terrain, culled and
+	// drawn by the GPU (see CulledInstances). Not in the scene index.
+	std::unique_ptr<CulledInstances> beacons;
+	{
+		constexpr int kBeaconGrid = 64;
+
+		std::vector<Mat44f> beaconTransforms;
+		for (int z = 0; z < kBeaconGrid; ++z)
+		{
+			for (int x = 0; x < kBeaconGrid; ++x)
+			{
+				float const u = (x + 0.5f) / kBeaconGrid, v = (z + 0.5f) / kBeaconGrid;
+				Vec3f const pos{
+					terrain.boundsMin.x + u * (terrain.boundsMax.x - terrain.boundsMin.x),
+					-0.97f,
+					terrain.boundsMin.z + v * (terrain.boundsMax.z - terrain.boundsMin.z)
+				};
+
+				beaconTransforms.push_back(make_translation(pos) * make_rotation_y(0.7f * (x + kBeaconGrid * z)) * make_scaling(0.2f, 0.2f, 0.2f));
+			}
+		}
+
+		beacons = std::make_unique<CulledInstances>(landingpad, beaconTransforms);
+	}
+
+	// Meshlet culling of the terrain and the landing pads, if their meshes
+	// were cooked (which is where the meshlets are built)
+	std::unique_ptr<MeshletCuller> terrainMeshlets;
+	std::unique_ptr<MeshletCuller> padMeshlets[2];
+	if (terrain.meshletCount)
+		terrainMeshlets = std::make_unique<MeshletCuller>(terrain);
+	if (landingpad.meshletCount)
+	{
+		for (auto& meshlets : padMeshlets)
+			meshlets = std::make_unique<MeshletCuller>(landingpad);
+	}
+
+	// CDLOD terrain, from maps baked from the terrain mesh
+	CdlodTerrain cdlodTerrain(terrain, terrainBake);
+	std::printf("CDLOD terrain: %u levels of %ux%u patches\n", cdlodTerrain.level_count(), CdlodTerrain::kPatchQuads, CdlodTerrain::kPatchQuads);
+
 	// Point lights
 	Vec3f pointLightPositions[3] = {
 		{25.0f,   .2f, -6.0f},
@@ -286,6 +598,53 @@ int main() try
 		{0.0f,    1.0f,   1.0f},
 		{1.0f,    1.0f,   1.0f}
 	};
+	constexpr float kShipLightRadius = 25.f;
+
+	// Pad lights: rings of small lights around each landing pad, and a row
+	// of runway lights from one pad to the other
+	std::vector<PointLight> padLights;
+	{
+		float const padRadius = 0.5f * std::max(landingpad.boundsMax.x - landingpad.boundsMin.x, landingpad.boundsMax.z - landingpad.boundsMin.z);
+
+		for (Mat44f const& model : { landingpadTransform1, landingpadTransform2 })
+		{
+			Vec3f const padPos{ model(0,3), model(1,3), model(2,3) };
+
+			for (float const ring : { 0.8f, 1.f, 1.2f })
+			{
+				constexpr int kRingLights = 48;
+				for (int l = 0; l < kRingLights; ++l)
+				{
+					float const angle = 2.f * kPi_ * l / kRingLights;
+					Vec4f const color = (l % 2) ? Vec4f{ 0.2f, 0.4f, 1.f, 0.f } : Vec4f{ 1.f, 1.f, 1.f, 0.f };
+
+					padLights.push_back({
+						Vec4f{ padPos.x + ring*padRadius*std::cos(angle), padPos.y + 0.3f, padPos.z + ring*padRadius*std::sin(angle), 3.f },
+						color,
+						color
+					});
+				}
+			}
+		}
+
+		Vec3f const runwayStart{ landingpadTransform1(0,3), landingpadTransform1(1,3) + 0.3f, landingpadTransform1(2,3) };
+		Vec3f const runwayEnd{ landingpadTransform2(0,3), landingpadTransform2(1,3) + 0.3f, landingpadTransform2(2,3) };
+
+		constexpr int kRunwayLights = 64;
+		for (int l = 0; l < kRunwayLights; ++l)
+		{
+			Vec3f const pos = runwayStart + (runwayEnd - runwayStart) * ((l + 0.5f) / kRunwayLights);
+			padLights.push_back({
+				Vec4f{ pos.x, pos.y, pos.z, 4.f },
+				Vec4f{ 1.f, 0.6f, 0.1f, 0.f },
+				Vec4f{ 1.f, 0.8f, 0.4f, 0.f }
+			});
+		}
+	}
+
+	// Engine lights below the ship (flickering; see main loop)
+	constexpr int kEngineLights = 8;
+	std::vector<PointLight> frameLights;
 
 	OGL_CHECKPOINT_ALWAYS();
 
@@ -322,6 +681,13 @@ int main() try
 			}
 
 			glViewport( 0, 0, nwidth, nheight );
+
+			if (state.deferred)
+				gbuffer.resize(nwidth, nheight);
+
+			// Binds directly, so must happen before gl_state::begin_frame()
+			if (state.instances && state.occlusionCulling)
+				hizBuffer.resize(nwidth, nheight);
 		}
 
 		// Update state
@@ -407,7 +773,10 @@ int main() try
 
 			state.spaceship_controls.reset = false;
 		}
+		gl_state::delete_vertex_array(spaceship_vao);
 		spaceship_vao = create_vao(spaceship_mesh);
+		objectBounds[kObjectShip_] = mesh_bounds(spaceship_mesh);
+		sceneIndex.move(shipProxy, objectBounds[kObjectShip_]);
 
 		// Fixed-distance camera
 		if (state.camera.mode == 1)
@@ -433,6 +802,85 @@ int main() try
 					);
 		}
 
+		// Rebuild the shaders whose sources or includes changed. Rebuilt
+		// programs replace the current ones once they have linked; until
+		// then, or if they fail to build, the current ones stay in use.
+		// Without GL_KHR_parallel_shader_compile, builds block; each set
+		// then builds one program per frame (see ShaderVariants::update()).
+		if (auto const changed = shaderWatcher.poll(); !changed.empty())
+		{
+			for (ShaderVariants* shaders : allShaders)
+			{
+				if (shaders->rebuild(changed))
+				{
+					// Edits may have added includes
+					for (auto const& file : shaders->dependencies())
+						shaderWatcher.watch(file);
+				}
+			}
+		}
+
+		for (ShaderVariants* shaders : allShaders)
+		{
+			try
+			{
+				if (auto const replaced = shaders->update())
+					std::fprintf(stderr, "Note: reloaded %zu shader program(s)\n", replaced);
+			}
+			catch (Error const& eErr)
+			{
+				std::fprintf(stderr, "Shader reload failed, keeping the previous program:\n%s\n", eErr.what());
+			}
+		}
+
+		// Continue streaming textures
+		textureLoader.update();
+		GLuint const textureObjectId = textureLoader.texture(terrainTexture);
+
+		// Per-frame uniforms: world light
+		uniformBuffer.begin_frame();
+		{
+			Vec3f const lightDir = normalize(Vec3f{0.f, 1.f, -1.f});
+
+			FrameBlock frame{};
+			frame.lightDir = Vec4f{ lightDir.x, lightDir.y, lightDir.z, 0.f };
+			frame.lightDiffuse = Vec4f{ 0.9f, 0.9f, 0.9f, 0.f };
+			frame.sceneAmbient = Vec4f{ 0.05f, 0.05f, 0.05f, 0.f };
+			uniformBuffer.push(kFrameBlockBinding, frame);
+		}
+
+		// Point lights: pad lights, the ship's lights and its engine lights
+		frameLights.assign(padLights.begin(), padLights.end());
+		for (std::size_t l = 0; l < 3; ++l)
+		{
+			frameLights.push_back({
+				Vec4f{ pointLightPositions[l].x, pointLightPositions[l].y, pointLightPositions[l].z, kShipLightRadius },
+				Vec4f{ pointLightDiffuseColors[l].x, pointLightDiffuseColors[l].y, pointLightDiffuseColors[l].z, 0.f },
+				Vec4f{ pointLightSpecularColors[l].x, pointLightSpecularColors[l].y, pointLightSpecularColors[l].z, 0.f }
+			});
+		}
+		{
+			float const time = float(glfwGetTime());
+			Vec3f const engine = state.spaceship_controls.pos + Vec3f{ 0.f, -0.3f, 0.f };
+
+			for (int l = 0; l < kEngineLights; ++l)
+			{
+				float const angle = 2.f * kPi_ * l / kEngineLights;
+				float const flicker = 0.8f + 0.2f * std::sin(17.f * time + 3.f * l);
+
+				frameLights.push_back({
+					Vec4f{ engine.x + 0.3f*std::cos(angle), engine.y, engine.z + 0.3f*std::sin(angle), 6.f },
+					Vec4f{ 1.f, 0.45f, 0.1f, 0.f } * flicker,
+					Vec4f{ 1.f, 0.7f, 0.3f, 0.f } * flicker
+				});
+			}
+		}
+		clusteredLights.set_lights(frameLights);
+
+		// Everything above may bind objects behind the state cache's back
+		gl_state::begin_frame();
+		occlusionQueries.begin_frame();
+
 		for (uint i = 0; i < state.viewCount; ++i)
 		{
 			if (state.viewCount == 1)
@@ -470,12 +918,24 @@ int main() try
 				aspect_ratio = (fbwidth/2.f)/float(fbheight);
 
 			Mat44f projection = make_perspective_projection(
-					60.f * kPi_ / 180.f,
+					kFovY_,
 					aspect_ratio,
-					0.1f, 200.f
+					kNear_, kFar_
 					);
 
-			Mat44f projCameraWorld = projection * world2camera * model2world;
+			Mat44f projCamera = projection * world2camera;
+
+			// Objects in the view frustum
+			Frustum const frustum = make_frustum(projCamera);
+
+			bool visible[kObjectCount_] = {};
+			visibleObjects.clear();
+			sceneIndex.query_frustum(frustum, visibleObjects);
+			for (std::uint32_t const object : visibleObjects)
+				visible[object] = true;
+
+			// Projected size of one unit at distance one (LOD selection)
+			float const pixelsPerUnit = fbheight / (2.f * std::tan(kFovY_ / 2.f));
 
 			Mat33f normalMatrix = mat44_to_mat33(transpose(invert(model2world)));
 
@@ -485,14 +945,14 @@ int main() try
 			unsigned int full_render_time_query_ids[2];
 			glGenQueries(2, full_render_time_query_ids);
 
-			unsigned int terrain_render_time_query_ids[2];
-			glGenQueries(2, terrain_render_time_query_ids);
+			unsigned int opaque_render_time_query_ids[2];
+			glGenQueries(2, opaque_render_time_query_ids);
 
-			unsigned int spaceship_render_time_query_ids[2];
-			glGenQueries(2, spaceship_render_time_query_ids);
+			unsigned int particles_render_time_query_ids[2];
+			glGenQueries(2, particles_render_time_query_ids);
 
-			unsigned int landing_pad_render_time_query_ids[2];
-			glGenQueries(2, landing_pad_render_time_query_ids);
+			unsigned int depth_prepass_render_time_query_ids[2];
+			glGenQueries(2, depth_prepass_render_time_query_ids);
 
 			// ------------------------- BEGIN RENDER TIME ---------------------------
 
@@ -506,79 +966,237 @@ int main() try
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			}
 
-			glUseProgram(prog.programId());
+			// Forward path: objects are lit as they are drawn. Deferred path:
+			// objects are drawn into the G-buffer, and lit afterwards (see
+			// DEFERRED LIGHTING below).
+			ProgramPipeline& texturedPass = state.deferred ? gbufferTextured : litTextured;
+			ProgramPipeline& specularPass = state.deferred ? gbufferSpecular : litSpecular;
 
-			glUniformMatrix4fv(
-					0,
-					1, GL_TRUE, projCameraWorld.v
-					);
+			if (state.deferred)
+			{
+				gl_state::bind_framebuffer(gbuffer.framebufferId());
+				if (i == 0)
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			}
+
+			ViewBlock view{};
+			view.projCamera = projCamera;
+			view.cameraPos = Vec4f{ state.camera.pos.x, state.camera.pos.y, state.camera.pos.z, 1.f };
+			view.invProjCamera = invert(projCamera);
+			std::copy(std::begin(frustum.planes), std::end(frustum.planes), view.frustumPlanes);
+
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			view.viewport = Vec4f{ float(viewport[0]), float(viewport[1]), float(viewport[2]), float(viewport[3]) };
+
+			// Light lists of this view's clusters
+			ClusteredLights::View const clusterView{ world2camera, kFovY_, aspect_ratio, kNear_, kFar_ };
+			clusteredLights.build(clusterView, view);
+
+			uniformBuffer.push(kViewBlockBinding, view);
+
+			ProgramPipeline& instancedPass = state.deferred ? gbufferInstanced : litInstanced;
+			ProgramPipeline& terrainPass = state.deferred ? terrainGbuffer : terrainLit;
+
+			for (ProgramPipeline* lit : { &texturedPass, &specularPass, &instancedPass, &terrainPass })
+			{
+				lit->set(litVert_::uNormalMatrix, normalMatrix);
+				lit->set(litFrag_::uShininess, 32.f); // same for all objects
+			}
 
-			glUniformMatrix3fv(
-					1,
-					1, GL_TRUE, normalMatrix.v
-					);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureObjectId);
-
-			// World Light
-			Vec3f lightDir = normalize(Vec3f{0.f, 1.f, -1.f});
-			// LightDir
-			glUniform3fv(2, 1, &lightDir.x);
-			// LightDiffuse
-			glUniform3f(3, 0.9f, 0.9f, 0.9f);
-			// SceneAmbient
-			glUniform3f(4, 0.05f, 0.05f, 0.05f);
 
 			// ------------------------------- 2D GUI --------------------------------
 
 
 
-			// ------------------------------- TERRAIN -------------------------------
+			// ------------------------------- SUBMIT ---------------------------------
+
+			// Opaque objects go through the render queue, which sorts them by
+			// state and then front to back (see RenderQueue). Objects outside
+			// of the view frustum are skipped.
+			renderQueue.begin();
+
+			// Meshes drawn at LOD 0 are culled per meshlet first, unless
+			// disabled, and then drawn with the meshlets' indirect commands
+			auto const cull_meshlets = [&] (MeshletCuller* aMeshlets, Mat44f const& aModel) -> MeshletCuller const* {
+				if (!state.meshletCulling || !aMeshlets)
+					return nullptr;
+				aMeshlets->cull(cullMeshlets, aModel);
+				return aMeshlets;
+			};
+
+			// Terrain. Request the terrain texture's resolution from the
+			// screen size of the terrain at its closest point. Takes effect
+			// next frame.
+			Vec3f const terrainClosest{
+				std::clamp(state.camera.pos.x, terrain.boundsMin.x, terrain.boundsMax.x),
+				std::clamp(state.camera.pos.y, terrain.boundsMin.y, terrain.boundsMax.y),
+				std::clamp(state.camera.pos.z, terrain.boundsMin.z, terrain.boundsMax.z)
+			};
+			float const terrainDistance = std::max(0.1f, length(terrainClosest - state.camera.pos));
+			float const terrainSize = std::max(terrain.boundsMax.x - terrain.boundsMin.x, terrain.boundsMax.z - terrain.boundsMin.z);
+			textureLoader.request_resolution(terrainTexture, terrainSize * pixelsPerUnit / terrainDistance);
+
+			if (visible[kObjectTerrain_] && state.cdlodTerrain)
+			{
+				cdlodTerrain.select(frustum, state.camera.pos);
+
+				if (cdlodTerrain.patch_count())
+				{
+					RenderQueue::Draw patches = cdlodTerrain.draw(terrainPass, terrainDistance / kFar_);
+					patches.texture = textureObjectId;
+					renderQueue.submit(kPassOpaque_, patches);
+
+					patches.pipeline = &terrainDepth;
+					patches.texture = 0;
+					if (state.depthPrepass)
+						renderQueue.submit(kPassDepthPrepass_, patches);
+
+					// The terrain is the occluder of the beacons
+					if (state.instances && state.occlusionCulling)
+						renderQueue.submit(kPassOccluders_, patches);
+				}
+			}
+			else if (visible[kObjectTerrain_])
+			{
+				MeshletCuller const* const meshlets = cull_meshlets(terrainMeshlets.get(), kIdentity44f);
 
-			glQueryCounter(terrain_render_time_query_ids[0], GL_TIMESTAMP);
+				submit_mesh_(renderQueue, kPassOpaque_, texturedPass, textureObjectId, terrain, terrain.vao, kIdentity44f, terrainDistance / kFar_, 0, 0, meshlets);
+				if (state.depthPrepass)
+					submit_mesh_(renderQueue, kPassDepthPrepass_, depthOnly, 0, terrain, terrain.depthVao, kIdentity44f, terrainDistance / kFar_, 0, 0, meshlets);
 
-			// Tell shader that we are using texture
-			glUniform1i(glGetUniformLocation(prog.programId(), "uUseTexture"), GL_TRUE);
-			// Bind texture to terrain
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureObjectId);
+				// The terrain is the occluder of the beacons
+				if (state.instances && state.occlusionCulling)
+					submit_mesh_(renderQueue, kPassOccluders_, depthOnly, 0, terrain, terrain.depthVao, kIdentity44f, terrainDistance / kFar_, 0, 0, meshlets);
+			}
 
-			// Light for terrain
-			Mat44f terrainModelMatrix = kIdentity44f;
-			glUniformMatrix4fv(13, 1, GL_TRUE, terrainModelMatrix.v);
+			// The space ship and the landing pads are drawn conditionally on
+			// whether their bounding boxes were visible in this view last
+			// frame (see OcclusionQueries)
+			auto const occlusion_condition = [&] (std::uint32_t aObject) -> GLuint {
+				if (!state.occlusionQueries)
+					return 0;
+				return occlusionQueries.condition(i, aObject, objectBounds[aObject], state.camera.pos);
+			};
+
+			// Space ship (transformed on the CPU; rebuilt every frame, so
+			// the depth pre-pass uses its full VAO)
+			if (visible[kObjectShip_])
+			{
+				RenderQueue::Draw ship;
+				ship.pipeline = &specularPass;
+				ship.vao = spaceship_vao;
+				ship.count = GLsizei(spaceshipVertexCount);
+				ship.depth = length(state.spaceship_controls.pos - state.camera.pos) / kFar_;
+				ship.condition = occlusion_condition(kObjectShip_);
+				renderQueue.submit(kPassOpaque_, ship);
+
+				if (state.depthPrepass)
+				{
+					ship.pipeline = &depthOnly;
+					renderQueue.submit(kPassDepthPrepass_, ship);
+				}
+			}
 
-			glBindVertexArray(terrain_vao);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glDrawArrays(GL_TRIANGLES, 0, terrainVertexCount);
+			// Landing pads. Pick the LOD of the (cooked) landing pad from its
+			// distance. Point lights are culled per cluster (see
+			// ClusteredLights).
+			for (std::uint32_t const pad : { kObjectPad1_, kObjectPad2_ })
+			{
+				if (!visible[pad])
+					continue;
 
-			// We don't need terrain's texture after
-			glBindTexture(GL_TEXTURE_2D, 0);
-			// We are not using texture from here
-			glUniform1i(glGetUniformLocation(prog.programId(), "uUseTexture"), GL_FALSE);
+				Mat44f const& model = pad == kObjectPad1_ ? landingpadTransform1 : landingpadTransform2;
+				Vec3f const padPos{ model(0,3), model(1,3), model(2,3) };
 
-			glQueryCounter(terrain_render_time_query_ids[1], GL_TIMESTAMP);
+				float const distance = length(padPos - state.camera.pos);
+				std::size_t const lod = select_lod(landingpad, distance, pixelsPerUnit);
 
-			// ------------------------------- SPACE SHIP -------------------------------
+				GLuint const condition = occlusion_condition(pad);
+				MeshletCuller const* const meshlets = 0 == lod ? cull_meshlets(padMeshlets[pad - kObjectPad1_].get(), model) : nullptr;
 
-			glQueryCounter(spaceship_render_time_query_ids[0], GL_TIMESTAMP);
+				submit_mesh_(renderQueue, kPassOpaque_, specularPass, 0, landingpad, landingpad.vao, model, distance / kFar_, lod, condition, meshlets);
+				if (state.depthPrepass)
+					submit_mesh_(renderQueue, kPassDepthPrepass_, depthOnly, 0, landingpad, landingpad.depthVao, model, distance / kFar_, lod, condition, meshlets);
+			}
 
-			glBindVertexArray(spaceship_vao);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glDrawArrays(GL_TRIANGLES, 0, spaceshipVertexCount);
+			// ---------------------------- INSTANCE CULLING ----------------------------
 
-			glQueryCounter(spaceship_render_time_query_ids[1], GL_TIMESTAMP);
+			// Cull the beacons against this view's frustum and, unless
+			// disabled, against the terrain: its depth is drawn into the Hi-Z
+			// buffer, and reduced into a depth pyramid (see HiZBuffer). The
+			// beacons are drawn after the opaque pass.
+			if (state.instances)
+			{
+				HiZBuffer const* occluders = nullptr;
+				if (state.occlusionCulling)
+				{
+					gl_state::bind_framebuffer(hizBuffer.framebufferId());
+					glClear(GL_DEPTH_BUFFER_BIT);
+					renderQueue.execute(kPassOccluders_);
+					gl_state::bind_framebuffer(state.deferred ? gbuffer.framebufferId() : 0);
 
-			// ------------------------------- POINT LIGHTS -------------------------------
+					hizBuffer.build(hizDownsample);
+					occluders = &hizBuffer;
+				}
 
-			for (int i = 0; i < 3; ++i) 
+				beacons->cull(cullInstances, pixelsPerUnit, occluders);
+			}
+
+			// ---------------------------- DEPTH PRE-PASS -----------------------------
+
+			// Lay down the depth of the opaque objects first, with positions
+			// only and no fragment stage. The opaque pass then only shades
+			// the visible fragments (GL_EQUAL), instead of every fragment that
+			// happens to be drawn before whatever ends up covering it.
+			glQueryCounter(depth_prepass_render_time_query_ids[0], GL_TIMESTAMP);
+
+			if (state.depthPrepass)
+			{
+				gl_state::color_mask(false);
+				renderQueue.execute(kPassDepthPrepass_);
+
+				gl_state::color_mask(true);
+				gl_state::depth_func(GL_EQUAL);
+				gl_state::depth_mask(false);
+			}
+
+			glQueryCounter(depth_prepass_render_time_query_ids[1], GL_TIMESTAMP);
+
+			// ------------------------------- OPAQUE ---------------------------------
+
+			glQueryCounter(opaque_render_time_query_ids[0], GL_TIMESTAMP);
+
+			gl_state::polygon_mode(GL_FILL);
+			renderQueue.execute(kPassOpaque_);
+
+			if (state.depthPrepass)
 			{
-				std::string index = std::to_string(i);
-				glUniform3fv(glGetUniformLocation(prog.programId(), ("uPointLightPositions[" + index + "]").c_str()), 1, &pointLightPositions[i].x);
-				glUniform3fv(glGetUniformLocation(prog.programId(), ("uPointLightDiffuse[" + index + "]").c_str()), 1, &pointLightDiffuseColors[i].x);
-				glUniform3fv(glGetUniformLocation(prog.programId(), ("uPointLightSpecular[" + index + "]").c_str()), 1, &pointLightSpecularColors[i].x);
+				gl_state::depth_func(GL_LESS);
+				gl_state::depth_mask(true);
 			}
 
+			// GPU-culled instances, with one indirect multi-draw. Drawn with
+			// the normal depth test, as they are not in the depth pre-pass.
+			if (state.instances)
+				beacons->draw(instancedPass);
+
+			// Test the bounding boxes of this frame's conditional objects
+			// against the complete depth buffer, for the next frame
+			if (state.occlusionQueries)
+				occlusionQueries.test(i, depthOnly, depthVert_::uModelWorld);
+
+			glQueryCounter(opaque_render_time_query_ids[1], GL_TIMESTAMP);
+
 			// ------------------------ Particles ---------------------------------
+
+			glQueryCounter(particles_render_time_query_ids[0], GL_TIMESTAMP);
+
+			// Not in the render queue (nor the depth pre-pass): the particles
+			// are transformed on the CPU, each with its own temporary VAO
+			specularPass.bind();
+			specularPass.set(litVert_::uModelWorld, kIdentity44f);
+
 			if (state.spaceship_controls.moving == true){
 
 				float GlobalParticleTimeDif = 0.0f;
@@ -604,8 +1222,9 @@ int main() try
 					GLuint particles_vao1 = create_point_vao(newParticleData1, ParticleColor);
 					std::size_t particles_count1 = newParticleData1.size();
 
-					glBindVertexArray(particles_vao1);
+					gl_state::bind_vertex_array(particles_vao1);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count1);  
+					gl_state::delete_vertex_array(particles_vao1);
 
 					Vec3f particle2Pos = spaceship_mesh.positions[spaceship_mesh.positions.size()-1538];
 					particle2Pos.x = particle2Pos.x - 0.1 + ((ParticleTime1 * GlobalParticleTime) / 50.f);
@@ -622,8 +1241,9 @@ int main() try
 					//std::printf("%f, %f, %f\n", newParticleData[0].x, newParticleData[0].y, newParticleData[0].z);
 					GLuint particles_vao2 = create_point_vao(newParticleData2, ParticleColor);
 
-					glBindVertexArray(particles_vao2);
+					gl_state::bind_vertex_array(particles_vao2);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count1);
+					gl_state::delete_vertex_array(particles_vao2);
 				}
 				
 				if (GlobalParticleTimeDif >= 0.05f){
@@ -637,8 +1257,9 @@ int main() try
 					GLuint particles_vao3 = create_point_vao(newParticleData3, ParticleColor);
 					std::size_t particles_count3 = newParticleData3.size();
 
-					glBindVertexArray(particles_vao3);
+					gl_state::bind_vertex_array(particles_vao3);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count3);  
+					gl_state::delete_vertex_array(particles_vao3);
 
 					Vec3f particle4Pos = spaceship_mesh.positions[spaceship_mesh.positions.size()-1538];
 					particle4Pos.x = particle4Pos.x - 0.1 + ((ParticleTime2 * GlobalParticleTime) / 50.f);
@@ -654,8 +1275,9 @@ int main() try
 					std::vector<Vec3f> newParticleData4 = transformPointData(particle4Pos);
 					GLuint particles_vao4 = create_point_vao(newParticleData4, ParticleColor);
 
-					glBindVertexArray(particles_vao4);
+					gl_state::bind_vertex_array(particles_vao4);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count3);
+					gl_state::delete_vertex_array(particles_vao4);
 				}
 				
 				if (GlobalParticleTimeDif >= 0.1f){
@@ -668,8 +1290,9 @@ int main() try
 					GLuint particles_vao5 = create_point_vao(newParticleData5, ParticleColor);
 					std::size_t particles_count5 = newParticleData5.size();
 
-					glBindVertexArray(particles_vao5);
+					gl_state::bind_vertex_array(particles_vao5);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count5);  
+					gl_state::delete_vertex_array(particles_vao5);
 
 					Vec3f particle6Pos = spaceship_mesh.positions[spaceship_mesh.positions.size()-1538];
 					particle6Pos.x = particle6Pos.x - 0.1+ ((ParticleTime3 * GlobalParticleTime) / 50.f);
@@ -684,8 +1307,9 @@ int main() try
 					std::vector<Vec3f> newParticleData6 = transformPointData(particle6Pos);
 					GLuint particles_vao6 = create_point_vao(newParticleData6, ParticleColor);
 
-					glBindVertexArray(particles_vao6);
+					gl_state::bind_vertex_array(particles_vao6);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count5);
+					gl_state::delete_vertex_array(particles_vao6);
 				}
 				
 				if (GlobalParticleTimeDif >= 0.15f){
@@ -698,8 +1322,9 @@ int main() try
 					GLuint particles_vao7 = create_point_vao(newParticleData7, ParticleColor);
 					std::size_t particles_count7 = newParticleData7.size();
 
-					glBindVertexArray(particles_vao7);
+					gl_state::bind_vertex_array(particles_vao7);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count7);  
+					gl_state::delete_vertex_array(particles_vao7);
 
 					Vec3f particle8Pos = spaceship_mesh.positions[spaceship_mesh.positions.size()-1538];
 					particle8Pos.x = particle8Pos.x - 0.1 + ((ParticleTime4 * GlobalParticleTime) / 50.f);
@@ -714,8 +1339,9 @@ int main() try
 					std::vector<Vec3f> newParticleData8 = transformPointData(particle8Pos);
 					GLuint particles_vao8 = create_point_vao(newParticleData8, ParticleColor);
 
-					glBindVertexArray(particles_vao8);
+					gl_state::bind_vertex_array(particles_vao8);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count7);
+					gl_state::delete_vertex_array(particles_vao8);
 				}
 				if (GlobalParticleTimeDif >= 0.2f){
 				
@@ -728,8 +1354,9 @@ int main() try
 					GLuint particles_vao9 = create_point_vao(newParticleData9, ParticleColor);
 					std::size_t particles_count9 = newParticleData9.size();
 
-					glBindVertexArray(particles_vao9);
+					gl_state::bind_vertex_array(particles_vao9);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count9);  
+					gl_state::delete_vertex_array(particles_vao9);
 
 					Vec3f particle10Pos = spaceship_mesh.positions[spaceship_mesh.positions.size()-1538];
 					particle10Pos.x = particle10Pos.x - 0.1 + ((ParticleTime5 * GlobalParticleTime) / 50.f);
@@ -744,42 +1371,37 @@ int main() try
 					std::vector<Vec3f> newParticleData10 = transformPointData(particle10Pos);
 					GLuint particles_vao10 = create_point_vao(newParticleData10, ParticleColor);
 
-					glBindVertexArray(particles_vao10);
+					gl_state::bind_vertex_array(particles_vao10);
 					glDrawArrays(GL_TRIANGLES, 0, particles_count9);
+					gl_state::delete_vertex_array(particles_vao10);
 				}
 				
 				
 			}
-			
-
-			// ------------------------------- LANDING PAD -------------------------------
-
-			glQueryCounter(landing_pad_render_time_query_ids[0], GL_TIMESTAMP);
 
-			// Light for landing pad
-			// Mat44f landingpadModelMatrix = kIdentity44f;
-			//glUniformMatrix4fv(13, 1, GL_TRUE, landingpadModelMatrix.v);
+			glQueryCounter(particles_render_time_query_ids[1], GL_TIMESTAMP);
 
-			//Vec3f landingpadSpecularColor = { 0.f, 0.f, 1.f };
-			//glUniform3fv(6, 1, &landingpadSpecularColor.x);
-			float landingpadShininess = 32.0f;
-			glUniform1f(7, landingpadShininess);
+			// --------------------------- DEFERRED LIGHTING ----------------------------
 
-			Mat44f model1 = landingpadTransform1; 
-			Mat44f projCameraWorld1 = projection * world2camera * model1;
-			glUniformMatrix4fv(0, 1, GL_TRUE, projCameraWorld1.v);
-			glBindVertexArray(landingpad_vao);
-			glDrawArrays(GL_TRIANGLES, 0, landingpadVertexCount);
+			// Light the view's pixels of the G-buffer into the default
+			// framebuffer. Pixels without geometry keep the clear color.
+			if (state.deferred)
+			{
+				gl_state::bind_framebuffer(0);
+				gl_state::set_enabled(GL_DEPTH_TEST, false);
 
-			Mat44f model2 = landingpadTransform2;
-			Mat44f projCameraWorld2 = projection * world2camera * model2;
-			glUniformMatrix4fv(0, 1, GL_TRUE, projCameraWorld2.v);
-			glBindVertexArray(landingpad_vao);
-			glDrawArrays(GL_TRIANGLES, 0, landingpadVertexCount);
+				deferredLighting.bind();
+				deferredLighting.set(deferredFrag_::uShininess, 32.f);
 
-			glQueryCounter(landing_pad_render_time_query_ids[1], GL_TIMESTAMP);
+				gl_state::bind_texture(deferredFrag_::uGBufferAlbedo, gbuffer.albedoTexture());
+				gl_state::bind_texture(deferredFrag_::uGBufferNormal, gbuffer.normalTexture());
+				gl_state::bind_texture(deferredFrag_::uGBufferDepth, gbuffer.depthTexture());
 
+				gl_state::bind_vertex_array(fullscreenVao);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
 
+				gl_state::set_enabled(GL_DEPTH_TEST, true);
+			}
 
 
 			// ------------------------- END RENDER TIME --------------------------
@@ -787,9 +1409,9 @@ int main() try
 			glQueryCounter(full_render_time_query_ids[1], GL_TIMESTAMP);
 
 			GLuint64 full_render_start_time, full_render_stop_time,
-				 terrain_render_start_time, terrain_render_stop_time,
-				 spaceship_render_start_time, spaceship_render_stop_time,
-				 landing_pad_render_start_time, landing_pad_render_stop_time;
+				 opaque_render_start_time, opaque_render_stop_time,
+				 particles_render_start_time, particles_render_stop_time,
+				 depth_prepass_render_start_time, depth_prepass_render_stop_time;
 
 			glGetQueryObjectui64v(full_render_time_query_ids[0],
 					GL_QUERY_RESULT,
@@ -798,33 +1420,34 @@ int main() try
 					GL_QUERY_RESULT,
 					&full_render_stop_time);
 
-			glGetQueryObjectui64v(terrain_render_time_query_ids[0],
+			glGetQueryObjectui64v(opaque_render_time_query_ids[0],
 					GL_QUERY_RESULT,
-					&terrain_render_start_time);
-			glGetQueryObjectui64v(terrain_render_time_query_ids[1],
+					&opaque_render_start_time);
+			glGetQueryObjectui64v(opaque_render_time_query_ids[1],
 					GL_QUERY_RESULT,
-					&terrain_render_stop_time);
+					&opaque_render_stop_time);
 
-			glGetQueryObjectui64v(spaceship_render_time_query_ids[0],
+			glGetQueryObjectui64v(particles_render_time_query_ids[0],
 					GL_QUERY_RESULT,
-					&spaceship_render_start_time);
-			glGetQueryObjectui64v(spaceship_render_time_query_ids[1],
+					&particles_render_start_time);
+			glGetQueryObjectui64v(particles_render_time_query_ids[1],
 					GL_QUERY_RESULT,
-					&spaceship_render_stop_time);
+					&particles_render_stop_time);
 
-			glGetQueryObjectui64v(landing_pad_render_time_query_ids[0],
+			glGetQueryObjectui64v(depth_prepass_render_time_query_ids[0],
 					GL_QUERY_RESULT,
-					&landing_pad_render_start_time);
-			glGetQueryObjectui64v(landing_pad_render_time_query_ids[1],
+					&depth_prepass_render_start_time);
+			glGetQueryObjectui64v(depth_prepass_render_time_query_ids[1],
 					GL_QUERY_RESULT,
-					&landing_pad_render_stop_time);
-
-			std::printf("Terrain render time: %.6f ms\n",
-					(terrain_render_stop_time - terrain_render_start_time) / 1000000.f);
-			std::printf("Spaceship render time: %.6f ms\n",
-					(spaceship_render_stop_time - spaceship_render_start_time) / 1000000.f);
-			std::printf("Landing pad render time: %.6f ms\n",
-					(landing_pad_render_stop_time - landing_pad_render_start_time) / 1000000.f);
+					&depth_prepass_render_stop_time);
+
+			std::printf("Opaque render time (terrain, spaceship, landing pads): %.6f ms\n",
+					(opaque_render_stop_time - opaque_render_start_time) / 1000000.f);
+			std::printf("Particles render time: %.6f ms\n",
+					(particles_render_stop_time - particles_render_start_time) / 1000000.f);
+			if (state.depthPrepass)
+				std::printf("Depth pre-pass render time: %.6f ms\n",
+						(depth_prepass_render_stop_time - depth_prepass_render_start_time) / 1000000.f);
 			std::printf("Full render time: %.6f ms\n\n",
 					(full_render_stop_time - full_render_start_time) / 1000000.f);
 
@@ -847,10 +1470,77 @@ int main() try
 						state.spaceship_controls.pos.x,
 						state.spaceship_controls.pos.y,
 						state.spaceship_controls.pos.z);
+				std::printf("Texture memory: %.1f MiB\n", textureLoader.resident_bytes() / (1024.f*1024.f));
+
+				auto const queueStats = renderQueue.stats();
+				std::printf("Render queue: %zu draws (%zu conditional); %zu pipeline, %zu texture, %zu VAO binds\n",
+						queueStats.draws, queueStats.conditionalDraws, queueStats.pipelineBinds, queueStats.textureBinds, queueStats.vaoBinds);
+				renderQueue.reset_stats();
+
+				auto const& glCounters = gl_state::frame_counters();
+				std::printf("GL state calls (last frame, issued/skipped):");
+				for (std::size_t c = 0; c < gl_state::kCategoryCount; ++c)
+				{
+					std::printf(" %s %zu/%zu", gl_state::category_name(gl_state::Category(c)),
+							glCounters.issued[c], glCounters.skipped[c]);
+				}
+				std::printf("\n");
+
+				// Pick the object in the middle of the (first) view, by its
+				// bounds. The terrain's bounds contain the camera most of the
+				// time, so it is skipped.
+				Mat44f const camera2world = transpose(make_rotation_x(state.camera.pitch) * make_rotation_y(state.camera.yaw));
+				Vec3f const viewDir{ -camera2world(0,2), -camera2world(1,2), -camera2world(2,2) };
+
+				auto const pickTest = [] (std::uint32_t aObject, float aBoundsDistance) {
+					return kObjectTerrain_ == aObject ? -1.f : aBoundsDistance;
+				};
+
+				SceneIndex::RayHit hit;
+				if (sceneIndex.raycast(state.camera.pos, viewDir, kFar_, pickTest, hit))
+					std::printf("Looking at: %s (%.1f units)\n", kObjectNames_[hit.object], hit.distance);
+
+				auto const sceneStats = sceneIndex.stats();
+				std::printf("Scene index: %zu objects, %zu visible, height %zu; %zu nodes visited, %zu reinserts\n",
+						sceneStats.objects, visibleObjects.size(), sceneStats.height, sceneStats.nodesVisited, sceneStats.reinserts);
+				sceneIndex.reset_stats();
+
+				if (state.instances)
+					std::printf("Beacons: %zu of %zu drawn (last view)\n", beacons->visible_count(), beacons->instance_count());
+
+				if (state.cdlodTerrain)
+				{
+					auto const terrainStats = cdlodTerrain.stats();
+					std::printf("CDLOD terrain: %zu patches, %zu triangles; %zu nodes visited (last view)\n",
+							terrainStats.patches, terrainStats.triangles, terrainStats.nodesVisited);
+				}
+				else if (state.meshletCulling && terrainMeshlets)
+				{
+					auto const meshletStats = terrainMeshlets->stats();
+					std::printf("Terrain meshlets: %zu of %zu drawn, %zu of %zu triangles (last view)\n",
+							meshletStats.visibleMeshlets, meshletStats.meshlets, meshletStats.visibleTriangles, meshletStats.triangles);
+				}
+
+				if (state.occlusionQueries)
+				{
+					for (std::uint32_t const object : { kObjectShip_, kObjectPad1_, kObjectPad2_ })
+					{
+						auto const queryStats = occlusionQueries.stats(object);
+						std::printf("Occlusion queries, %s: %zu tests, %zu visible, %zu occluded, %zu unread; drawn %zu conditionally, %zu unconditionally\n",
+								kObjectNames_[object], queryStats.tests, queryStats.visible, queryStats.occluded, queryStats.unread,
+								queryStats.conditional, queryStats.unconditional);
+					}
+					occlusionQueries.reset_stats();
+				}
+
+				auto const lightStats = clusteredLights.stats();
+				std::printf("Point lights: %zu, %zu visible, %zu cluster entries (at most %zu per cluster)\n",
+						lightStats.lights, lightStats.visibleLights, lightStats.entries, lightStats.maxPerCluster);
 				state.lastPrintTime = currentTime;
 			}
 
 			// Display results
+			uniformBuffer.end_frame();
 			glfwSwapBuffers( window );
 
 			auto const frame_end_time = CPU_timer.now();
@@ -859,7 +1549,9 @@ int main() try
 	}
 
 	// Cleanup.
-	//TODO: additional cleanup
+	// Registry resources are released with their handles.
+	glDeleteVertexArrays(1, &spaceship_vao);
+	glDeleteVertexArrays(1, &fullscreenVao);
 
 	return 0;
 }
@@ -874,6 +1566,33 @@ catch( std::exception const& eErr )
 
 namespace
 {
+	void submit_mesh_(RenderQueue& aQueue, std::uint32_t aPass, ProgramPipeline& aPipeline, GLuint aTexture, GpuMesh const& aMesh, GLuint aVao, Mat44f const& aModel, float aDepth, std::size_t aLod, GLuint aCondition, MeshletCuller const* aMeshlets)
+	{
+		std::size_t const level = std::min(aLod, aMesh.lodCount-1);
+		auto const& lod = aMesh.lods[level];
+
+		RenderQueue::Draw draw;
+		draw.pipeline = &aPipeline;
+		draw.texture = aTexture;
+		draw.vao = aVao;
+		draw.indexed = aMesh.indexed;
+		draw.first = lod.first;
+		draw.count = lod.count;
+		draw.modelWorld = aModel;
+		draw.depth = aDepth;
+		draw.condition = aCondition;
+
+		// LOD 0 as the meshlets' indirect commands
+		if (aMeshlets && 0 == level)
+		{
+			draw.indirect = aMeshlets->commandBuffer();
+			draw.first = 0;
+			draw.count = GLsizei(aMeshlets->meshlet_count());
+		}
+
+		aQueue.submit(aPass, draw);
+	}
+
 	void glfw_callback_error_( int aErrNum, char const* aErrDesc )
 	{
 		std::fprintf( stderr, "GLFW error: %s (%d)\n", aErrDesc, aErrNum );
@@ -912,6 +1631,55 @@ namespace
 				}
 			}
 
+			// Switch between forward and deferred rendering
+			if( GLFW_KEY_G == aKey && GLFW_PRESS == aAction )
+			{
+				state->deferred = !state->deferred;
+				std::printf( "Render path: %s\n", state->deferred ? "deferred" : "forward" );
+			}
+
+			// Toggle the depth pre-pass
+			if( GLFW_KEY_P == aKey && GLFW_PRESS == aAction )
+			{
+				state->depthPrepass = !state->depthPrepass;
+				std::printf( "Depth pre-pass: %s\n", state->depthPrepass ? "on" : "off" );
+			}
+
+			// Toggle the GPU-culled instances
+			if( GLFW_KEY_I == aKey && GLFW_PRESS == aAction )
+			{
+				state->instances = !state->instances;
+				std::printf( "Instances: %s\n", state->instances ? "on" : "off" );
+			}
+
+			// Toggle occlusion culling (of the GPU-culled instances)
+			if( GLFW_KEY_O == aKey && GLFW_PRESS == aAction )
+			{
+				state->occlusionCulling = !state->occlusionCulling;
+				std::printf( "Occlusion culling: %s\n", state->occlusionCulling ? "on" : "off" );
+			}
+
+			// Toggle meshlet culling (of cooked meshes)
+			if( GLFW_KEY_M == aKey && GLFW_PRESS == aAction )
+			{
+				state->meshletCulling = !state->meshletCulling;
+				std::printf( "Meshlet culling: %s\n", state->meshletCulling ? "on" : "off" );
+			}
+
+			// Toggle the CDLOD terrain (else the terrain mesh is drawn)
+			if( GLFW_KEY_T == aKey && GLFW_PRESS == aAction )
+			{
+				state->cdlodTerrain = !state->cdlodTerrain;
+				std::printf( "CDLOD terrain: %s\n", state->cdlodTerrain ? "on" : "off" );
+			}
+
+			// Toggle the occlusion queries (of the space ship and the pads)
+			if( GLFW_KEY_B == aKey && GLFW_PRESS == aAction )
+			{
+				state->occlusionQueries = !state->occlusionQueries;
+				std::printf( "Occlusion queries: %s\n", state->occlusionQueries ? "on" : "off" );
+			}
+
 			// Change camera mode
 			if( GLFW_KEY_C == aKey )
 			{
@@ -1,5 +1,71 @@
 #include "mesh.hpp"
 
+#include <limits>
+#include <algorithm>
+
+#include "../support/gl_state.hpp"
+
+#include "shader_bindings.hpp"
+
+namespace
+{
+    // Vertex attribute locations of the lit shader
+    namespace attrib_ = shader_bindings::default_vert;
+
+    // The depth-only shader reads the positions from the same location
+    static_assert(shader_bindings::depth_vert::iPosition == attrib_::iPosition);
+
+    // Creates a VAO with just the position stream (and the element buffer, if
+    // any) of aMesh, so depth-only passes fetch as little as possible. The
+    // buffers must still exist, so they are kept in the mesh.
+    GLuint create_depth_vao_(GpuMesh const& aMesh)
+    {
+        GLuint vao = 0;
+        glGenVertexArrays(1, &vao);
+        gl_state::bind_vertex_array(vao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, aMesh.positionBuffer);
+        glVertexAttribPointer(attrib_::iPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(attrib_::iPosition);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, aMesh.indexBuffer);
+
+        gl_state::bind_vertex_array(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        return vao;
+    }
+
+    // Attaches the vertex buffers and the element buffer (if any) of aMesh
+    // to the currently bound VAO, with the same layout as aMesh.vao
+    void attach_vertex_arrays_(GpuMesh const& aMesh)
+    {
+        struct Array_
+        {
+            GLuint location, buffer;
+            GLint size;
+        } const arrays[] = {
+            { attrib_::iPosition, aMesh.positionBuffer, 3 },
+            { attrib_::iColor, aMesh.colorBuffer, 3 },
+            { attrib_::iNormal, aMesh.normalBuffer, 3 },
+            { attrib_::iTexCoord, aMesh.texcoordBuffer, 2 }
+        };
+
+        for (auto const& a : arrays)
+        {
+            if (!a.buffer)
+                continue;
+
+            glBindBuffer(GL_ARRAY_BUFFER, a.buffer);
+            glVertexAttribPointer(a.location, a.size, GL_FLOAT, GL_FALSE, 0, nullptr);
+            glEnableVertexAttribArray(a.location);
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, aMesh.indexBuffer);
+    }
+}
+
 MeshData mergeMeshes(std::vector<MeshData> const meshes)
 {
   MeshData newMesh;
@@ -37,6 +103,17 @@ MeshData transformMesh(MeshData mesh, Mat44f aTransform)
 
 
 GLuint create_vao(MeshData const& aMeshData) {
+    GpuMesh mesh;
+    GLuint vao = create_vao(aMeshData, mesh);
+
+    // Delete (the VAO keeps the buffers alive)
+    GLuint const buffers[] = { mesh.positionBuffer, mesh.colorBuffer, mesh.normalBuffer, mesh.texcoordBuffer };
+    glDeleteBuffers(4, buffers);
+
+    return vao;
+}
+
+GLuint create_vao(MeshData const& aMeshData, GpuMesh& aMesh) {
     GLuint positionVBO = 0;
     GLuint colorVBO = 0;
     GLuint normalVBO = 0;
@@ -45,28 +122,28 @@ GLuint create_vao(MeshData const& aMeshData) {
 
     // Create and bind vao
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    gl_state::bind_vertex_array(vao);
 
     // Position VBO
     glGenBuffers(1, &positionVBO);
     glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
     glBufferData(GL_ARRAY_BUFFER, aMeshData.positions.size() * sizeof(Vec3f), aMeshData.positions.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(attrib_::iPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(attrib_::iPosition);
 
     // Color VBO
     glGenBuffers(1, &colorVBO);
     glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
     glBufferData(GL_ARRAY_BUFFER, aMeshData.colors.size() * sizeof(Vec3f), aMeshData.colors.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(attrib_::iColor, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(attrib_::iColor);
 
     // Normal VBO
     glGenBuffers(1, &normalVBO);
     glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
     glBufferData(GL_ARRAY_BUFFER, aMeshData.normals.size() * sizeof(Vec3f), aMeshData.normals.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(attrib_::iNormal, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(attrib_::iNormal);
 
     // Texture coord VBO
     // SpaceShip don't have any texture, so we need to add this if. 
@@ -76,24 +153,172 @@ GLuint create_vao(MeshData const& aMeshData) {
         glGenBuffers(1, &texcoordVBO);
         glBindBuffer(GL_ARRAY_BUFFER, texcoordVBO);
         glBufferData(GL_ARRAY_BUFFER, aMeshData.texcoords.size() * sizeof(Vec2f), aMeshData.texcoords.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(attrib_::iTexCoord, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(attrib_::iTexCoord);
     }
 
     // Unbind
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state::bind_vertex_array(0);
 
-    // Delete
-    glDeleteBuffers(1, &positionVBO);
-    glDeleteBuffers(1, &colorVBO);
-    glDeleteBuffers(1, &normalVBO);
-    if (!aMeshData.texcoords.empty()) 
+    // The mesh owns the buffers
+    aMesh.positionBuffer = positionVBO;
+    aMesh.colorBuffer = colorVBO;
+    aMesh.normalBuffer = normalVBO;
+    aMesh.texcoordBuffer = texcoordVBO;
+
+    return vao;
+}
+
+GLuint create_instanced_vao(GpuMesh const& aMesh, GLuint aInstanceBuffer)
+{
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+
+    gl_state::bind_vertex_array(vao);
+    attach_vertex_arrays_(aMesh);
+
+    glBindBuffer(GL_ARRAY_BUFFER, aInstanceBuffer);
+    glVertexAttribIPointer(attrib_::iInstance, 1, GL_UNSIGNED_INT, 0, 0);
+    glVertexAttribDivisor(attrib_::iInstance, 1);
+    glEnableVertexAttribArray(attrib_::iInstance);
+
+    gl_state::bind_vertex_array(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return vao;
+}
+
+Aabb mesh_bounds(MeshData const& aMeshData)
+{
+    Aabb bounds = kEmptyAabb;
+    for (auto const& p : aMeshData.positions)
+        bounds = aabb_union(bounds, p);
+    return bounds;
+}
+
+Aabb mesh_bounds(GpuMesh const& aMesh)
+{
+    return Aabb{ aMesh.boundsMin, aMesh.boundsMax };
+}
+
+GpuMesh create_gpu_mesh(MeshData const& aMeshData)
+{
+    GpuMesh mesh;
+    mesh.vao = create_vao(aMeshData, mesh);
+    mesh.depthVao = create_depth_vao_(mesh);
+    mesh.indexed = false;
+    mesh.lodCount = 1;
+    mesh.lods[0] = { 0, GLsizei(aMeshData.positions.size()), 0.f };
+
+    Aabb const bounds = mesh_bounds(aMeshData);
+    mesh.boundsMin = bounds.min;
+    mesh.boundsMax = bounds.max;
+
+    return mesh;
+}
+
+GpuMesh create_gpu_mesh(CookedMesh const& aCooked)
+{
+    auto const& header = *aCooked.header;
+
+    GLuint buffers[5] = {};
+    GLuint vao = 0;
+
+    glGenVertexArrays(1, &vao);
+    gl_state::bind_vertex_array(vao);
+
+    glGenBuffers(5, buffers);
+
+    // The cooked arrays are uploaded as they are, using the same attribute
+    // locations as create_vao().
+    auto const vec3Bytes = GLsizeiptr(header.vertexCount) * 3 * sizeof(float);
+    float const* streams[] = { aCooked.positions, aCooked.colors, aCooked.normals };
+    GLuint const attribs[] = { attrib_::iPosition, attrib_::iColor, attrib_::iNormal };
+    for (GLuint i = 0; i < 3; ++i)
     {
-        glDeleteBuffers(1, &texcoordVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, vec3Bytes, streams[i], GL_STATIC_DRAW);
+        glVertexAttribPointer(attribs[i], 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(attribs[i]);
     }
 
-    return vao;
+    if (aCooked.texcoords)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[3]);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(header.vertexCount) * 2 * sizeof(float), aCooked.texcoords, GL_STATIC_DRAW);
+        glVertexAttribPointer(attrib_::iTexCoord, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(attrib_::iTexCoord);
+    }
+
+    // The element buffer binding is part of the VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[4]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(header.indexCount) * sizeof(std::uint32_t), aCooked.indices, GL_STATIC_DRAW);
+
+    // Unbind
+    gl_state::bind_vertex_array(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // The mesh owns the buffers. The texture coordinate buffer is only used
+    // if there are texture coordinates.
+    if (!aCooked.texcoords)
+    {
+        glDeleteBuffers(1, &buffers[3]);
+        buffers[3] = 0;
+    }
+
+    GpuMesh mesh;
+    mesh.vao = vao;
+    mesh.positionBuffer = buffers[0];
+    mesh.colorBuffer = buffers[1];
+    mesh.normalBuffer = buffers[2];
+    mesh.texcoordBuffer = buffers[3];
+    mesh.indexBuffer = buffers[4];
+    mesh.depthVao = create_depth_vao_(mesh);
+    mesh.indexed = true;
+    mesh.lodCount = header.lodCount;
+    for (std::size_t i = 0; i < header.lodCount; ++i)
+        mesh.lods[i] = { GLsizei(header.lods[i].firstIndex), GLsizei(header.lods[i].indexCount), header.lods[i].error };
+
+    mesh.boundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+    mesh.boundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+
+    if (header.meshletCount)
+    {
+        glGenBuffers(1, &mesh.meshletBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh.meshletBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(header.meshletCount) * sizeof(CookedMeshlet), aCooked.meshlets, GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        mesh.meshletCount = header.meshletCount;
+    }
+
+    return mesh;
+}
+
+std::size_t select_lod(GpuMesh const& aMesh, float aDistance, float aPixelsPerUnit, float aMaxPixels)
+{
+    std::size_t lod = 0;
+    for (std::size_t i = 1; i < aMesh.lodCount; ++i)
+    {
+        if (aMesh.lods[i].error * aPixelsPerUnit > aMaxPixels * aDistance)
+            break;
+        lod = i;
+    }
+    return lod;
+}
+
+void draw_gpu_mesh(GpuMesh const& aMesh, std::size_t aLod)
+{
+    auto const& lod = aMesh.lods[std::min(aLod, aMesh.lodCount-1)];
+
+    gl_state::bind_vertex_array(aMesh.vao);
+    if (aMesh.indexed)
+        glDrawElements(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, (void const*)(std::size_t(lod.first) * sizeof(std::uint32_t)));
+    else
+        glDrawArrays(GL_TRIANGLES, lod.first, lod.count);
 }
 
 std::vector<Vec3f> transformPointData (Vec3f newPos){
@@ -117,25 +342,25 @@ GLuint create_point_vao(std::vector<Vec3f> pointData, Vec3f color) {
 
     // Create and bind vao
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    gl_state::bind_vertex_array(vao);
 
     // Position VBO
     glGenBuffers(1, &positionVBO);
     glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
     glBufferData(GL_ARRAY_BUFFER, pointData.size() * sizeof(Vec3f), pointData.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(attrib_::iPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(attrib_::iPosition);
 
     // Color VBO
     glGenBuffers(1, &colorVBO);
     glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(color), std::vector<Vec3f>{color}.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(attrib_::iColor, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(attrib_::iColor);
 
     // Unbind
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state::bind_vertex_array(0);
 
     // Delete
     glDeleteBuffers(1, &positionVBO);
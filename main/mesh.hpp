@@ -10,6 +10,9 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/mat44.hpp"
 #include "../vmlib/mat33.hpp"
+#include "../vmlib/aabb.hpp"
+
+#include "../support/cooked.hpp"
 
 struct MeshData
 {
@@ -19,10 +22,71 @@ struct MeshData
   std::vector<Vec2f> texcoords;
 };
 
+// Vertex array object plus what is needed to draw it. Meshes created from
+// cooked files are indexed and may have several LODs, which share the
+// vertex data. Meshes created from MeshData are not indexed and have a
+// single LOD.
+struct GpuMeshLod
+{
+  GLsizei first;  // first index (or vertex, if not indexed)
+  GLsizei count;
+  float error;    // geometric error in object space units
+};
+
+struct GpuMesh
+{
+  GLuint vao = 0;
+  bool indexed = false;
+
+  // Positions only, for depth-only passes. Shares the position and index
+  // buffers of vao.
+  GLuint depthVao = 0;
+
+  // Buffers of vao, which other VAOs (depthVao, create_instanced_vao()) use
+  // too; owned by the mesh. texcoordBuffer is 0 if the mesh has no texture
+  // coordinates, indexBuffer if it is not indexed.
+  GLuint positionBuffer = 0;
+  GLuint colorBuffer = 0;
+  GLuint normalBuffer = 0;
+  GLuint texcoordBuffer = 0;
+  GLuint indexBuffer = 0;
+
+  std::size_t lodCount = 0;
+  GpuMeshLod lods[kCookedMaxLods];
+
+  Vec3f boundsMin{}, boundsMax{};
+
+  // Meshlets of LOD 0 (CookedMeshlet), in a shader storage buffer; cooked
+  // meshes only. See MeshletCuller.
+  GLuint meshletBuffer = 0;
+  std::size_t meshletCount = 0;
+};
+
 MeshData mergeMeshes(std::vector<MeshData> const meshes);
 MeshData transformMesh(MeshData mesh, Mat44f aTransform);
 
+// Object space bounds
+Aabb mesh_bounds(MeshData const&);
+Aabb mesh_bounds(GpuMesh const&);
+
 GLuint create_vao(MeshData const&);
+// As above, but the vertex buffers are not deleted; their names are stored
+// in aMesh, which then owns them
+GLuint create_vao(MeshData const&, GpuMesh& aMesh);
+GpuMesh create_gpu_mesh(MeshData const&);
+GpuMesh create_gpu_mesh(CookedMesh const&);
+
+// VAO with the vertex arrays of aMesh, plus a per-instance index (divisor 1)
+// from aInstanceBuffer; see the USE_INSTANCES variant of default.vert
+GLuint create_instanced_vao(GpuMesh const&, GLuint aInstanceBuffer);
+
+// Picks the coarsest LOD whose error, projected at aDistance, stays below
+// aMaxPixels. aPixelsPerUnit is the projected size of one unit at distance
+// one, i.e. viewportHeight / (2 * tan(fovY/2)).
+std::size_t select_lod(GpuMesh const&, float aDistance, float aPixelsPerUnit, float aMaxPixels = 1.f);
+
+void draw_gpu_mesh(GpuMesh const&, std::size_t aLod = 0);
+
 GLuint create_point_vao(std::vector<Vec3f> pointData, Vec3f color);
 std::vector<Vec3f> transformPointData (Vec3f newPos);
 
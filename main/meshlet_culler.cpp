@@ -0,0 +1,88 @@
+#include "meshlet_culler.hpp"
+
+#include <vector>
+
+#include "../support/error.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "shader_bindings.hpp"
+
+namespace
+{
+	namespace meshlets_ = shader_bindings::meshlets_comp;
+
+	constexpr std::size_t kCommandSize_ = 5; // DrawElementsIndirectCommand
+
+	constexpr GLuint kWorkGroupSize_ = 64; // local_size_x in meshlets.comp
+}
+
+MeshletCuller::MeshletCuller( GpuMesh const& aMesh )
+	: mMesh( aMesh )
+{
+	if( 0 == aMesh.meshletCount )
+		throw Error( "MeshletCuller: mesh has no meshlets" );
+
+	glGenBuffers( 1, &mCommandBuffer );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+MeshletCuller::~MeshletCuller()
+{
+	glDeleteBuffers( 1, &mCommandBuffer );
+}
+
+void MeshletCuller::cull( ShaderProgram& aCull, Mat44f const& aModelWorld )
+{
+	// New storage for the commands: draws of the previous view may still be
+	// reading the old ones
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommandBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(mMesh.meshletCount * kCommandSize_ * sizeof(GLuint)), nullptr, GL_DYNAMIC_COPY );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	aCull.set( meshlets_::uModelWorld, aModelWorld );
+	aCull.set( meshlets_::uMeshletCount, int(mMesh.meshletCount) );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, meshlets_::Meshlets, mMesh.meshletBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, meshlets_::MeshletCommands, mCommandBuffer );
+
+	gl_state::use_program( aCull.programId() );
+	glDispatchCompute( GLuint((mMesh.meshletCount + kWorkGroupSize_-1) / kWorkGroupSize_), 1, 1 );
+
+	// The commands are read by the indirect draws
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+GLuint MeshletCuller::commandBuffer() const noexcept
+{
+	return mCommandBuffer;
+}
+std::size_t MeshletCuller::meshlet_count() const noexcept
+{
+	return mMesh.meshletCount;
+}
+
+MeshletCuller::Stats MeshletCuller::stats() const
+{
+	std::vector<GLuint> commands( mMesh.meshletCount * kCommandSize_ );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer );
+	glGetBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, GLsizeiptr(commands.size() * sizeof(GLuint)), commands.data() );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	Stats ret;
+	ret.meshlets = mMesh.meshletCount;
+	ret.triangles = std::size_t(mMesh.lods[0].count) / 3;
+	for( std::size_t i = 0; i < mMesh.meshletCount; ++i )
+	{
+		if( 0 == commands[kCommandSize_ * i + 1] )
+			continue;
+
+		++ret.visibleMeshlets;
+		ret.visibleTriangles += commands[kCommandSize_ * i] / 3;
+	}
+	return ret;
+}
@@ -0,0 +1,70 @@
+#ifndef MESHLET_CULLER_HPP_DC46D4E7_AF31_431F_AC8A_BAAEDCCF4EF2
+#define MESHLET_CULLER_HPP_DC46D4E7_AF31_431F_AC8A_BAAEDCCF4EF2
+
+#include <glad.h>
+
+#include <cstdlib>
+
+#include "../vmlib/mat44.hpp"
+
+#include "../support/program.hpp"
+
+#include "mesh.hpp"
+
+/* Meshlet culling of one placement of a mesh
+ *
+ * The asset cooker splits LOD 0 of cooked meshes into meshlets, clusters of
+ * up to kCookedMeshletMaxTriangles adjacent triangles, each with a bounding
+ * sphere and a cone bounding its triangles' normals (see support/cooked.hpp).
+ * Per view, cull() runs assets/meshlets.comp, which writes an indirect draw
+ * command per meshlet: empty if the meshlet is outside of the view frustum
+ * or faces away from the camera, else its range of the index buffer. The
+ * commands are then drawn with a single glMultiDrawElementsIndirect() (see
+ * RenderQueue::Draw::indirect), so only the meshlets that may contribute
+ * pixels are processed, at no CPU cost per meshlet.
+ *
+ * Each placement (model matrix) of a mesh needs its own culler.
+ */
+class MeshletCuller final
+{
+	public:
+		// Of the last cull()
+		struct Stats
+		{
+			std::size_t meshlets = 0;
+			std::size_t visibleMeshlets = 0;
+			std::size_t triangles = 0;
+			std::size_t visibleTriangles = 0;
+		};
+
+	public:
+		// Throws Error if the mesh has no meshlets. The mesh must outlive
+		// the culler.
+		explicit MeshletCuller( GpuMesh const& aMesh );
+		~MeshletCuller();
+
+		MeshletCuller( MeshletCuller const& ) = delete;
+		MeshletCuller& operator= (MeshletCuller const&) = delete;
+
+	public:
+		// Culls the meshlets against the current view, whose uniform block
+		// must be bound. aModelWorld may only rotate, translate and
+		// uniformly scale. aCull is the program of assets/meshlets.comp.
+		void cull( ShaderProgram& aCull, Mat44f const& aModelWorld );
+
+		// DrawElementsIndirectCommands, one per meshlet, as of the last
+		// cull(). Each cull() orphans the previous commands, so draws of
+		// earlier views are not affected.
+		GLuint commandBuffer() const noexcept;
+		std::size_t meshlet_count() const noexcept;
+
+		// Reads back the commands, which waits for the GPU; for statistics
+		// only.
+		Stats stats() const;
+
+	private:
+		GpuMesh const& mMesh;
+		GLuint mCommandBuffer = 0;
+};
+
+#endif // MESHLET_CULLER_HPP_DC46D4E7_AF31_431F_AC8A_BAAEDCCF4EF2
@@ -0,0 +1,206 @@
+#include "occlusion_queries.hpp"
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/gl_state.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "shader_bindings.hpp"
+
+namespace
+{
+	namespace depthVert_ = shader_bindings::depth_vert;
+
+	constexpr float kBoxPositions_[] = {
+		0.f, 0.f, 0.f,   1.f, 0.f, 0.f,   1.f, 1.f, 0.f,   0.f, 1.f, 0.f,
+		0.f, 0.f, 1.f,   1.f, 0.f, 1.f,   1.f, 1.f, 1.f,   0.f, 1.f, 1.f
+	};
+
+	// Two triangles per face. Winding does not matter, as the boxes are
+	// drawn without face culling.
+	constexpr GLubyte kBoxIndices_[] = {
+		0, 1, 2,  0, 2, 3,   // -z
+		4, 6, 5,  4, 7, 6,   // +z
+		0, 4, 5,  0, 5, 1,   // -y
+		3, 2, 6,  3, 6, 7,   // +y
+		0, 3, 7,  0, 7, 4,   // -x
+		1, 5, 6,  1, 6, 2    // +x
+	};
+
+	constexpr GLsizei kBoxIndexCount_ = GLsizei(sizeof(kBoxIndices_) / sizeof(kBoxIndices_[0]));
+
+	// The boxes are inflated by this fraction of their size, plus a minimum
+	// distance, per side, so that faces that lie on the object's own surface
+	// (e.g., the top of a landing pad) are not hidden by it
+	constexpr float kBoxInflation_ = 0.01f;
+	constexpr float kBoxMinMargin_ = 1e-3f;
+}
+
+OcclusionQueries::OcclusionQueries( std::size_t aObjectCount, std::size_t aViewCount, float aCameraMargin )
+	: mObjectCount( aObjectCount )
+	, mViewCount( aViewCount )
+	, mCameraMargin( aCameraMargin )
+	, mSlots( aObjectCount * aViewCount )
+	, mStats( aObjectCount )
+{
+	if( mSlots.empty() )
+		throw Error( "OcclusionQueries: no objects or no views" );
+
+	std::vector<GLuint> queries( mSlots.size() );
+	glGenQueries( GLsizei(queries.size()), queries.data() );
+	for( std::size_t i = 0; i < mSlots.size(); ++i )
+		mSlots[i].query = queries[i];
+
+	glGenBuffers( 1, &mBoxPositions );
+	glBindBuffer( GL_ARRAY_BUFFER, mBoxPositions );
+	glBufferData( GL_ARRAY_BUFFER, sizeof(kBoxPositions_), kBoxPositions_, GL_STATIC_DRAW );
+
+	glGenBuffers( 1, &mBoxIndices );
+
+	glGenVertexArrays( 1, &mBoxVao );
+	gl_state::bind_vertex_array( mBoxVao );
+
+	glEnableVertexAttribArray( depthVert_::iPosition );
+	glVertexAttribPointer( depthVert_::iPosition, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mBoxIndices );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof(kBoxIndices_), kBoxIndices_, GL_STATIC_DRAW );
+
+	gl_state::bind_vertex_array( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+	gl_state::delete_vertex_array( mBoxVao );
+	glDeleteBuffers( 1, &mBoxIndices );
+	glDeleteBuffers( 1, &mBoxPositions );
+
+	for( auto const& slot : mSlots )
+		glDeleteQueries( 1, &slot.query );
+}
+
+void OcclusionQueries::begin_frame()
+{
+	++mFrame;
+
+	for( std::size_t i = 0; i < mSlots.size(); ++i )
+		read_( mSlots[i], i % mObjectCount, false );
+}
+
+GLuint OcclusionQueries::condition( std::size_t aView, std::size_t aObject, Aabb const& aBounds, Vec3f aCamera )
+{
+	Slot_& slot = slot_( aView, aObject );
+	Stats& stats = mStats[aObject];
+
+	// The near plane would clip the box, whose remaining faces could then
+	// all be hidden behind the object itself
+	if( distance_squared( aBounds, aCamera ) <= mCameraMargin * mCameraMargin )
+	{
+		slot.pending = false;
+		++stats.unconditional;
+		return 0;
+	}
+
+	slot.pending = true;
+	slot.bounds = aBounds;
+
+	// Only last frame's test is recent enough to go by
+	if( 0 == slot.testFrame || slot.testFrame + 1 != mFrame )
+	{
+		++stats.unconditional;
+		return 0;
+	}
+
+	++stats.conditional;
+	return slot.query;
+}
+
+void OcclusionQueries::test( std::size_t aView, ProgramPipeline& aDepthOnly, ShaderProgram::Location<Mat44f> aModelWorld )
+{
+	assert( aView < mViewCount );
+
+	aDepthOnly.bind();
+	gl_state::bind_vertex_array( mBoxVao );
+
+	gl_state::color_mask( false );
+	gl_state::depth_mask( false );
+	gl_state::depth_func( GL_LEQUAL );
+	gl_state::set_enabled( GL_CULL_FACE, false );
+
+	for( std::size_t object = 0; object < mObjectCount; ++object )
+	{
+		Slot_& slot = slot_( aView, object );
+		if( !slot.pending )
+			continue;
+
+		// Reusing the query discards its previous result
+		read_( slot, object, true );
+
+		Vec3f const margin = kBoxInflation_ * (slot.bounds.max - slot.bounds.min) + Vec3f{ kBoxMinMargin_, kBoxMinMargin_, kBoxMinMargin_ };
+		Vec3f const size = slot.bounds.max - slot.bounds.min + 2.f * margin;
+		aDepthOnly.set( aModelWorld, make_translation( slot.bounds.min - margin ) * make_scaling( size.x, size.y, size.z ) );
+
+		glBeginQuery( GL_ANY_SAMPLES_PASSED_CONSERVATIVE, slot.query );
+		glDrawElements( GL_TRIANGLES, kBoxIndexCount_, GL_UNSIGNED_BYTE, nullptr );
+		glEndQuery( GL_ANY_SAMPLES_PASSED_CONSERVATIVE );
+
+		slot.pending = false;
+		slot.read = false;
+		slot.testFrame = mFrame;
+		++mStats[object].tests;
+	}
+
+	gl_state::set_enabled( GL_CULL_FACE, true );
+	gl_state::depth_func( GL_LESS );
+	gl_state::depth_mask( true );
+	gl_state::color_mask( true );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+OcclusionQueries::Stats OcclusionQueries::stats( std::size_t aObject ) const noexcept
+{
+	assert( aObject < mObjectCount );
+	return mStats[aObject];
+}
+void OcclusionQueries::reset_stats() noexcept
+{
+	for( auto& stats : mStats )
+		stats = Stats{};
+}
+
+OcclusionQueries::Slot_& OcclusionQueries::slot_( std::size_t aView, std::size_t aObject )
+{
+	assert( aView < mViewCount && aObject < mObjectCount );
+	return mSlots[aView * mObjectCount + aObject];
+}
+
+void OcclusionQueries::read_( Slot_& aSlot, std::size_t aObject, bool aLast )
+{
+	if( aSlot.read )
+		return;
+
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv( aSlot.query, GL_QUERY_RESULT_AVAILABLE, &available );
+	if( GL_TRUE == available )
+	{
+		GLuint passed = GL_FALSE;
+		glGetQueryObjectuiv( aSlot.query, GL_QUERY_RESULT, &passed );
+
+		if( passed )
+			++mStats[aObject].visible;
+		else
+			++mStats[aObject].occluded;
+
+		aSlot.read = true;
+	}
+	else if( aLast )
+	{
+		++mStats[aObject].unread;
+		aSlot.read = true;
+	}
+}
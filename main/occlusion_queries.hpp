@@ -0,0 +1,109 @@
+#ifndef OCCLUSION_QUERIES_HPP_9A78CE0A_D6BC_417C_A640_69C9FC319EFC
+#define OCCLUSION_QUERIES_HPP_9A78CE0A_D6BC_417C_A640_69C9FC319EFC
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/aabb.hpp"
+
+#include "../support/program.hpp"
+#include "../support/program_pipeline.hpp"
+
+/* Occlusion queries of (expensive) objects
+ *
+ * Each object has an occlusion query per view. After the opaque pass, test()
+ * draws the bounding boxes of the objects, without writing color or depth,
+ * each within its query. The next frame, the object's draws are conditional
+ * on that query (see RenderQueue::Draw::condition), with GL_QUERY_NO_WAIT:
+ * the GPU skips them if no sample of the box passed the depth test, and draws
+ * them if the result is not in yet. The CPU never waits for a result.
+ *
+ * The results are thus one frame late: an object that comes into view from
+ * behind an occluder appears a frame later. Objects whose bounds contain the
+ * camera (or nearly so, as the near plane would clip the box) are neither
+ * tested nor drawn conditionally, and neither are objects that were not
+ * tested the previous frame.
+ *
+ * Results are also read back for statistics, only once they are available.
+ */
+class OcclusionQueries final
+{
+	public:
+		// Per object, accumulated over all views
+		struct Stats
+		{
+			std::size_t tests = 0;          // bounding boxes drawn
+			std::size_t visible = 0;        // results read: some samples passed
+			std::size_t occluded = 0;       // results read: no samples passed
+			std::size_t unread = 0;         // results not available before the next test
+			std::size_t conditional = 0;    // frames drawn conditionally
+			std::size_t unconditional = 0;  // frames drawn without a condition
+		};
+
+	public:
+		// aCameraMargin is the distance to the bounds within which the camera
+		// counts as inside. It must be at least the distance from the camera
+		// to the corners of the near plane.
+		OcclusionQueries( std::size_t aObjectCount, std::size_t aViewCount, float aCameraMargin );
+		~OcclusionQueries();
+
+		OcclusionQueries( OcclusionQueries const& ) = delete;
+		OcclusionQueries& operator= (OcclusionQueries const&) = delete;
+
+	public:
+		// Call once per frame, before the views. Reads the results that have
+		// become available.
+		void begin_frame();
+
+		// Returns the query to draw the object conditionally on in this
+		// view, or 0 to draw it unconditionally. The object is tested in
+		// the view's next test(), with the given world bounds.
+		GLuint condition( std::size_t aView, std::size_t aObject, Aabb const& aBounds, Vec3f aCamera );
+
+		// Draws the bounding boxes of the objects passed to condition()
+		// since the last test() of the view. Call with the view's complete
+		// depth buffer bound; aDepthOnly is a depth-only pipeline whose model
+		// matrix is at aModelWorld. The boxes are slightly inflated, and
+		// tested with GL_LEQUAL. Leaves color and depth writes, and face
+		// culling, enabled, and the depth test at GL_LESS.
+		void test( std::size_t aView, ProgramPipeline& aDepthOnly, ShaderProgram::Location<Mat44f> aModelWorld );
+
+		Stats stats( std::size_t aObject ) const noexcept;
+		void reset_stats() noexcept;
+
+	private:
+		struct Slot_
+		{
+			GLuint query = 0;
+			std::uint64_t testFrame = 0;   // frame of the last test; 0: none
+			bool read = true;              // result of the last test was read
+			bool pending = false;          // to be tested by the next test()
+			Aabb bounds = kEmptyAabb;
+		};
+
+		Slot_& slot_( std::size_t aView, std::size_t aObject );
+		void read_( Slot_&, std::size_t aObject, bool aLast );
+
+	private:
+		std::size_t mObjectCount;
+		std::size_t mViewCount;
+		float mCameraMargin;
+
+		std::vector<Slot_> mSlots;     // per view, per object
+		std::vector<Stats> mStats;     // per object
+
+		std::uint64_t mFrame = 0;
+
+		// Unit cube, [0,1]^3
+		GLuint mBoxPositions = 0;
+		GLuint mBoxIndices = 0;
+		GLuint mBoxVao = 0;
+};
+
+#endif // OCCLUSION_QUERIES_HPP_9A78CE0A_D6BC_417C_A640_69C9FC319EFC
@@ -0,0 +1,146 @@
+#include "resources.hpp"
+
+#include <optional>
+#include <filesystem>
+
+#include "../support/cooked.hpp"
+#include "../support/gl_state.hpp"
+
+#include "assets.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	template< typename tResource >
+	std::weak_ptr<tResource> const& weak_( std::weak_ptr<tResource> const& aResource )
+	{
+		return aResource;
+	}
+	template< typename tEntry >
+	auto const& weak_( tEntry const& aEntry )
+	{
+		return aEntry.resource;
+	}
+
+	template< typename tMap >
+	std::size_t live_count_( tMap const& aMap )
+	{
+		std::size_t count = 0;
+		for( auto const& entry : aMap )
+		{
+			if( !weak_( entry.second ).expired() )
+				++count;
+		}
+		return count;
+	}
+
+	template< typename tMap >
+	void prune_( tMap& aMap )
+	{
+		for( auto it = aMap.begin(); it != aMap.end(); )
+		{
+			if( weak_( it->second ).expired() )
+				it = aMap.erase( it );
+			else
+				++it;
+		}
+	}
+
+	std::uint64_t hash_file_( char const* aPath )
+	{
+		auto const bytes = read_file_bytes( aPath );
+		return fnv1a64( bytes.data(), bytes.size() );
+	}
+}
+
+template< typename tResource, typename tLoad >
+std::shared_ptr<tResource> ResourceRegistry::get_( Cache_<tResource>& aCache, char const* aPath, tLoad&& aLoad )
+{
+	++mRequests;
+
+	// Same path?
+	auto& byPath = aCache.byPath[aPath];
+	if( auto res = byPath.lock() )
+		return res;
+
+	// Same contents under a different path? Only a file of the same size
+	// can be, so the contents are only read and hashed in that case.
+	std::error_code ec;
+	auto const size = fs::file_size( aPath, ec );
+
+	std::optional<std::uint64_t> hash;
+	if( !ec )
+	{
+		auto const [first, last] = aCache.bySize.equal_range( size );
+		for( auto it = first; it != last; ++it )
+		{
+			auto& entry = it->second;
+			auto res = entry.resource.lock();
+			if( !res || !entry.sized )
+				continue;
+
+			if( !hash )
+				hash = hash_file_( aPath );
+			if( !entry.hashed )
+			{
+				entry.hash = hash_file_( entry.path.c_str() );
+				entry.hashed = true;
+			}
+
+			if( *hash == entry.hash )
+			{
+				byPath = res;
+				return res;
+			}
+		}
+	}
+
+	++mLoads;
+	auto res = aLoad( aPath );
+	byPath = res;
+	aCache.bySize.emplace( ec ? 0 : size, typename Cache_<tResource>::Entry_{ aPath, !ec, hash.has_value(), hash.value_or( 0 ), res } );
+	return res;
+}
+
+ResourceRegistry::Mesh ResourceRegistry::mesh( char const* aPath )
+{
+	return get_( mMeshes, aPath, [] (char const* aMeshPath) {
+		return std::shared_ptr<GpuMesh const>( new GpuMesh( load_mesh_asset( aMeshPath ) ), [] (GpuMesh const* aMesh) {
+			gl_state::delete_vertex_array( aMesh->vao );
+			gl_state::delete_vertex_array( aMesh->depthVao );
+			GLuint const buffers[] = { aMesh->positionBuffer, aMesh->colorBuffer, aMesh->normalBuffer, aMesh->texcoordBuffer, aMesh->indexBuffer };
+			glDeleteBuffers( 5, buffers );
+			glDeleteBuffers( 1, &aMesh->meshletBuffer );
+			delete aMesh;
+		} );
+	} );
+}
+
+ResourceRegistry::Texture ResourceRegistry::texture( char const* aPath )
+{
+	return get_( mTextures, aPath, [] (char const* aImagePath) {
+		return std::shared_ptr<GLuint const>( new GLuint( load_texture_asset( aImagePath ) ), [] (GLuint const* aTexture) {
+			gl_state::delete_texture( *aTexture );
+			delete aTexture;
+		} );
+	} );
+}
+
+void ResourceRegistry::prune()
+{
+	prune_( mMeshes.byPath );
+	prune_( mMeshes.bySize );
+	prune_( mTextures.byPath );
+	prune_( mTextures.bySize );
+}
+
+ResourceRegistry::Stats ResourceRegistry::stats() const
+{
+	Stats ret;
+	ret.requests = mRequests;
+	ret.loads = mLoads;
+	ret.liveMeshes = live_count_( mMeshes.bySize );
+	ret.liveTextures = live_count_( mTextures.bySize );
+	return ret;
+}
@@ -0,0 +1,90 @@
+#ifndef RESOURCES_HPP_8D13F6A2_5E07_4C9B_B241_7F0A3C9E6D58
+#define RESOURCES_HPP_8D13F6A2_5E07_4C9B_B241_7F0A3C9E6D58
+
+#include <glad.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "mesh.hpp"
+
+/* Resource registry
+ *
+ * Loads meshes and textures (with load_mesh_asset() and load_texture_asset())
+ * at most once. Resources are identified by their path and, to catch copies
+ * of a file under a different name, by their source file's contents. A new
+ * path only costs a file size query, unless a live resource's source file
+ * has the same size; only then are the contents of both hashed (and each
+ * file at most once).
+ *
+ * Handles are reference counted. The OpenGL objects are deleted when the
+ * last handle to them is released, so handles must not outlive the OpenGL
+ * context. The registry itself only holds weak references; requesting a
+ * resource whose handles have all been released loads it again.
+ *
+ * Streamed textures (AsyncTextureLoader) are not handled here, as their
+ * texture object changes while they stream.
+ */
+class ResourceRegistry final
+{
+	public:
+		using Mesh = std::shared_ptr<GpuMesh const>;
+		using Texture = std::shared_ptr<GLuint const>;
+
+		struct Stats
+		{
+			std::size_t requests = 0;
+			std::size_t loads = 0;     // requests that loaded a resource
+			std::size_t liveMeshes = 0;
+			std::size_t liveTextures = 0;
+		};
+
+	public:
+		ResourceRegistry() = default;
+
+		ResourceRegistry( ResourceRegistry const& ) = delete;
+		ResourceRegistry& operator= (ResourceRegistry const&) = delete;
+
+	public:
+		Mesh mesh( char const* aPath );
+		Texture texture( char const* aPath );
+
+		// Forgets entries whose resources have been released
+		void prune();
+
+		Stats stats() const;
+
+	private:
+		template< typename tResource >
+		struct Cache_
+		{
+			// One per loaded resource
+			struct Entry_
+			{
+				std::string path;
+				bool sized = false;    // the source file's size is known
+				bool hashed = false;   // hash is valid
+				std::uint64_t hash = 0;
+				std::weak_ptr<tResource> resource;
+			};
+
+			std::unordered_map<std::string, std::weak_ptr<tResource>> byPath;
+			std::unordered_multimap<std::uintmax_t, Entry_> bySize;
+		};
+
+		template< typename tResource, typename tLoad >
+		std::shared_ptr<tResource> get_( Cache_<tResource>&, char const* aPath, tLoad&& aLoad );
+
+	private:
+		Cache_<GpuMesh const> mMeshes;
+		Cache_<GLuint const> mTextures;
+
+		std::size_t mRequests = 0;
+		std::size_t mLoads = 0;
+};
+
+#endif // RESOURCES_HPP_8D13F6A2_5E07_4C9B_B241_7F0A3C9E6D58
@@ -0,0 +1,412 @@
+#include "scene_index.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	// Objects whose fat bounds have become this much larger (in surface
+	// area) than needed are reinserted with tighter bounds
+	constexpr float kMaxFatRatio_ = 4.f;
+}
+
+SceneIndex::SceneIndex( float aMargin )
+	: mMargin( aMargin )
+{}
+
+SceneIndex::Proxy SceneIndex::insert( Aabb const& aBounds, std::uint32_t aObject )
+{
+	std::int32_t const leaf = allocate_();
+	mNodes[leaf].bounds = aabb_inflate( aBounds, mMargin );
+	mNodes[leaf].object = aObject;
+	mNodes[leaf].height = 0;
+
+	insert_leaf_( leaf );
+	++mObjects;
+	return leaf;
+}
+
+void SceneIndex::remove( Proxy aProxy )
+{
+	assert( aProxy >= 0 && std::size_t(aProxy) < mNodes.size() && mNodes[aProxy].leaf() );
+
+	remove_leaf_( aProxy );
+	free_( aProxy );
+	--mObjects;
+}
+
+bool SceneIndex::move( Proxy aProxy, Aabb const& aBounds )
+{
+	assert( aProxy >= 0 && std::size_t(aProxy) < mNodes.size() && mNodes[aProxy].leaf() );
+
+	Aabb const fat = aabb_inflate( aBounds, mMargin );
+
+	Aabb const& current = mNodes[aProxy].bounds;
+	if( contains( current, aBounds ) && surface_area( current ) <= kMaxFatRatio_ * surface_area( fat ) )
+		return false;
+
+	remove_leaf_( aProxy );
+	mNodes[aProxy].bounds = fat;
+	insert_leaf_( aProxy );
+
+	++mReinserts;
+	return true;
+}
+
+std::uint32_t SceneIndex::object( Proxy aProxy ) const noexcept
+{
+	assert( aProxy >= 0 && std::size_t(aProxy) < mNodes.size() );
+	return mNodes[aProxy].object;
+}
+Aabb const& SceneIndex::fat_bounds( Proxy aProxy ) const noexcept
+{
+	assert( aProxy >= 0 && std::size_t(aProxy) < mNodes.size() );
+	return mNodes[aProxy].bounds;
+}
+
+void SceneIndex::query_frustum( Frustum const& aFrustum, std::vector<std::uint32_t>& aObjects ) const
+{
+	mStack.clear();
+	if( kNullProxy != mRoot )
+		mStack.push_back( { mRoot, false } );
+
+	while( !mStack.empty() )
+	{
+		StackEntry_ const entry = mStack.back();
+		mStack.pop_back();
+
+		Node_ const& node = mNodes[entry.node];
+		++mVisited;
+
+		// Everything below a node that is completely inside of the frustum
+		// is inside as well, and needs no further tests
+		bool inside = entry.inside;
+		if( !inside )
+		{
+			if( !intersects( aFrustum, node.bounds ) )
+				continue;
+
+			inside = contains( aFrustum, node.bounds );
+		}
+
+		if( node.leaf() )
+		{
+			aObjects.emplace_back( node.object );
+			continue;
+		}
+
+		mStack.push_back( { node.child[0], inside } );
+		mStack.push_back( { node.child[1], inside } );
+	}
+}
+
+void SceneIndex::query_sphere( Vec3f aCenter, float aRadius, std::vector<std::uint32_t>& aObjects ) const
+{
+	float const radiusSq = aRadius * aRadius;
+
+	mStack.clear();
+	if( kNullProxy != mRoot )
+		mStack.push_back( { mRoot, false } );
+
+	while( !mStack.empty() )
+	{
+		Node_ const& node = mNodes[mStack.back().node];
+		mStack.pop_back();
+		++mVisited;
+
+		if( distance_squared( node.bounds, aCenter ) > radiusSq )
+			continue;
+
+		if( node.leaf() )
+		{
+			aObjects.emplace_back( node.object );
+			continue;
+		}
+
+		mStack.push_back( { node.child[0], false } );
+		mStack.push_back( { node.child[1], false } );
+	}
+}
+
+bool SceneIndex::raycast( Vec3f aOrigin, Vec3f aDir, float aMaxDistance, RayHit& aHit ) const
+{
+	return raycast( aOrigin, aDir, aMaxDistance, [] (std::uint32_t, float aBoundsDistance) {
+		return aBoundsDistance;
+	}, aHit );
+}
+
+SceneIndex::Stats SceneIndex::stats() const noexcept
+{
+	Stats ret;
+	ret.objects = mObjects;
+	ret.height = kNullProxy != mRoot ? std::size_t(mNodes[mRoot].height) : 0;
+	ret.nodesVisited = mVisited;
+	ret.reinserts = mReinserts;
+	return ret;
+}
+void SceneIndex::reset_stats() noexcept
+{
+	mVisited = 0;
+	mReinserts = 0;
+}
+
+bool SceneIndex::valid() const
+{
+	auto const same_ = [] (Aabb const& aLeft, Aabb const& aRight) {
+		return aLeft.min.x == aRight.min.x && aLeft.min.y == aRight.min.y && aLeft.min.z == aRight.min.z
+			&& aLeft.max.x == aRight.max.x && aLeft.max.y == aRight.max.y && aLeft.max.z == aRight.max.z;
+	};
+
+	if( kNullProxy != mRoot && kNullProxy != mNodes[mRoot].parent )
+		return false;
+
+	std::size_t nodes = 0, leaves = 0;
+
+	std::vector<std::int32_t> stack;
+	if( kNullProxy != mRoot )
+		stack.push_back( mRoot );
+
+	while( !stack.empty() )
+	{
+		std::int32_t const index = stack.back();
+		stack.pop_back();
+
+		// More nodes than allocated: there is a cycle
+		if( ++nodes > mNodes.size() )
+			return false;
+
+		Node_ const& node = mNodes[index];
+		if( node.leaf() )
+		{
+			if( 0 != node.height || kNullProxy != node.child[1] )
+				return false;
+
+			++leaves;
+			continue;
+		}
+
+		for( auto const child : node.child )
+		{
+			if( child < 0 || std::size_t(child) >= mNodes.size() || mNodes[child].parent != index )
+				return false;
+		}
+
+		Node_ const& a = mNodes[node.child[0]];
+		Node_ const& b = mNodes[node.child[1]];
+		if( node.height != 1 + std::max( a.height, b.height ) || !same_( node.bounds, aabb_union( a.bounds, b.bounds ) ) )
+			return false;
+
+		stack.push_back( node.child[0] );
+		stack.push_back( node.child[1] );
+	}
+
+	if( leaves != mObjects )
+		return false;
+
+	// Every other node is free
+	std::size_t free = 0;
+	for( std::int32_t index = mFree; kNullProxy != index; index = mNodes[index].parent )
+	{
+		if( ++free > mNodes.size() || -1 != mNodes[index].height )
+			return false;
+	}
+
+	return nodes + free == mNodes.size();
+}
+
+std::int32_t SceneIndex::allocate_()
+{
+	if( kNullProxy == mFree )
+	{
+		mNodes.emplace_back();
+		mFree = std::int32_t(mNodes.size()-1);
+		mNodes[mFree].parent = kNullProxy;
+		mNodes[mFree].height = -1;
+	}
+
+	std::int32_t const index = mFree;
+	Node_& node = mNodes[index];
+	mFree = node.parent;
+
+	node.parent = kNullProxy;
+	node.child[0] = node.child[1] = kNullProxy;
+	node.height = 0;
+	return index;
+}
+
+void SceneIndex::free_( std::int32_t aIndex )
+{
+	mNodes[aIndex].parent = mFree;
+	mNodes[aIndex].height = -1;
+	mFree = aIndex;
+}
+
+void SceneIndex::insert_leaf_( std::int32_t aLeaf )
+{
+	if( kNullProxy == mRoot )
+	{
+		mRoot = aLeaf;
+		mNodes[aLeaf].parent = kNullProxy;
+		return;
+	}
+
+	// Find the best sibling: descend while the cost of pairing with the
+	// current node (the area of the new parent, plus the growth of all the
+	// ancestors) is larger than the lower bound of pairing further down
+	Aabb const bounds = mNodes[aLeaf].bounds;
+
+	std::int32_t index = mRoot;
+	while( !mNodes[index].leaf() )
+	{
+		Node_ const& node = mNodes[index];
+
+		float const area = surface_area( node.bounds );
+		float const combined = surface_area( aabb_union( node.bounds, bounds ) );
+
+		float const cost = 2.f * combined;
+		float const inheritance = 2.f * (combined - area);
+
+		float childCost[2];
+		for( int c = 0; c < 2; ++c )
+		{
+			Node_ const& child = mNodes[node.child[c]];
+			float const grown = surface_area( aabb_union( child.bounds, bounds ) );
+			childCost[c] = (child.leaf() ? grown : grown - surface_area( child.bounds )) + inheritance;
+		}
+
+		if( cost < childCost[0] && cost < childCost[1] )
+			break;
+
+		index = childCost[0] < childCost[1] ? node.child[0] : node.child[1];
+	}
+
+	// Replace the sibling with a new parent of the sibling and the leaf
+	std::int32_t const sibling = index;
+	std::int32_t const oldParent = mNodes[sibling].parent;
+	std::int32_t const newParent = allocate_();
+
+	Node_& parent = mNodes[newParent];
+	parent.parent = oldParent;
+	parent.bounds = aabb_union( bounds, mNodes[sibling].bounds );
+	parent.height = mNodes[sibling].height + 1;
+	parent.child[0] = sibling;
+	parent.child[1] = aLeaf;
+
+	mNodes[sibling].parent = newParent;
+	mNodes[aLeaf].parent = newParent;
+
+	if( kNullProxy == oldParent )
+		mRoot = newParent;
+	else
+	{
+		Node_& old = mNodes[oldParent];
+		old.child[old.child[0] == sibling ? 0 : 1] = newParent;
+	}
+
+	refit_( mNodes[aLeaf].parent );
+}
+
+void SceneIndex::remove_leaf_( std::int32_t aLeaf )
+{
+	if( aLeaf == mRoot )
+	{
+		mRoot = kNullProxy;
+		return;
+	}
+
+	// Replace the parent with the sibling
+	std::int32_t const parent = mNodes[aLeaf].parent;
+	std::int32_t const grandParent = mNodes[parent].parent;
+	std::int32_t const sibling = mNodes[parent].child[mNodes[parent].child[0] == aLeaf ? 1 : 0];
+
+	mNodes[sibling].parent = grandParent;
+	free_( parent );
+
+	if( kNullProxy == grandParent )
+	{
+		mRoot = sibling;
+		return;
+	}
+
+	Node_& grand = mNodes[grandParent];
+	grand.child[grand.child[0] == parent ? 0 : 1] = sibling;
+
+	refit_( grandParent );
+}
+
+void SceneIndex::refit_( std::int32_t aIndex )
+{
+	// Rebalance, and update the bounds and heights, up to the root
+	for( std::int32_t index = aIndex; kNullProxy != index; )
+	{
+		index = balance_( index );
+
+		Node_& node = mNodes[index];
+		Node_ const& a = mNodes[node.child[0]];
+		Node_ const& b = mNodes[node.child[1]];
+
+		node.bounds = aabb_union( a.bounds, b.bounds );
+		node.height = 1 + std::max( a.height, b.height );
+
+		index = node.parent;
+	}
+}
+
+std::int32_t SceneIndex::balance_( std::int32_t aIndex )
+{
+	/* If one subtree of A is more than one level taller than the other, that
+	 * subtree's root (C) is rotated up to take A's place:
+	 *
+	 *       A              C
+	 *      / \            / \
+	 *     B   C    ->    A   F
+	 *        / \        / \
+	 *       F   G      B   G
+	 *
+	 * where F is the taller child of C, which stays with it.
+	 */
+	Node_& a = mNodes[aIndex];
+	if( a.leaf() || a.height < 2 )
+		return aIndex;
+
+	int const tall = mNodes[a.child[1]].height > mNodes[a.child[0]].height ? 1 : 0;
+	std::int32_t const iB = a.child[1-tall];
+	std::int32_t const iC = a.child[tall];
+
+	int const balance = mNodes[iC].height - mNodes[iB].height;
+	if( balance <= 1 )
+		return aIndex;
+
+	Node_& b = mNodes[iB];
+	Node_& c = mNodes[iC];
+
+	int const cTall = mNodes[c.child[1]].height > mNodes[c.child[0]].height ? 1 : 0;
+	std::int32_t const iF = c.child[cTall];
+	std::int32_t const iG = c.child[1-cTall];
+
+	// C takes A's place
+	c.parent = a.parent;
+	if( kNullProxy == c.parent )
+		mRoot = iC;
+	else
+	{
+		Node_& p = mNodes[c.parent];
+		p.child[p.child[0] == aIndex ? 0 : 1] = iC;
+	}
+
+	// A becomes C's child, in place of G; G replaces C under A
+	c.child[1-cTall] = aIndex;
+	a.parent = iC;
+
+	a.child[tall] = iG;
+	mNodes[iG].parent = aIndex;
+
+	a.bounds = aabb_union( b.bounds, mNodes[iG].bounds );
+	a.height = 1 + std::max( b.height, mNodes[iG].height );
+
+	c.bounds = aabb_union( a.bounds, mNodes[iF].bounds );
+	c.height = 1 + std::max( a.height, mNodes[iF].height );
+
+	return iC;
+}
@@ -0,0 +1,175 @@
+#ifndef SCENE_INDEX_HPP_62D0B7F9_1E3A_4C58_9A47_C5F81E24D093
+#define SCENE_INDEX_HPP_62D0B7F9_1E3A_4C58_9A47_C5F81E24D093
+
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/frustum.hpp"
+
+/* Spatial index of the scene objects
+ *
+ * A dynamic bounding volume hierarchy (BVH): a binary tree, with one leaf
+ * per object and the bounds of its children in each inner node. Queries
+ * (frustum, ray, sphere) skip whole subtrees whose bounds miss, so they stay
+ * roughly logarithmic in the number of objects.
+ *
+ * Objects are inserted where they enlarge the tree's bounds the least
+ * (surface area heuristic), and the tree is kept balanced with AVL-style
+ * rotations (as in Box2D's b2DynamicTree). Leaves store "fat" bounds, the
+ * object's bounds grown by a margin, so objects that move a little do not
+ * change the tree at all. An object that leaves its fat bounds is removed
+ * and reinserted, which refits and rebalances the nodes above it.
+ *
+ * The index stores a 32-bit value per object; what it means is up to the
+ * user (e.g., an index into an array of objects). Queries use scratch space
+ * of the index, so concurrent queries are not possible.
+ */
+class SceneIndex final
+{
+	public:
+		using Proxy = std::int32_t;
+		static constexpr Proxy kNullProxy = -1;
+
+		struct RayHit
+		{
+			std::uint32_t object;
+			float distance; // in units of the ray direction's length
+		};
+
+		struct Stats
+		{
+			std::size_t objects = 0;
+			std::size_t height = 0;       // of the tree; zero if at most one object
+			std::size_t nodesVisited = 0; // by queries, since reset_stats()
+			std::size_t reinserts = 0;    // by move(), since reset_stats()
+		};
+
+	public:
+		explicit SceneIndex( float aMargin = 0.5f );
+
+		SceneIndex( SceneIndex const& ) = delete;
+		SceneIndex& operator= (SceneIndex const&) = delete;
+
+	public:
+		Proxy insert( Aabb const& aBounds, std::uint32_t aObject );
+		void remove( Proxy );
+
+		// Updates the bounds of a moved object. Returns true if the object
+		// had to be reinserted, i.e. if the tree changed.
+		bool move( Proxy, Aabb const& aBounds );
+
+		std::uint32_t object( Proxy ) const noexcept;
+		Aabb const& fat_bounds( Proxy ) const noexcept;
+
+		// Append the objects whose (fat) bounds overlap the frustum or the
+		// sphere to aObjects
+		void query_frustum( Frustum const&, std::vector<std::uint32_t>& aObjects ) const;
+		void query_sphere( Vec3f aCenter, float aRadius, std::vector<std::uint32_t>& aObjects ) const;
+
+		// Closest object along the ray, up to aMaxDistance. aHitTest( object,
+		// boundsDistance ) is called for objects whose bounds the ray enters
+		// before the closest hit so far, and returns the distance of the hit
+		// with the object itself, or a negative value for a miss.
+		template< typename tHitTest >
+		bool raycast( Vec3f aOrigin, Vec3f aDir, float aMaxDistance, tHitTest&& aHitTest, RayHit& aHit ) const;
+
+		// Closest object whose (fat) bounds the ray enters
+		bool raycast( Vec3f aOrigin, Vec3f aDir, float aMaxDistance, RayHit& aHit ) const;
+
+		Stats stats() const noexcept;
+		void reset_stats() noexcept;
+
+		// Checks the structure of the tree: parent/child links, bounds and
+		// heights of the inner nodes, the number of leaves, and the free
+		// list. For tests.
+		bool valid() const;
+
+	private:
+		struct Node_
+		{
+			Aabb bounds;
+			std::uint32_t object;
+			std::int32_t parent;   // or next free node
+			std::int32_t child[2]; // kNullProxy in leaves
+			std::int32_t height;   // 0 in leaves, -1 in free nodes
+
+			bool leaf() const noexcept { return child[0] == kNullProxy; }
+		};
+
+		std::int32_t allocate_();
+		void free_( std::int32_t );
+
+		void insert_leaf_( std::int32_t );
+		void remove_leaf_( std::int32_t );
+
+		std::int32_t balance_( std::int32_t );
+		void refit_( std::int32_t );
+
+	private:
+		float mMargin;
+
+		std::vector<Node_> mNodes;
+		std::int32_t mRoot = kNullProxy;
+		std::int32_t mFree = kNullProxy;
+
+		std::size_t mObjects = 0;
+		std::size_t mReinserts = 0;
+
+		// Query scratch
+		struct StackEntry_
+		{
+			std::int32_t node;
+			bool inside; // all of the node is inside of the query volume
+		};
+		mutable std::vector<StackEntry_> mStack;
+		mutable std::size_t mVisited = 0;
+};
+
+template< typename tHitTest >
+bool SceneIndex::raycast( Vec3f aOrigin, Vec3f aDir, float aMaxDistance, tHitTest&& aHitTest, RayHit& aHit ) const
+{
+	Vec3f const invDir{ 1.f / aDir.x, 1.f / aDir.y, 1.f / aDir.z };
+
+	bool found = false;
+	float maxT = aMaxDistance;
+
+	mStack.clear();
+	if( kNullProxy != mRoot )
+		mStack.push_back( { mRoot, false } );
+
+	while( !mStack.empty() )
+	{
+		std::int32_t const index = mStack.back().node;
+		mStack.pop_back();
+
+		Node_ const& node = mNodes[index];
+		++mVisited;
+
+		float const boundsT = intersect_ray( node.bounds, aOrigin, invDir, maxT );
+		if( boundsT < 0.f )
+			continue;
+
+		if( !node.leaf() )
+		{
+			mStack.push_back( { node.child[0], false } );
+			mStack.push_back( { node.child[1], false } );
+			continue;
+		}
+
+		float const t = aHitTest( node.object, boundsT );
+		if( t >= 0.f && t <= maxT )
+		{
+			found = true;
+			maxT = t;
+			aHit = RayHit{ node.object, t };
+		}
+	}
+
+	return found;
+}
+
+#endif // SCENE_INDEX_HPP_62D0B7F9_1E3A_4C58_9A47_C5F81E24D093
@@ -0,0 +1,115 @@
+// Generated by shader-bindgen from the shaders in assets/. Do not edit.
+// Rebuild (or run shader-bindgen) after changing a shader's interface.
+#ifndef SHADER_BINDINGS_HPP_GENERATED
+#define SHADER_BINDINGS_HPP_GENERATED
+
+#include <glad.h>
+
+#include "../support/program.hpp"
+
+namespace shader_bindings
+{
+	// assets/blocks.glsl
+	namespace blocks_glsl
+	{
+		constexpr GLuint FrameBlock = 0; // uniform block binding
+		constexpr GLuint ViewBlock = 1; // uniform block binding
+	}
+
+	// assets/clusters.glsl
+	namespace clusters_glsl
+	{
+		constexpr GLuint PointLights = 0; // shader storage block binding
+		constexpr GLuint ClusterRanges = 1; // shader storage block binding
+		constexpr GLuint ClusterLightIndices = 2; // shader storage block binding
+	}
+
+	// assets/cull.comp
+	namespace cull_comp
+	{
+		constexpr GLuint DrawCommands = 4; // shader storage block binding
+		constexpr GLuint VisibleInstances = 5; // shader storage block binding
+		constexpr ShaderProgram::Location<int> uInstanceCount{ 0 };
+		constexpr ShaderProgram::Location<float> uPixelsPerUnit{ 1 };
+		constexpr ShaderProgram::Location<Vec4f> uLodErrors{ 2 };
+		constexpr GLuint uHiZ = 4; // sampler2D, texture unit
+		constexpr ShaderProgram::Location<int> uHiZLevels{ 3 };
+	}
+
+	// assets/default.frag
+	namespace default_frag
+	{
+		constexpr ShaderProgram::Location<float> uShininess{ 7 };
+		constexpr GLuint uTexture = 0; // sampler2D, texture unit
+	}
+
+	// assets/default.vert
+	namespace default_vert
+	{
+		constexpr GLuint iPosition = 0; // vec3, vertex attribute
+		constexpr GLuint iColor = 1; // vec3, vertex attribute
+		constexpr GLuint iNormal = 2; // vec3, vertex attribute
+		constexpr GLuint iTexCoord = 3; // vec2, vertex attribute
+		constexpr GLuint iInstance = 4; // uint, vertex attribute
+		constexpr ShaderProgram::Location<Mat33f> uNormalMatrix{ 1 };
+		constexpr ShaderProgram::Location<Mat44f> uModelWorld{ 13 };
+	}
+
+	// assets/deferred.frag
+	namespace deferred_frag
+	{
+		constexpr ShaderProgram::Location<float> uShininess{ 7 };
+		constexpr GLuint uGBufferAlbedo = 1; // sampler2D, texture unit
+		constexpr GLuint uGBufferNormal = 2; // sampler2D, texture unit
+		constexpr GLuint uGBufferDepth = 3; // sampler2D, texture unit
+	}
+
+	// assets/depth.vert
+	namespace depth_vert
+	{
+		constexpr GLuint iPosition = 0; // vec3, vertex attribute
+		constexpr ShaderProgram::Location<Mat44f> uModelWorld{ 13 };
+	}
+
+	// assets/gbuffer.frag
+	namespace gbuffer_frag
+	{
+		constexpr GLuint uTexture = 0; // sampler2D, texture unit
+	}
+
+	// assets/hiz.comp
+	namespace hiz_comp
+	{
+		constexpr GLuint uSource = 4; // sampler2D, texture unit
+		constexpr GLuint uTarget = 0; // image2D, image unit
+		constexpr ShaderProgram::Location<int> uSourceLevel{ 0 };
+	}
+
+	// assets/instances.glsl
+	namespace instances_glsl
+	{
+		constexpr GLuint Instances = 3; // shader storage block binding
+	}
+
+	// assets/meshlets.comp
+	namespace meshlets_comp
+	{
+		constexpr GLuint Meshlets = 6; // shader storage block binding
+		constexpr GLuint MeshletCommands = 7; // shader storage block binding
+		constexpr ShaderProgram::Location<Mat44f> uModelWorld{ 0 };
+		constexpr ShaderProgram::Location<int> uMeshletCount{ 1 };
+	}
+
+	// assets/terrain.vert
+	namespace terrain_vert
+	{
+		constexpr GLuint iGrid = 0; // vec2, vertex attribute
+		constexpr GLuint iNode = 1; // vec4, vertex attribute
+		constexpr GLuint TerrainBlock = 2; // uniform block binding
+		constexpr GLuint uHeightmap = 5; // sampler2D, texture unit
+		constexpr GLuint uTexCoordMap = 6; // sampler2D, texture unit
+		constexpr ShaderProgram::Location<Mat44f> uModelWorld{ 13 };
+	}
+}
+
+#endif // SHADER_BINDINGS_HPP_GENERATED
@@ -1,10 +1,46 @@
 #include "texture.hpp"
 
 #include <cassert>
+#include <cstdint>
 
 #include <stb_image.h>
 
 #include "../support/error.hpp"
+#include "../support/cooked.hpp"
+#include "../support/gl_extensions.hpp"
+
+namespace
+{
+	// From EXT_texture_compression_s3tc/EXT_texture_sRGB. The GLAD loader
+	// was not generated with these extensions.
+	constexpr GLenum kCompressedSrgbS3tcDxt1_ = 0x8C4C;
+	constexpr GLenum kCompressedSrgbAlphaS3tcDxt5_ = 0x8C4F;
+
+	bool has_srgb_s3tc_()
+	{
+		static bool const supported = has_gl_extension("GL_EXT_texture_compression_s3tc")
+			&& (has_gl_extension("GL_EXT_texture_sRGB") || has_gl_extension("GL_EXT_texture_compression_s3tc_srgb"));
+		return supported;
+	}
+}
+
+GLenum cooked_texture_internal_format(CookedTextureFormat aFormat, char const* aPath)
+{
+	switch (aFormat)
+	{
+		case CookedTextureFormat::rgba8srgb:
+			return GL_SRGB8_ALPHA8;
+		case CookedTextureFormat::bc1srgb:
+		case CookedTextureFormat::bc3srgb:
+			if (!has_srgb_s3tc_())
+				throw Error("Cooked texture '%s' uses S3TC, which is not supported here", aPath);
+			return CookedTextureFormat::bc1srgb == aFormat ? kCompressedSrgbS3tcDxt1_ : kCompressedSrgbAlphaS3tcDxt5_;
+		case CookedTextureFormat::bc7srgb:
+			return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; // core since 4.2
+	}
+
+	throw Error("Cooked texture '%s' has unsupported format %u", aPath, unsigned(aFormat));
+}
 
 GLuint load_texture_2d(char const* aPath)
 {
@@ -40,3 +76,48 @@ GLuint load_texture_2d(char const* aPath)
 	return tex;
 }
 
+
+GLuint load_cooked_texture_2d(char const* aPath)
+{
+	assert(aPath);
+	// The cooked file contains the full, precomputed mip chain, so there is
+	// no decoding and no glGenerateMipmap() here. Block compressed levels
+	// are uploaded as they are.
+	auto const cooked = read_cooked_texture(aPath);
+	auto const& header = *cooked.header;
+
+	GLenum const internalFormat = cooked_texture_internal_format(header.format, aPath);
+	bool const compressed = 0 != cooked_block_bytes(header.format);
+
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (std::uint32_t i = 0; i < header.levelCount; ++i)
+	{
+		auto const& level = header.levels[i];
+		if (compressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, GLint(i), internalFormat, GLsizei(level.width), GLsizei(level.height), 0, GLsizei(level.size), cooked.level_data(i));
+		else
+			glTexImage2D(GL_TEXTURE_2D, GLint(i), internalFormat, GLsizei(level.width), GLsizei(level.height), 0, GL_RGBA, GL_UNSIGNED_BYTE, cooked.level_data(i));
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	configure_texture_2d(GLint(header.levelCount-1));
+	return tex;
+}
+
+void configure_texture_2d(GLint aMaxLevel)
+{
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, aMaxLevel);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, 6.f);
+}
@@ -3,6 +3,19 @@
 
 #include <glad.h>
 
+#include "../support/cooked.hpp"
+
 GLuint load_texture_2d( char const* aPath );
 
+// Loads a texture produced by the asset-cooker (see support/cooked.hpp)
+GLuint load_cooked_texture_2d( char const* aPath );
+
+// OpenGL internal format for a cooked texture format. Throws if the format
+// is not supported by the current context.
+GLenum cooked_texture_internal_format( CookedTextureFormat, char const* aPath );
+
+// Filtering and wrapping setup shared by the texture loaders. Applies to the
+// texture currently bound to GL_TEXTURE_2D.
+void configure_texture_2d( GLint aMaxLevel );
+
 #endif // TEXTURE_HPP_D0746DED_C9C6_40CD_B6E0_C6FEF665DD31
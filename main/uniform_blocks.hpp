@@ -0,0 +1,52 @@
+#ifndef UNIFORM_BLOCKS_HPP_E07B4D29_3A61_4F8C_9D25_B6C1F8A4730E
+#define UNIFORM_BLOCKS_HPP_E07B4D29_3A61_4F8C_9D25_B6C1F8A4730E
+
+#include <glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "shader_bindings.hpp"
+
+// C++ mirrors of the std140 uniform blocks in assets/blocks.glsl.
+// vec3 members are padded to vec4. Matrices are declared row_major in the
+// shaders, which matches Mat44f.
+
+constexpr GLuint kFrameBlockBinding = shader_bindings::blocks_glsl::FrameBlock;
+constexpr GLuint kViewBlockBinding = shader_bindings::blocks_glsl::ViewBlock;
+
+// Updated once per frame
+struct FrameBlock
+{
+	Vec4f lightDir;       // xyz: direction towards the sun
+	Vec4f lightDiffuse;
+	Vec4f sceneAmbient;
+};
+
+// Updated once per view
+struct ViewBlock
+{
+	Mat44f projCamera;    // projection * world2camera
+	Vec4f cameraPos;
+	Vec4f viewport;               // xy: origin, zw: size, in pixels
+
+	// Light clusters; see ClusteredLights::build()
+	std::uint32_t clusterGrid[4]; // xyz: number of clusters
+	Vec4f clusterDepth;           // near, far, depth slice scale and bias
+
+	Mat44f invProjCamera;
+
+	Vec4f frustumPlanes[6];       // see Frustum
+};
+
+static_assert( sizeof(FrameBlock) == 48 );
+static_assert( offsetof(ViewBlock, cameraPos) == 64 );
+static_assert( offsetof(ViewBlock, clusterGrid) == 96 );
+static_assert( offsetof(ViewBlock, invProjCamera) == 128 );
+static_assert( offsetof(ViewBlock, frustumPlanes) == 192 );
+static_assert( sizeof(ViewBlock) == 288 );
+
+#endif // UNIFORM_BLOCKS_HPP_E07B4D29_3A61_4F8C_9D25_B6C1F8A4730E
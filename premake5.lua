@@ -93,6 +93,16 @@ project "main"
 
 	files( sources )
 
+	-- Regenerate main/shader_bindings.hpp from the shaders (see
+	-- shader-bindgen/main.cpp). Runs in the project directory.
+	dependson "shader-bindgen"
+
+	filter "system:windows"
+		prebuildcommands { "..\\bin\\shader-bindgen%{cfg.buildtarget.suffix}.exe ..\\assets shader_bindings.hpp" }
+	filter "not system:windows"
+		prebuildcommands { "../bin/shader-bindgen%{cfg.buildtarget.suffix}.exe ../assets shader_bindings.hpp" }
+	filter "*"
+
 project "main-shaders"
 	local shaders = { 
 		"assets/*.vert",
@@ -100,7 +110,8 @@ project "main-shaders"
 		"assets/*.geom",
 		"assets/*.tesc",
 		"assets/*.tese",
-		"assets/*.comp"
+		"assets/*.comp",
+		"assets/*.glsl" -- #include'd by the above
 	}
 
 	kind "Utility"
@@ -108,6 +119,36 @@ project "main-shaders"
 
 	files( shaders )
 
+project "asset-cooker"
+	local sources = { 
+		"asset-cooker/**.cpp",
+		"asset-cooker/**.hpp",
+		"asset-cooker/**.hxx",
+		"asset-cooker/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "asset-cooker"
+
+	files( sources )
+
+	links "support"
+
+	links "x-stb"
+
+project "shader-bindgen"
+	local sources = { 
+		"shader-bindgen/**.cpp",
+		"shader-bindgen/**.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "shader-bindgen"
+
+	files( sources )
+
+	links "support"
+
 project "support"
 	local sources = { 
 		"support/**.cpp",
@@ -152,4 +193,7 @@ project "vmlib-test"
 
 	files( sources )
 
+	-- Renderer code that does not depend on OpenGL, tested along with vmlib
+	files( "main/scene_index.cpp" )
+
 --EOF
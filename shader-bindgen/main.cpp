@@ -0,0 +1,426 @@
+#include <string>
+#include <vector>
+#include <typeinfo>
+#include <limits>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <string_view>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/cooked.hpp"
+
+namespace fs = std::filesystem;
+
+/* Shader binding generator
+ *
+ * Scans the shaders in the asset directory for declarations with explicit
+ * layout qualifiers, and writes a C++ header with their locations and
+ * bindings as constants (see support/program.hpp for ShaderProgram::Location).
+ * The C++ code uses these instead of repeating the numbers; if a shader's
+ * interface changes, the C++ code stops compiling instead of silently using
+ * a stale location.
+ *
+ * Usage: shader-bindgen [ASSET_DIR] [OUTPUT]
+ *
+ * The output is only rewritten if its contents changed, so that it does not
+ * trigger rebuilds needlessly. This runs as a pre-build step of main.
+ *
+ * The following is recognized, regardless of any surrounding #if:
+ *
+ *   layout(... location = N ...) uniform TYPE NAME;    -> Location<T>
+ *   layout(... binding = N ...) uniform SAMPLER NAME;  -> texture unit
+ *   layout(... binding = N ...) uniform IMAGE NAME;    -> image unit
+ *   layout(... binding = N ...) uniform BLOCK { ... }  -> block binding
+ *   layout(... binding = N ...) buffer BLOCK { ... }   -> SSBO binding
+ *   layout(... location = N ...) in TYPE NAME;         -> vertex attribute
+ *
+ * Qualifiers such as readonly may come between the layout and the storage
+ * qualifier. (Vertex attributes are only listed for vertex shaders.)
+ */
+
+namespace
+{
+	enum class Kind_
+	{
+		uniform,
+		sampler,
+		uniformBlock,
+		storageBlock,
+		attribute
+	};
+
+	struct Declaration_
+	{
+		Kind_ kind;
+		std::string type;
+		std::string name;
+		int index;
+		std::size_t line;
+	};
+
+	struct Shader_
+	{
+		std::string file;
+		std::vector<Declaration_> declarations;
+	};
+
+	std::string read_text_( fs::path const& aPath )
+	{
+		auto const bytes = read_file_bytes( aPath.string().c_str() );
+		return std::string( bytes.begin(), bytes.end() );
+	}
+
+	// Replaces comments and preprocessor lines with spaces, keeping newlines
+	// so that line numbers stay intact.
+	std::string strip_( std::string aText )
+	{
+		bool lineStart = true;
+		for( std::size_t i = 0; i < aText.size(); ++i )
+		{
+			char const c = aText[i];
+			char const next = i+1 < aText.size() ? aText[i+1] : '\0';
+
+			if( '/' == c && '/' == next )
+			{
+				for( ; i < aText.size() && '\n' != aText[i]; ++i )
+					aText[i] = ' ';
+				lineStart = true;
+			}
+			else if( '/' == c && '*' == next )
+			{
+				for( ; i < aText.size() && !('*' == aText[i] && i+1 < aText.size() && '/' == aText[i+1]); ++i )
+				{
+					if( '\n' != aText[i] )
+						aText[i] = ' ';
+				}
+				if( i+1 < aText.size() )
+					aText[i] = aText[i+1] = ' ';
+				++i;
+			}
+			else if( '#' == c && lineStart )
+			{
+				for( ; i < aText.size() && '\n' != aText[i]; ++i )
+					aText[i] = ' ';
+				lineStart = true;
+			}
+			else if( '\n' == c )
+				lineStart = true;
+			else if( !std::isspace( static_cast<unsigned char>(c) ) )
+				lineStart = false;
+		}
+
+		return aText;
+	}
+
+	// Minimal tokenizer: identifiers/numbers and single punctuation chars
+	struct Token_
+	{
+		std::string text;
+		std::size_t line;
+	};
+
+	std::vector<Token_> tokenize_( std::string const& aText )
+	{
+		std::vector<Token_> tokens;
+
+		std::size_t line = 1;
+		for( std::size_t i = 0; i < aText.size(); )
+		{
+			auto const c = static_cast<unsigned char>(aText[i]);
+			if( '\n' == c )
+			{
+				++line;
+				++i;
+			}
+			else if( std::isspace( c ) )
+				++i;
+			else if( std::isalnum( c ) || '_' == c )
+			{
+				std::size_t j = i;
+				while( j < aText.size() && (std::isalnum( static_cast<unsigned char>(aText[j]) ) || '_' == aText[j]) )
+					++j;
+				tokens.emplace_back( Token_{ aText.substr( i, j-i ), line } );
+				i = j;
+			}
+			else
+			{
+				tokens.emplace_back( Token_{ std::string( 1, char(c) ), line } );
+				++i;
+			}
+		}
+
+		return tokens;
+	}
+
+	// Returns the value of "aKey = N" in the layout qualifiers, or -1. Throws
+	// Error if N is not a non-negative integer literal.
+	int qualifier_( std::vector<Token_> const& aTokens, std::size_t aBegin, std::size_t aEnd, char const* aKey, std::string const& aFile )
+	{
+		for( std::size_t i = aBegin; i+2 < aEnd; ++i )
+		{
+			if( aKey != aTokens[i].text || "=" != aTokens[i+1].text )
+				continue;
+
+			auto const& token = aTokens[i+2];
+			char const* const begin = token.text.c_str();
+
+			// Decimal, octal or hexadecimal, with an optional unsigned suffix
+			errno = 0;
+			char* end = nullptr;
+			long const value = std::strtol( begin, &end, 0 );
+			if( end != begin && ('u' == *end || 'U' == *end) )
+				++end;
+
+			if( end == begin || '\0' != *end || ERANGE == errno || value < 0 || value > std::numeric_limits<int>::max() )
+				throw Error( "%s(%zu): %s = '%s' is not a supported value (expected an integer literal)", aFile.c_str(), token.line, aKey, begin );
+
+			return int(value);
+		}
+		return -1;
+	}
+
+	bool is_qualifier_( std::string const& aToken )
+	{
+		static char const* const kQualifiers[] = {
+			"readonly", "writeonly", "coherent", "volatile", "restrict",
+			"flat", "smooth", "noperspective", "centroid", "sample", "patch",
+			"invariant", "precise", "lowp", "mediump", "highp"
+		};
+		for( auto const* qualifier : kQualifiers )
+		{
+			if( aToken == qualifier )
+				return true;
+		}
+		return false;
+	}
+
+	bool is_sampler_( std::string const& aType )
+	{
+		return std::string::npos != aType.find( "sampler" ) || std::string::npos != aType.find( "image" );
+	}
+
+	Shader_ parse_( fs::path const& aPath )
+	{
+		Shader_ shader;
+		shader.file = aPath.filename().string();
+
+		bool const isVertex = ".vert" == aPath.extension();
+
+		auto const tokens = tokenize_( strip_( read_text_( aPath ) ) );
+		for( std::size_t i = 0; i < tokens.size(); ++i )
+		{
+			if( "layout" != tokens[i].text || i+1 >= tokens.size() || "(" != tokens[i+1].text )
+				continue;
+
+			std::size_t const qualBegin = i+2;
+			std::size_t qualEnd = qualBegin;
+			while( qualEnd < tokens.size() && ")" != tokens[qualEnd].text )
+				++qualEnd;
+
+			// layout(...) STORAGE TYPE NAME or layout(...) STORAGE BLOCK {
+			// Memory and interpolation qualifiers may come before STORAGE.
+			std::size_t j = qualEnd+1;
+			while( j < tokens.size() && is_qualifier_( tokens[j].text ) )
+				++j;
+			if( j+2 >= tokens.size() )
+				break;
+
+			auto const& storage = tokens[j].text;
+			auto const& type = tokens[j+1].text;
+			auto const& name = tokens[j+2].text;
+
+			int const location = qualifier_( tokens, qualBegin, qualEnd, "location", shader.file );
+			int const binding = qualifier_( tokens, qualBegin, qualEnd, "binding", shader.file );
+
+			Declaration_ decl{};
+			decl.line = tokens[i].line;
+
+			if( "uniform" == storage && "{" == name && binding >= 0 )
+				decl = { Kind_::uniformBlock, "", type, binding, decl.line };
+			else if( "buffer" == storage && "{" == name && binding >= 0 )
+				decl = { Kind_::storageBlock, "", type, binding, decl.line };
+			else if( "uniform" == storage && is_sampler_( type ) && binding >= 0 )
+				decl = { Kind_::sampler, type, name, binding, decl.line };
+			else if( "uniform" == storage && location >= 0 )
+				decl = { Kind_::uniform, type, name, location, decl.line };
+			else if( "in" == storage && isVertex && location >= 0 )
+				decl = { Kind_::attribute, type, name, location, decl.line };
+			else
+				continue;
+
+			// The same declaration may appear in several #if branches
+			auto const same = [&decl] (Declaration_ const& aOther) {
+				return aOther.kind == decl.kind && aOther.name == decl.name;
+			};
+			auto const it = std::find_if( shader.declarations.begin(), shader.declarations.end(), same );
+			if( shader.declarations.end() == it )
+				shader.declarations.emplace_back( std::move(decl) );
+			else if( it->index != decl.index || it->type != decl.type )
+				throw Error( "%s(%zu): '%s' redeclared differently (see line %zu)", shader.file.c_str(), decl.line, decl.name.c_str(), it->line );
+
+			i = j+2;
+		}
+
+		return shader;
+	}
+
+	char const* cpp_type_( std::string const& aGlslType )
+	{
+		static char const* const kTypes[][2] = {
+			{ "bool", "bool" },
+			{ "int", "int" },
+			{ "float", "float" },
+			{ "vec2", "Vec2f" },
+			{ "vec3", "Vec3f" },
+			{ "vec4", "Vec4f" },
+			{ "mat3", "Mat33f" },
+			{ "mat4", "Mat44f" }
+		};
+
+		for( auto const& type : kTypes )
+		{
+			if( aGlslType == type[0] )
+				return type[1];
+		}
+		return nullptr;
+	}
+
+	std::string namespace_name_( std::string const& aFile )
+	{
+		std::string ret;
+		for( char const c : aFile )
+			ret += std::isalnum( static_cast<unsigned char>(c) ) ? c : '_';
+		return ret;
+	}
+
+	std::string generate_( std::vector<Shader_> const& aShaders )
+	{
+		std::string out;
+		auto const line_ = [&out] (char const* aFormat, auto... aArgs) {
+			char buffer[512];
+			std::snprintf( buffer, sizeof(buffer), aFormat, aArgs... );
+			out += buffer;
+			out += '\n';
+		};
+
+		line_( "// Generated by shader-bindgen from the shaders in assets/. Do not edit." );
+		line_( "// Rebuild (or run shader-bindgen) after changing a shader's interface." );
+		line_( "#ifndef SHADER_BINDINGS_HPP_GENERATED" );
+		line_( "#define SHADER_BINDINGS_HPP_GENERATED" );
+		line_( "" );
+		line_( "#include <glad.h>" );
+		line_( "" );
+		line_( "#include \"../support/program.hpp\"" );
+		line_( "" );
+		line_( "namespace shader_bindings" );
+		line_( "{" );
+
+		bool first = true;
+		for( auto const& shader : aShaders )
+		{
+			if( shader.declarations.empty() )
+				continue;
+
+			if( !first )
+				line_( "" );
+			first = false;
+
+			line_( "\t// assets/%s", shader.file.c_str() );
+			line_( "\tnamespace %s", namespace_name_( shader.file ).c_str() );
+			line_( "\t{" );
+
+			for( auto const& decl : shader.declarations )
+			{
+				switch( decl.kind )
+				{
+					case Kind_::uniform:
+						if( auto const type = cpp_type_( decl.type ) )
+							line_( "\t\tconstexpr ShaderProgram::Location<%s> %s{ %d };", type, decl.name.c_str(), decl.index );
+						else
+							line_( "\t\tconstexpr GLint %s = %d; // %s", decl.name.c_str(), decl.index, decl.type.c_str() );
+						break;
+					case Kind_::sampler:
+						line_( "\t\tconstexpr GLuint %s = %d; // %s, %s unit", decl.name.c_str(), decl.index, decl.type.c_str(),
+							std::string::npos != decl.type.find( "image" ) ? "image" : "texture" );
+						break;
+					case Kind_::uniformBlock:
+						line_( "\t\tconstexpr GLuint %s = %d; // uniform block binding", decl.name.c_str(), decl.index );
+						break;
+					case Kind_::storageBlock:
+						line_( "\t\tconstexpr GLuint %s = %d; // shader storage block binding", decl.name.c_str(), decl.index );
+						break;
+					case Kind_::attribute:
+						line_( "\t\tconstexpr GLuint %s = %d; // %s, vertex attribute", decl.name.c_str(), decl.index, decl.type.c_str() );
+						break;
+				}
+			}
+
+			line_( "\t}" );
+		}
+
+		line_( "}" );
+		line_( "" );
+		line_( "#endif // SHADER_BINDINGS_HPP_GENERATED" );
+		return out;
+	}
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+#	if defined(WIN32)
+	std::string assetDir = "../assets";
+	std::string output = "../main/shader_bindings.hpp";
+#	else
+	std::string assetDir = "assets";
+	std::string output = "main/shader_bindings.hpp";
+#	endif
+
+	if( aArgc > 1 )
+		assetDir = aArgv[1];
+	if( aArgc > 2 )
+		output = aArgv[2];
+	if( aArgc > 3 )
+		throw Error( "Usage: %s [ASSET_DIR] [OUTPUT]", aArgv[0] );
+
+	char const* const kExtensions[] = { ".vert", ".frag", ".geom", ".tesc", ".tese", ".comp", ".glsl" };
+
+	std::vector<fs::path> paths;
+	for( auto const& entry : fs::directory_iterator( assetDir ) )
+	{
+		auto const ext = entry.path().extension();
+		if( entry.is_regular_file() && std::end(kExtensions) != std::find( std::begin(kExtensions), std::end(kExtensions), ext ) )
+			paths.emplace_back( entry.path() );
+	}
+
+	// Keep the output stable
+	std::sort( paths.begin(), paths.end() );
+
+	std::vector<Shader_> shaders;
+	for( auto const& path : paths )
+		shaders.emplace_back( parse_( path ) );
+
+	auto const text = generate_( shaders );
+
+	std::error_code ec;
+	if( fs::exists( output, ec ) && read_text_( output ) == text )
+		return 0;
+
+	write_file_bytes( output.c_str(), text.data(), text.size() );
+	std::printf( "shader-bindgen: wrote %s\n", output.c_str() );
+
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level Exception (%s):\n", typeid(eErr).name() );
+	std::fprintf( stderr, "%s\n", eErr.what() );
+	std::fprintf( stderr, "Bye.\n" );
+	return 1;
+}
@@ -0,0 +1,230 @@
+#include "cooked.hpp"
+
+#include <limits>
+
+#include <cstdio>
+
+#include "error.hpp"
+
+namespace
+{
+	bool in_blob_( std::vector<std::uint8_t> const& aBlob, std::uint64_t aOffset, std::uint64_t aSize ) noexcept
+	{
+		return aOffset <= aBlob.size() && aSize <= aBlob.size() - aOffset;
+	}
+
+	// Is [aFirst, aFirst+aCount) within [0, aTotal)?
+	bool in_range_( std::uint32_t aFirst, std::uint32_t aCount, std::uint32_t aTotal ) noexcept
+	{
+		return aFirst <= aTotal && aCount <= aTotal - aFirst;
+	}
+
+	// Larger levels are rejected as corrupt; this also keeps their byte
+	// sizes from overflowing
+	constexpr std::uint32_t kCookedMaxTextureSize_ = 1u << 16;
+
+	std::uint64_t level_bytes_( CookedTextureFormat aFormat, std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+	{
+		if( std::size_t const blockBytes = cooked_block_bytes( aFormat ) )
+			return std::uint64_t((aWidth + 3) / 4) * ((aHeight + 3) / 4) * blockBytes;
+
+		return std::uint64_t(aWidth) * aHeight * 4;
+	}
+}
+
+std::size_t cooked_block_bytes( CookedTextureFormat aFormat ) noexcept
+{
+	switch( aFormat )
+	{
+		case CookedTextureFormat::rgba8srgb: return 0;
+		case CookedTextureFormat::bc1srgb: return 8;
+		case CookedTextureFormat::bc3srgb: return 16;
+		case CookedTextureFormat::bc7srgb: return 16;
+	}
+
+	return 0;
+}
+
+std::uint8_t const* CookedTexture::level_data( std::size_t aLevel ) const noexcept
+{
+	return blob.data() + header->levels[aLevel].offset;
+}
+
+CookedMesh read_cooked_mesh( char const* aPath )
+{
+	CookedMesh ret;
+	ret.blob = read_file_bytes( aPath );
+
+	if( ret.blob.size() < sizeof(CookedMeshHeader) )
+		throw Error( "read_cooked_mesh(): '%s' is truncated", aPath );
+
+	auto const* header = reinterpret_cast<CookedMeshHeader const*>(ret.blob.data());
+	if( kCookedMeshMagic != header->magic )
+		throw Error( "read_cooked_mesh(): '%s' is not a cooked mesh", aPath );
+	if( kCookedMeshVersion != header->version )
+		throw Error( "read_cooked_mesh(): '%s' has version %u, expected %u", aPath, header->version, kCookedMeshVersion );
+	if( header->lodCount < 1 || header->lodCount > kCookedMaxLods )
+		throw Error( "read_cooked_mesh(): '%s' has invalid LOD count %u", aPath, header->lodCount );
+
+	std::uint64_t const vec3Bytes = std::uint64_t(header->vertexCount) * 3 * sizeof(float);
+	std::uint64_t const vec2Bytes = std::uint64_t(header->vertexCount) * 2 * sizeof(float);
+	std::uint64_t const indexBytes = std::uint64_t(header->indexCount) * sizeof(std::uint32_t);
+	std::uint64_t const meshletBytes = std::uint64_t(header->meshletCount) * sizeof(CookedMeshlet);
+
+	if( !in_blob_( ret.blob, header->positionsOffset, vec3Bytes )
+		|| !in_blob_( ret.blob, header->colorsOffset, vec3Bytes )
+		|| !in_blob_( ret.blob, header->normalsOffset, vec3Bytes )
+		|| (header->hasTexcoords && !in_blob_( ret.blob, header->texcoordsOffset, vec2Bytes ))
+		|| !in_blob_( ret.blob, header->indicesOffset, indexBytes )
+		|| !in_blob_( ret.blob, header->meshletsOffset, meshletBytes ) )
+	{
+		throw Error( "read_cooked_mesh(): '%s' is truncated", aPath );
+	}
+
+	// The ranges go to draw calls as they are: check that they stay within
+	// the index buffer, and the indices within the vertices
+	auto const* base = ret.blob.data();
+	auto const* indices = reinterpret_cast<std::uint32_t const*>(base + header->indicesOffset);
+
+	if( header->indexCount > std::uint32_t(std::numeric_limits<std::int32_t>::max()) )
+		throw Error( "read_cooked_mesh(): '%s' has too many indices (%u)", aPath, header->indexCount );
+
+	for( std::uint32_t i = 0; i < header->lodCount; ++i )
+	{
+		auto const& lod = header->lods[i];
+		if( !in_range_( lod.firstIndex, lod.indexCount, header->indexCount ) || 0 != lod.indexCount % 3 )
+			throw Error( "read_cooked_mesh(): '%s' has invalid index range %u+%u for LOD %u", aPath, lod.firstIndex, lod.indexCount, i );
+	}
+
+	for( std::uint32_t i = 0; i < header->indexCount; ++i )
+	{
+		if( indices[i] >= header->vertexCount )
+			throw Error( "read_cooked_mesh(): '%s' has index %u out of range (%u vertices)", aPath, indices[i], header->vertexCount );
+	}
+
+	auto const* meshlets = reinterpret_cast<CookedMeshlet const*>(base + header->meshletsOffset);
+	auto const& lod0 = header->lods[0];
+	for( std::uint32_t i = 0; i < header->meshletCount; ++i )
+	{
+		auto const& meshlet = meshlets[i];
+		bool const valid = meshlet.firstIndex >= lod0.firstIndex
+			&& in_range_( meshlet.firstIndex - lod0.firstIndex, meshlet.indexCount, lod0.indexCount )
+			&& 0 == meshlet.indexCount % 3
+			&& meshlet.indexCount <= 3 * kCookedMeshletMaxTriangles;
+
+		if( !valid )
+			throw Error( "read_cooked_mesh(): '%s' has invalid index range %u+%u for meshlet %u", aPath, meshlet.firstIndex, meshlet.indexCount, i );
+	}
+
+	ret.header = header;
+	ret.positions = reinterpret_cast<float const*>(base + header->positionsOffset);
+	ret.colors = reinterpret_cast<float const*>(base + header->colorsOffset);
+	ret.normals = reinterpret_cast<float const*>(base + header->normalsOffset);
+	if( header->hasTexcoords )
+		ret.texcoords = reinterpret_cast<float const*>(base + header->texcoordsOffset);
+	ret.indices = indices;
+	if( header->meshletCount )
+		ret.meshlets = meshlets;
+
+	return ret;
+}
+
+CookedTexture read_cooked_texture( char const* aPath )
+{
+	CookedTexture ret;
+	ret.blob = read_file_bytes( aPath );
+
+	if( ret.blob.size() < sizeof(CookedTextureHeader) )
+		throw Error( "read_cooked_texture(): '%s' is truncated", aPath );
+
+	auto const* header = reinterpret_cast<CookedTextureHeader const*>(ret.blob.data());
+	if( kCookedTextureMagic != header->magic )
+		throw Error( "read_cooked_texture(): '%s' is not a cooked texture", aPath );
+	if( kCookedTextureVersion != header->version )
+		throw Error( "read_cooked_texture(): '%s' has version %u, expected %u", aPath, header->version, kCookedTextureVersion );
+	if( header->levelCount < 1 || header->levelCount > kCookedMaxLevels )
+		throw Error( "read_cooked_texture(): '%s' has invalid level count %u", aPath, header->levelCount );
+
+	bool const knownFormat = CookedTextureFormat::rgba8srgb == header->format || 0 != cooked_block_bytes( header->format );
+	if( !knownFormat )
+		throw Error( "read_cooked_texture(): '%s' has unknown format %u", aPath, std::uint32_t(header->format) );
+
+	for( std::uint32_t i = 0; i < header->levelCount; ++i )
+	{
+		auto const& level = header->levels[i];
+
+		// The levels are uploaded as they are, so their sizes must match
+		// their dimensions exactly
+		if( level.width < 1 || level.height < 1 || level.width > kCookedMaxTextureSize_ || level.height > kCookedMaxTextureSize_ )
+			throw Error( "read_cooked_texture(): '%s' has invalid size %u x %u (level %u)", aPath, level.width, level.height, i );
+		if( level.size != level_bytes_( header->format, level.width, level.height ) )
+			throw Error( "read_cooked_texture(): '%s' has %llu bytes for a %u x %u level (level %u)", aPath, (unsigned long long)level.size, level.width, level.height, i );
+
+		if( !in_blob_( ret.blob, level.offset, level.size ) )
+			throw Error( "read_cooked_texture(): '%s' is truncated (level %u)", aPath, i );
+	}
+
+	ret.header = header;
+	return ret;
+}
+
+
+std::vector<std::uint8_t> read_file_bytes( char const* aPath )
+{
+	std::FILE* fin = std::fopen( aPath, "rb" );
+	if( !fin )
+		throw Error( "read_file_bytes(): unable to open '%s'", aPath );
+
+	std::fseek( fin, 0, SEEK_END );
+	auto const length = std::size_t(std::ftell( fin ));
+	std::fseek( fin, 0, SEEK_SET );
+
+	std::vector<std::uint8_t> ret( length );
+	auto const read = std::fread( ret.data(), 1, length, fin );
+	std::fclose( fin );
+
+	if( read != length )
+		throw Error( "read_file_bytes(): short read from '%s' (%zu of %zu bytes)", aPath, read, length );
+
+	return ret;
+}
+
+void write_file_bytes( char const* aPath, void const* aData, std::size_t aSize )
+{
+	std::FILE* fout = std::fopen( aPath, "wb" );
+	if( !fout )
+		throw Error( "write_file_bytes(): unable to open '%s' for writing", aPath );
+
+	auto const written = std::fwrite( aData, 1, aSize, fout );
+	auto const closed = std::fclose( fout );
+
+	if( written != aSize || 0 != closed )
+		throw Error( "write_file_bytes(): error while writing '%s'", aPath );
+}
+
+std::uint64_t fnv1a64( void const* aData, std::size_t aSize, std::uint64_t aSeed ) noexcept
+{
+	auto const* bytes = static_cast<std::uint8_t const*>(aData);
+
+	std::uint64_t hash = aSeed;
+	for( std::size_t i = 0; i < aSize; ++i )
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+std::string cooked_path( std::string const& aSourcePath, char const* aExtension )
+{
+	auto const slash = aSourcePath.find_last_of( "/\\" );
+	std::string const dir = std::string::npos == slash ? std::string() : aSourcePath.substr( 0, slash+1 );
+	std::string name = std::string::npos == slash ? aSourcePath : aSourcePath.substr( slash+1 );
+
+	auto const dot = name.find_last_of( '.' );
+	if( std::string::npos != dot )
+		name.resize( dot );
+
+	return dir + "cooked/" + name + aExtension;
+}
@@ -0,0 +1,166 @@
+#ifndef COOKED_HPP_5C0E6F4B_2D8A_4A8E_9E37_61B0C6A4D1F2
+#define COOKED_HPP_5C0E6F4B_2D8A_4A8E_9E37_61B0C6A4D1F2
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+/* Cooked asset formats
+ *
+ * These are written by the asset-cooker and read by the main program. The
+ * files are little more than a header followed by the raw arrays that get
+ * uploaded to OpenGL, so loading them is a single read followed by a few
+ * glBufferData()/glTexImage2D() calls. There is no parsing or conversion
+ * at runtime.
+ *
+ * The formats are not intended to be portable between machines with a
+ * different endianness. Bump the version when changing a layout; readers
+ * reject files with a different version (the cooker will then rebuild
+ * them).
+ */
+
+constexpr std::uint32_t kCookedMeshMagic = 0x48534d43; // "CMSH"
+constexpr std::uint32_t kCookedMeshVersion = 2;
+
+constexpr std::uint32_t kCookedTextureMagic = 0x58455443; // "CTEX"
+constexpr std::uint32_t kCookedTextureVersion = 1;
+
+constexpr std::size_t kCookedMaxLods = 4;
+constexpr std::size_t kCookedMaxLevels = 16;
+
+struct CookedMeshLod
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	float error; // approximate geometric error in object space units
+};
+
+// A cluster of up to kCookedMeshletMaxTriangles triangles of LOD 0, whose
+// indices are contiguous. Mirrors the std430 Meshlet struct in
+// assets/meshlets.comp.
+constexpr std::size_t kCookedMeshletMaxTriangles = 128;
+constexpr std::size_t kCookedMeshletMaxVertices = 64;
+
+struct CookedMeshlet
+{
+	float sphere[4]; // bounding sphere: center xyz, radius
+
+	// Normal cone: all triangle normals are within the half angle of the
+	// axis (xyz). w is the sine of the half angle, or 1 if the normals
+	// span a half space or more, in which case the axis is zero.
+	float cone[4];
+
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	std::uint32_t padding[2];
+};
+
+static_assert( sizeof(CookedMeshlet) == 48 );
+
+struct CookedMeshHeader
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+
+	std::uint32_t vertexCount;
+	std::uint32_t indexCount; // total, over all LODs
+	std::uint32_t lodCount;
+	std::uint32_t hasTexcoords;
+	std::uint32_t meshletCount; // of LOD 0, covering all of its triangles
+
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphere[4]; // center xyz, radius
+
+	CookedMeshLod lods[kCookedMaxLods];
+
+	// Byte offsets of the individual arrays from the start of the file.
+	// Positions, colors and normals are 3 floats per vertex, texcoords 2
+	// floats, indices are 32-bit unsigned integers, and meshlets are
+	// CookedMeshlets.
+	std::uint64_t positionsOffset;
+	std::uint64_t colorsOffset;
+	std::uint64_t normalsOffset;
+	std::uint64_t texcoordsOffset;
+	std::uint64_t indicesOffset;
+	std::uint64_t meshletsOffset;
+};
+
+enum class CookedTextureFormat : std::uint32_t
+{
+	rgba8srgb = 0,
+
+	// Block compressed formats. Levels are stored as rows of 4x4 blocks;
+	// levels smaller than 4x4 still occupy a full block.
+	bc1srgb = 1, // 8 bytes per block, opaque
+	bc3srgb = 2, // 16 bytes per block, BC4-style alpha
+	bc7srgb = 3  // 16 bytes per block
+};
+
+// Bytes per 4x4 block for block compressed formats, zero otherwise
+std::size_t cooked_block_bytes( CookedTextureFormat ) noexcept;
+
+struct CookedTextureLevel
+{
+	std::uint64_t offset;
+	std::uint64_t size;
+	std::uint32_t width, height;
+};
+
+struct CookedTextureHeader
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+
+	CookedTextureFormat format;
+	std::uint32_t width, height;
+	std::uint32_t levelCount;
+
+	CookedTextureLevel levels[kCookedMaxLevels];
+};
+
+
+// A cooked file loaded into memory. The header and the arrays point into
+// the blob, so the CookedMesh/CookedTexture must outlive any use of them.
+struct CookedMesh
+{
+	std::vector<std::uint8_t> blob;
+	CookedMeshHeader const* header = nullptr;
+
+	float const* positions = nullptr;
+	float const* colors = nullptr;
+	float const* normals = nullptr;
+	float const* texcoords = nullptr; // null if !header->hasTexcoords
+	std::uint32_t const* indices = nullptr;
+	CookedMeshlet const* meshlets = nullptr;
+};
+
+struct CookedTexture
+{
+	std::vector<std::uint8_t> blob;
+	CookedTextureHeader const* header = nullptr;
+
+	std::uint8_t const* level_data( std::size_t aLevel ) const noexcept;
+};
+
+// Load cooked files. These throw Error if the file cannot be read or if it
+// is not a valid cooked file of the current version.
+CookedMesh read_cooked_mesh( char const* aPath );
+CookedTexture read_cooked_texture( char const* aPath );
+
+// Helpers shared by the cooker and the runtime
+std::vector<std::uint8_t> read_file_bytes( char const* aPath );
+void write_file_bytes( char const* aPath, void const* aData, std::size_t aSize );
+
+// 64-bit FNV-1a. Not cryptographic, but good enough to detect content
+// changes. Pass a previous result as aSeed to hash data incrementally.
+constexpr std::uint64_t kFnv1aSeed = 0xcbf29ce484222325ull;
+std::uint64_t fnv1a64( void const* aData, std::size_t aSize, std::uint64_t aSeed = kFnv1aSeed ) noexcept;
+
+// Path of the cooked version of a source asset: "assets/foo.obj" with
+// extension ".mesh" maps to "assets/cooked/foo.mesh".
+std::string cooked_path( std::string const& aSourcePath, char const* aExtension );
+
+#endif // COOKED_HPP_5C0E6F4B_2D8A_4A8E_9E37_61B0C6A4D1F2
@@ -0,0 +1,130 @@
+#include "file_watcher.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#	include <unistd.h>
+#	include <sys/inotify.h>
+#endif // ~ __linux__
+
+#include "error.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::string normalize_( std::string const& aPath )
+	{
+		std::error_code ec;
+		auto path = fs::absolute( fs::path( aPath ), ec );
+		if( ec )
+			path = fs::path( aPath );
+
+		return path.lexically_normal().string();
+	}
+
+	long long modification_stamp_( std::string const& aPath )
+	{
+		std::error_code ec;
+		auto const time = fs::last_write_time( aPath, ec );
+		if( ec )
+			return 0; // missing, e.g. in the middle of being replaced
+
+		return static_cast<long long>(time.time_since_epoch().count());
+	}
+}
+
+FileWatcher::FileWatcher()
+{
+#	if defined(__linux__)
+	mInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( -1 == mInotify )
+		throw Error( "inotify_init1() failed: %s", std::strerror( errno ) );
+#	endif // ~ __linux__
+}
+
+FileWatcher::~FileWatcher()
+{
+#	if defined(__linux__)
+	if( -1 != mInotify )
+		close( mInotify );
+#	endif // ~ __linux__
+}
+
+void FileWatcher::watch( std::string const& aPath )
+{
+	auto key = normalize_( aPath );
+	if( mFiles.count( key ) )
+		return;
+
+#	if defined(__linux__)
+	// Watch the directory rather than the file; see header.
+	auto const dir = fs::path( key ).parent_path().string();
+
+	int const wd = inotify_add_watch( mInotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE );
+	if( -1 == wd )
+		throw Error( "Unable to watch '%s': %s", dir.c_str(), std::strerror( errno ) );
+
+	// Adding the same directory again returns the same descriptor
+	mDirs[wd] = dir;
+#	endif // ~ __linux__
+
+	File_ file;
+	file.path = aPath;
+	file.stamp = modification_stamp_( key );
+
+	mFiles.emplace( std::move(key), std::move(file) );
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> changed;
+	auto const add_ = [&changed] (std::string const& aPath) {
+		for( auto const& path : changed )
+		{
+			if( path == aPath )
+				return;
+		}
+		changed.emplace_back( aPath );
+	};
+
+#	if defined(__linux__)
+	alignas(inotify_event) char buffer[4096];
+	for( ;; )
+	{
+		auto const bytes = read( mInotify, buffer, sizeof(buffer) );
+		if( bytes <= 0 )
+			break; // EAGAIN: no more events
+
+		for( char const* ptr = buffer; ptr < buffer + bytes; )
+		{
+			auto const* event = reinterpret_cast<inotify_event const*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			auto const dir = mDirs.find( event->wd );
+			if( mDirs.end() == dir || 0 == event->len )
+				continue;
+
+			auto const it = mFiles.find( (fs::path( dir->second ) / event->name).string() );
+			if( mFiles.end() != it )
+				add_( it->second.path );
+		}
+	}
+#	else // !__linux__
+	for( auto& [key, file] : mFiles )
+	{
+		auto const stamp = modification_stamp_( key );
+		if( 0 != stamp && stamp != file.stamp )
+		{
+			file.stamp = stamp;
+			add_( file.path );
+		}
+	}
+#	endif // ~ __linux__
+
+	return changed;
+}
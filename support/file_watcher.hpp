@@ -0,0 +1,49 @@
+#ifndef FILE_WATCHER_HPP_C41E9B27_6D05_4A8F_B3E2_9F07A5D1C86B
+#define FILE_WATCHER_HPP_C41E9B27_6D05_4A8F_B3E2_9F07A5D1C86B
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/* Watches a set of files for changes
+ *
+ * On Linux, this uses inotify on the files' directories (editors often save
+ * by writing a new file and renaming it over the old one, which replaces the
+ * watched inode). Elsewhere, the files' modification times are compared on
+ * each poll(), which is fine for the handful of files that we watch.
+ */
+class FileWatcher final
+{
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		FileWatcher( FileWatcher const& ) = delete;
+		FileWatcher& operator= (FileWatcher const&) = delete;
+
+	public:
+		// Adding a file that is already watched does nothing. Throws Error if
+		// the file's directory cannot be watched.
+		void watch( std::string const& aPath );
+
+		// Returns the watched files that changed since the last call, each
+		// listed once (with the path given to watch()). Does not block.
+		std::vector<std::string> poll();
+
+	private:
+		struct File_
+		{
+			std::string path;
+			long long stamp = 0; // modification time; fallback only
+		};
+
+		// Keyed on the normalized path
+		std::unordered_map<std::string, File_> mFiles;
+
+#		if defined(__linux__)
+		int mInotify = -1;
+		std::unordered_map<int, std::string> mDirs; // watch descriptor -> dir
+#		endif // ~ __linux__
+};
+
+#endif // FILE_WATCHER_HPP_C41E9B27_6D05_4A8F_B3E2_9F07A5D1C86B
@@ -0,0 +1,19 @@
+#include "gl_extensions.hpp"
+
+#include <cstring>
+
+#include <glad.h>
+
+bool has_gl_extension( char const* aName )
+{
+	GLint count = 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+
+	for( GLint i = 0; i < count; ++i )
+	{
+		auto const* ext = reinterpret_cast<char const*>(glGetStringi( GL_EXTENSIONS, GLuint(i) ));
+		if( ext && 0 == std::strcmp( ext, aName ) )
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,9 @@
+#ifndef GL_EXTENSIONS_HPP_8E1C4A72_3B5D_4F09_A6E2_71D9C0B54F38
+#define GL_EXTENSIONS_HPP_8E1C4A72_3B5D_4F09_A6E2_71D9C0B54F38
+
+// Returns true if the current OpenGL context supports the extension aName
+// (e.g. "GL_KHR_parallel_shader_compile"). Queries the context on each call,
+// so callers that ask repeatedly should keep the result.
+bool has_gl_extension( char const* aName );
+
+#endif // GL_EXTENSIONS_HPP_8E1C4A72_3B5D_4F09_A6E2_71D9C0B54F38
@@ -0,0 +1,179 @@
+#include "gl_state.hpp"
+
+#include <cassert>
+
+namespace
+{
+	// A shadowed value, unknown until first set
+	template< typename tValue >
+	struct Shadow_
+	{
+		tValue value{};
+		bool known = false;
+	};
+
+	constexpr GLuint kMaxTextureUnits_ = 32;
+
+	// Capabilities that are shadowed; others are passed through
+	constexpr GLenum kCapabilities_[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_FRAMEBUFFER_SRGB };
+	constexpr std::size_t kCapabilityCount_ = sizeof(kCapabilities_) / sizeof(kCapabilities_[0]);
+
+	struct State_
+	{
+		Shadow_<GLuint> program;
+		Shadow_<GLuint> pipeline;
+		Shadow_<GLuint> activeTexture;
+		Shadow_<GLuint> textures[kMaxTextureUnits_];
+		Shadow_<GLuint> vertexArray;
+		Shadow_<GLuint> framebuffer;
+		Shadow_<bool> capabilities[kCapabilityCount_];
+		Shadow_<GLenum> polygonMode;
+		Shadow_<GLenum> depthFunc;
+		Shadow_<bool> depthMask;
+		Shadow_<bool> colorMask;
+	};
+
+	State_ gState_;
+	gl_state::Counters gCounters_;
+	gl_state::Counters gFrameCounters_;
+
+	// Updates the shadow, and returns true if the call must be made
+	template< typename tValue >
+	bool change_( Shadow_<tValue>& aShadow, tValue aValue, gl_state::Category aCategory )
+	{
+		auto const cat = std::size_t(aCategory);
+		if( aShadow.known && aShadow.value == aValue )
+		{
+			++gCounters_.skipped[cat];
+			return false;
+		}
+
+		aShadow.value = aValue;
+		aShadow.known = true;
+		++gCounters_.issued[cat];
+		return true;
+	}
+}
+
+namespace gl_state
+{
+	char const* category_name( Category aCategory )
+	{
+		switch( aCategory )
+		{
+			case Category::program: return "program";
+			case Category::texture: return "texture";
+			case Category::vertexArray: return "vertex array";
+			case Category::framebuffer: return "framebuffer";
+			case Category::fixedFunction: return "fixed function";
+			case Category::count_: break;
+		}
+		return "?";
+	}
+
+	void begin_frame()
+	{
+		gState_ = State_{};
+
+		gFrameCounters_ = gCounters_;
+		gCounters_ = Counters{};
+	}
+
+	Counters const& frame_counters()
+	{
+		return gFrameCounters_;
+	}
+
+	void use_program( GLuint aProgram )
+	{
+		if( change_( gState_.program, aProgram, Category::program ) )
+			glUseProgram( aProgram );
+	}
+	void bind_program_pipeline( GLuint aPipeline )
+	{
+		if( change_( gState_.pipeline, aPipeline, Category::program ) )
+			glBindProgramPipeline( aPipeline );
+	}
+
+	void bind_texture( GLuint aUnit, GLuint aTexture )
+	{
+		assert( aUnit < kMaxTextureUnits_ );
+
+		if( change_( gState_.activeTexture, aUnit, Category::texture ) )
+			glActiveTexture( GL_TEXTURE0 + aUnit );
+		if( change_( gState_.textures[aUnit], aTexture, Category::texture ) )
+			glBindTexture( GL_TEXTURE_2D, aTexture );
+	}
+
+	void delete_texture( GLuint aTexture )
+	{
+		// Deleting a bound texture reverts its bindings to zero
+		for( auto& unit : gState_.textures )
+		{
+			if( unit.known && unit.value == aTexture )
+				unit.value = 0;
+		}
+
+		glDeleteTextures( 1, &aTexture );
+	}
+
+	void bind_vertex_array( GLuint aVao )
+	{
+		if( change_( gState_.vertexArray, aVao, Category::vertexArray ) )
+			glBindVertexArray( aVao );
+	}
+	void delete_vertex_array( GLuint aVao )
+	{
+		// Deleting the bound VAO reverts the binding to zero
+		if( gState_.vertexArray.known && gState_.vertexArray.value == aVao )
+			gState_.vertexArray.value = 0;
+
+		glDeleteVertexArrays( 1, &aVao );
+	}
+
+	void bind_framebuffer( GLuint aFramebuffer )
+	{
+		if( change_( gState_.framebuffer, aFramebuffer, Category::framebuffer ) )
+			glBindFramebuffer( GL_FRAMEBUFFER, aFramebuffer );
+	}
+
+	void set_enabled( GLenum aCapability, bool aEnabled )
+	{
+		for( std::size_t i = 0; i < kCapabilityCount_; ++i )
+		{
+			if( kCapabilities_[i] == aCapability )
+			{
+				if( !change_( gState_.capabilities[i], aEnabled, Category::fixedFunction ) )
+					return;
+				break;
+			}
+		}
+
+		if( aEnabled )
+			glEnable( aCapability );
+		else
+			glDisable( aCapability );
+	}
+
+	void polygon_mode( GLenum aMode )
+	{
+		if( change_( gState_.polygonMode, aMode, Category::fixedFunction ) )
+			glPolygonMode( GL_FRONT_AND_BACK, aMode );
+	}
+	void depth_func( GLenum aFunc )
+	{
+		if( change_( gState_.depthFunc, aFunc, Category::fixedFunction ) )
+			glDepthFunc( aFunc );
+	}
+	void depth_mask( bool aWrite )
+	{
+		if( change_( gState_.depthMask, aWrite, Category::fixedFunction ) )
+			glDepthMask( aWrite ? GL_TRUE : GL_FALSE );
+	}
+	void color_mask( bool aWrite )
+	{
+		GLboolean const write = aWrite ? GL_TRUE : GL_FALSE;
+		if( change_( gState_.colorMask, aWrite, Category::fixedFunction ) )
+			glColorMask( write, write, write, write );
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef GL_STATE_HPP_E4A1C6D8_2B97_4F05_9C3E_81D7F5B0A26C
+#define GL_STATE_HPP_E4A1C6D8_2B97_4F05_9C3E_81D7F5B0A26C
+
+#include <glad.h>
+
+#include <cstdlib>
+
+/* Shadowed OpenGL state
+ *
+ * Wrappers for the state changes that the renderer makes per draw. Each
+ * remembers the last value it set, and drops calls that would not change
+ * it. All calls are counted per category, both those that reached OpenGL
+ * and those that were dropped.
+ *
+ * State that is changed directly (e.g. glBindTexture() while uploading a
+ * texture) is not seen, so the shadow can go stale. begin_frame() forgets
+ * all of it; call it after code that may bind things directly (loaders,
+ * resizing) and before drawing. Within the frame, use these wrappers. Use
+ * delete_vertex_array() and delete_texture() for objects that may
+ * be deleted mid-frame, as a deleted name can be handed out again.
+ *
+ * There is a single OpenGL context, so the shadow is global.
+ */
+namespace gl_state
+{
+	enum class Category
+	{
+		program,      // glUseProgram(), glBindProgramPipeline()
+		texture,      // glActiveTexture(), glBindTexture()
+		vertexArray,  // glBindVertexArray()
+		framebuffer,  // glBindFramebuffer()
+		fixedFunction,// glEnable()/glDisable(), glPolygonMode(), depth, color mask
+
+		count_
+	};
+
+	constexpr std::size_t kCategoryCount = std::size_t(Category::count_);
+
+	struct Counters
+	{
+		std::size_t issued[kCategoryCount] = {};
+		std::size_t skipped[kCategoryCount] = {};
+	};
+
+	char const* category_name( Category );
+
+	// Forgets the shadowed state, and starts counting a new frame
+	void begin_frame();
+
+	// Counters of the last complete frame (i.e., up to the last
+	// begin_frame())
+	Counters const& frame_counters();
+
+	void use_program( GLuint );
+	void bind_program_pipeline( GLuint );
+
+	// Binds a GL_TEXTURE_2D to a texture unit (0, 1, ...). Leaves that unit
+	// active.
+	void bind_texture( GLuint aUnit, GLuint aTexture );
+	void delete_texture( GLuint );
+
+	void bind_vertex_array( GLuint );
+	void delete_vertex_array( GLuint );
+
+	// GL_FRAMEBUFFER, i.e., both the draw and the read framebuffer
+	void bind_framebuffer( GLuint );
+
+	void set_enabled( GLenum aCapability, bool aEnabled );
+	void polygon_mode( GLenum aMode ); // GL_FRONT_AND_BACK
+	void depth_func( GLenum );
+	void depth_mask( bool );
+	void color_mask( bool );
+}
+
+#endif // GL_STATE_HPP_E4A1C6D8_2B97_4F05_9C3E_81D7F5B0A26C
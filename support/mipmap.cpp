@@ -0,0 +1,84 @@
+#include "mipmap.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+namespace
+{
+	float srgb_to_linear_( std::uint8_t aValue ) noexcept
+	{
+		float const c = aValue / 255.f;
+		return c <= 0.04045f ? c / 12.92f : std::pow( (c + 0.055f) / 1.055f, 2.4f );
+	}
+
+	std::uint8_t linear_to_srgb_( float aValue ) noexcept
+	{
+		float const c = std::clamp( aValue, 0.f, 1.f );
+		float const s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow( c, 1.f/2.4f ) - 0.055f;
+		return std::uint8_t(s * 255.f + 0.5f);
+	}
+
+	// Odd sizes are handled by clamping to the edge.
+	Rgba8Image downsample_( Rgba8Image const& aSrc, float const* aToLinear )
+	{
+		Rgba8Image ret;
+		ret.width = std::max( 1u, aSrc.width / 2 );
+		ret.height = std::max( 1u, aSrc.height / 2 );
+		ret.rgba.resize( std::size_t(ret.width) * ret.height * 4 );
+
+		for( std::uint32_t y = 0; y < ret.height; ++y )
+		{
+			std::uint32_t const y0 = std::min( 2*y, aSrc.height-1 );
+			std::uint32_t const y1 = std::min( 2*y+1, aSrc.height-1 );
+
+			for( std::uint32_t x = 0; x < ret.width; ++x )
+			{
+				std::uint32_t const x0 = std::min( 2*x, aSrc.width-1 );
+				std::uint32_t const x1 = std::min( 2*x+1, aSrc.width-1 );
+
+				std::uint8_t const* taps[] = {
+					&aSrc.rgba[(std::size_t(y0)*aSrc.width + x0)*4],
+					&aSrc.rgba[(std::size_t(y0)*aSrc.width + x1)*4],
+					&aSrc.rgba[(std::size_t(y1)*aSrc.width + x0)*4],
+					&aSrc.rgba[(std::size_t(y1)*aSrc.width + x1)*4]
+				};
+
+				auto* out = &ret.rgba[(std::size_t(y)*ret.width + x)*4];
+				for( int c = 0; c < 3; ++c )
+				{
+					float const sum = aToLinear[taps[0][c]] + aToLinear[taps[1][c]] + aToLinear[taps[2][c]] + aToLinear[taps[3][c]];
+					out[c] = linear_to_srgb_( 0.25f * sum );
+				}
+
+				out[3] = std::uint8_t((taps[0][3] + taps[1][3] + taps[2][3] + taps[3][3] + 2) / 4);
+			}
+		}
+
+		return ret;
+	}
+}
+
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+{
+	std::uint32_t count = 1;
+	for( auto size = std::max( aWidth, aHeight ); size > 1; size /= 2 )
+		++count;
+	return count;
+}
+
+std::vector<Rgba8Image> build_srgb_mip_chain( Rgba8Image aBase )
+{
+	float toLinear[256];
+	for( int i = 0; i < 256; ++i )
+		toLinear[i] = srgb_to_linear_( std::uint8_t(i) );
+
+	std::vector<Rgba8Image> levels;
+	levels.reserve( mip_level_count( aBase.width, aBase.height ) );
+	levels.emplace_back( std::move(aBase) );
+
+	while( levels.back().width > 1 || levels.back().height > 1 )
+		levels.emplace_back( downsample_( levels.back(), toLinear ) );
+
+	return levels;
+}
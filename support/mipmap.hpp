@@ -0,0 +1,23 @@
+#ifndef MIPMAP_HPP_2B6F0D94_7C1E_4E3A_8D5B_A9F4C3E17B60
+#define MIPMAP_HPP_2B6F0D94_7C1E_4E3A_8D5B_A9F4C3E17B60
+
+#include <vector>
+
+#include <cstdint>
+
+struct Rgba8Image
+{
+	std::uint32_t width, height;
+	std::vector<std::uint8_t> rgba;
+};
+
+// Number of levels in a full mip chain, down to 1x1. Each level is half the
+// size of the previous one, rounded down (as OpenGL expects).
+std::uint32_t mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept;
+
+// Builds the full mip chain of an sRGB encoded image; the first element is
+// aBase itself. Levels are computed with a 2x2 box filter. Color channels
+// are averaged in linear space, alpha is averaged directly.
+std::vector<Rgba8Image> build_srgb_mip_chain( Rgba8Image aBase );
+
+#endif // MIPMAP_HPP_2B6F0D94_7C1E_4E3A_8D5B_A9F4C3E17B60
@@ -1,22 +1,69 @@
 #include "program.hpp"
 
+#include <string>
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
 
 #include <cstdio>
+#include <cstring>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
 
 #include "error.hpp"
+#include "cooked.hpp"
 #include "checkpoint.hpp"
+#include "gl_extensions.hpp"
+#include "program_cache.hpp"
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat33.hpp"
+#include "../vmlib/mat44.hpp"
+
+namespace fs = std::filesystem;
 
 namespace
 {
-	GLuint load_shader_( 
+	std::vector<GLchar> read_source_( char const* aSourcePath );
+
+	void preprocess_(
+		std::string const& aSourcePath,
+		std::vector<GLchar>& aSource,
+		std::vector<std::string>& aFiles
+	);
+	bool parse_include_(
+		std::string_view aLine,
+		std::string_view& aName,
+		char const* aSourcePath,
+		std::size_t aLineNumber
+	);
+
+	void inject_defines_( 
+		std::vector<GLchar>& aSource,
+		std::vector<std::string> const& aDefines
+	);
+
+	GLuint submit_shader_( 
 		GLenum aShaderType, 
-		char const* aSourcePath
+		std::vector<GLchar> const& aSource
 	);
+	void check_shader_(
+		GLuint aShader,
+		GLenum aShaderType, 
+		std::vector<std::string> const& aFiles
+	);
+
+	// From GL_KHR_parallel_shader_compile. The GLAD loader was not generated
+	// with this extension.
+	constexpr GLenum kCompletionStatusKHR_ = 0x91B1;
+	using MaxShaderCompilerThreadsKHR_ = void (APIENTRYP)( GLuint );
+
+	bool gParallelShaderCompile_ = false;
 
 	// lightweight std::experimental::scope_exit alternative
 	// Not the most complete or convenient implementation...
@@ -37,15 +84,20 @@ namespace
 	}
 }
 
-ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources )
+ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources, ProgramBinaryCache const* aCache, std::vector<std::string> aDefines, bool aSeparable )
 	: mProgram( 0 )
 	, mSources( std::move(aShaderSources) )
+	, mDefines( std::move(aDefines) )
+	, mCache( aCache )
+	, mSeparable( aSeparable )
 {
-	reload();
+	submit();
 }
 
 ShaderProgram::~ShaderProgram()
 {
+	release_pending_();
+
 	if( 0 != mProgram )
 		glDeleteProgram( mProgram );
 }
@@ -53,63 +105,183 @@ ShaderProgram::~ShaderProgram()
 ShaderProgram::ShaderProgram( ShaderProgram&& aOther ) noexcept
 	: mProgram( std::exchange( aOther.mProgram, 0 ) )
 	, mSources( std::move(aOther.mSources) )
+	, mDefines( std::move(aOther.mDefines) )
+	, mFiles( std::move(aOther.mFiles) )
+	, mDependencies( std::move(aOther.mDependencies) )
+	, mCache( aOther.mCache )
+	, mSeparable( aOther.mSeparable )
+	, mPending( std::exchange( aOther.mPending, Pending_{} ) )
+	, mUniforms( std::move(aOther.mUniforms) )
+	, mBlocks( std::move(aOther.mBlocks) )
+	, mSlots( std::move(aOther.mSlots) )
+	, mLocationSlots( std::move(aOther.mLocationSlots) )
 {}
 ShaderProgram& ShaderProgram::operator= (ShaderProgram&& aOther) noexcept
 {
 	std::swap( mProgram, aOther.mProgram );
 	std::swap( mSources, aOther.mSources );
+	std::swap( mDefines, aOther.mDefines );
+	std::swap( mFiles, aOther.mFiles );
+	std::swap( mDependencies, aOther.mDependencies );
+	std::swap( mCache, aOther.mCache );
+	std::swap( mSeparable, aOther.mSeparable );
+	std::swap( mPending, aOther.mPending );
+	std::swap( mUniforms, aOther.mUniforms );
+	std::swap( mBlocks, aOther.mBlocks );
+	std::swap( mSlots, aOther.mSlots );
+	std::swap( mLocationSlots, aOther.mLocationSlots );
 	return *this;
 }
 
-GLuint ShaderProgram::programId() const noexcept
+bool ShaderProgram::separable() const noexcept
+{
+	return mSeparable;
+}
+
+GLbitfield ShaderProgram::stage_bits() const noexcept
 {
+	GLbitfield bits = 0;
+	for( auto const& source : mSources )
+	{
+		switch( source.type )
+		{
+			case GL_VERTEX_SHADER: bits |= GL_VERTEX_SHADER_BIT; break;
+			case GL_FRAGMENT_SHADER: bits |= GL_FRAGMENT_SHADER_BIT; break;
+			case GL_GEOMETRY_SHADER: bits |= GL_GEOMETRY_SHADER_BIT; break;
+			case GL_TESS_CONTROL_SHADER: bits |= GL_TESS_CONTROL_SHADER_BIT; break;
+			case GL_TESS_EVALUATION_SHADER: bits |= GL_TESS_EVALUATION_SHADER_BIT; break;
+			case GL_COMPUTE_SHADER: bits |= GL_COMPUTE_SHADER_BIT; break;
+		}
+	}
+
+	return bits;
+}
+
+GLuint ShaderProgram::programId()
+{
+	finish_first_();
 	return mProgram;
 }
 
-void ShaderProgram::reload()
+void ShaderProgram::submit()
 {
-	// Space to hold the shaders when we load them
-	std::vector<GLuint> shaders;
-	shaders.reserve( mSources.size() );
+	// Read and preprocess the sources. The program binary cache is keyed on
+	// their final contents (including includes and defines), so this is
+	// always needed.
+	std::vector<std::vector<GLchar>> sources;
+	sources.reserve( mSources.size() );
 
-	// Ensure that shaders are cleaned up properly, regardless of how we leave
-	// the function (e.g., either by returning or by exception)
-	auto const scopeShaders_ = scope_exit_( [&shaders] {
-		for( auto const shader : shaders )
-			glDeleteShader( shader );
-	} );
+	std::vector<std::vector<std::string>> stageFiles;
+	stageFiles.reserve( mSources.size() );
 
-	// Load shaders
+	std::uint64_t sourceHash = kFnv1aSeed;
 	for( auto const& source : mSources )
-		shaders.emplace_back( load_shader_( source.type, source.sourcePath.c_str() ) );
+	{
+		preprocess_( source.sourcePath, sources.emplace_back(), stageFiles.emplace_back() );
+		inject_defines_( sources.back(), mDefines );
+
+		sourceHash = fnv1a64( &source.type, sizeof(source.type), sourceHash );
+		sourceHash = fnv1a64( sources.back().data(), sources.back().size(), sourceHash );
+	}
+
+	sourceHash = fnv1a64( &mSeparable, sizeof(mSeparable), sourceHash );
+
+	// Drop a previous build that was never used
+	release_pending_();
+
+	mFiles = std::move(stageFiles);
+	mDependencies.clear();
+	for( auto const& files : mFiles )
+	{
+		for( auto const& file : files )
+		{
+			if( !depends_on( file ) )
+				mDependencies.emplace_back( file );
+		}
+	}
 
 	// Create program object
 	OGL_CHECKPOINT_ALWAYS();
 
-	GLuint prog = glCreateProgram();
+	mPending.program = glCreateProgram();
+
+	// Needs to be set before linking or loading a binary
+	if( mSeparable )
+		glProgramParameteri( mPending.program, GL_PROGRAM_SEPARABLE, GL_TRUE );
+	mPending.cacheKey = mCache ? mCache->key( sourceHash ) : 0;
+
+	// Try the cached binary first. If there is none, or the driver rejects
+	// it, compile and link from source as usual.
+	if( mCache && mCache->load( mPending.cacheKey, mPending.program ) )
+	{
+		OGL_CHECKPOINT_ALWAYS();
+		return;
+	}
+
+	// Compile shaders and link the program. Neither is checked here; see
+	// finish().
+	mPending.shaders.reserve( mSources.size() );
+	for( std::size_t i = 0; i < mSources.size(); ++i )
+		mPending.shaders.emplace_back( submit_shader_( mSources[i].type, sources[i] ) );
+
+	for( auto const shader : mPending.shaders )
+		glAttachShader( mPending.program, shader );
+
+	if( mCache )
+		glProgramParameteri( mPending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+
+	glLinkProgram( mPending.program );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+bool ShaderProgram::ready() const
+{
+	if( 0 == mPending.program || mPending.shaders.empty() || !gParallelShaderCompile_ )
+		return true;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv( mPending.program, kCompletionStatusKHR_, &done );
+	return GL_FALSE != done;
+}
+
+void ShaderProgram::finish()
+{
+	if( 0 == mPending.program )
+		return;
 
-	// Ensure that the program is cleaned up. 
+	Pending_ pending = std::exchange( mPending, Pending_{} );
 
-	/* There is a small trick here. If we successfully compile and link the new
-	 * program, we will replace the value of the "prog" variable with the old
-	 * program's ID. In this case, the following will delete the old program
-	 * (if there was any). If we do not reach the end (e.g. exception thrown),
-	 * the new program ID will still be in the "prog" variable, and we will
-	 * delete it appropriately. (However, the old program in mProgram is left
-	 * intact).
+	// Ensure that the new program is cleaned up. 
+	
+	/* There is a small trick here. If the build succeeded, we will replace the
+	 * value of the "prog" variable with the old program's ID. In this case,
+	 * the following will delete the old program (if there was any). If we do
+	 * not reach the end (e.g. exception thrown), the new program ID will still
+	 * be in the "prog" variable, and we will delete it appropriately.
+	 * (However, the old program in mProgram is left intact).
 	 */
+	GLuint prog = pending.program;
 	auto const scopeProgram_ = scope_exit_( [&prog] {
 		if( 0 != prog )
 			glDeleteProgram( prog );
 	} );
 
-	// Link individual shaders to create the final shader program
-	for( auto const shader : shaders )
-		glAttachShader( prog, shader );
-
-	glLinkProgram( prog );
+	// Ensure that shaders are cleaned up properly, regardless of how we leave
+	// the function (e.g., either by returning or by exception)
+	auto const& shaders = pending.shaders;
+	auto const scopeShaders_ = scope_exit_( [&shaders] {
+		for( auto const shader : shaders )
+			glDeleteShader( shader );
+	} );
 
+	// Programs loaded from the cache were already checked
+	if( !shaders.empty() )
 	{
+		// Check shaders. This is where we wait for the compiler.
+		for( std::size_t i = 0; i < shaders.size(); ++i )
+			check_shader_( shaders[i], mSources[i].type, mFiles[i] );
+
 		// Get info log
 		GLint logLength = 0;
 		glGetProgramiv( prog, GL_INFO_LOG_LENGTH, &logLength );
@@ -130,17 +302,276 @@ void ShaderProgram::reload()
 
 		if( !log.empty() )
 			std::fprintf( stderr, "Note: shader program linking log:\n%s\n", log.data() );
+
+		OGL_CHECKPOINT_ALWAYS();
+
+		if( mCache )
+			mCache->store( pending.cacheKey, prog );
 	}
-	
-	OGL_CHECKPOINT_ALWAYS();
 
 	// Replace the old shader program (if any) with the new one
 	std::swap( mProgram, prog );
+	reflect_();
+}
+
+bool ShaderProgram::update()
+{
+	if( 0 == mPending.program || !ready() )
+		return false;
+
+	finish();
+	return true;
+}
+
+void ShaderProgram::reload()
+{
+	submit();
+	finish();
+}
+
+std::vector<std::string> const& ShaderProgram::dependencies() const noexcept
+{
+	return mDependencies;
+}
+
+bool ShaderProgram::depends_on( std::string const& aPath ) const noexcept
+{
+	return std::find( mDependencies.begin(), mDependencies.end(), aPath ) != mDependencies.end();
+}
+
+ShaderProgram::Uniform ShaderProgram::uniform( char const* aName, std::size_t aElement )
+{
+	finish_first_();
+
+	for( std::size_t i = 0; i < mSlots.size(); ++i )
+	{
+		if( mSlots[i].element == aElement && mSlots[i].name == aName )
+			return Uniform{ std::uint32_t(i) };
+	}
+
+	Slot_ slot{};
+	slot.name = aName;
+	slot.element = aElement;
+	slot.fixedLocation = -1;
+	resolve_( slot );
+
+	mSlots.emplace_back( std::move(slot) );
+	return Uniform{ std::uint32_t(mSlots.size()-1) };
+}
+
+ShaderProgram::UniformBlock const* ShaderProgram::uniform_block( char const* aName )
+{
+	finish_first_();
+
+	auto const it = mBlocks.find( aName );
+	return mBlocks.end() != it ? &it->second : nullptr;
+}
+
+template< typename tValue >
+bool ShaderProgram::changed_( Uniform aUniform, tValue const* aValue, std::size_t aCount, GLint& aLocation )
+{
+	static_assert( sizeof(tValue) == sizeof(std::uint32_t) );
+
+	finish_first_();
+
+	if( aUniform.slot >= mSlots.size() )
+		return false;
+
+	auto& slot = mSlots[aUniform.slot];
+	if( -1 == slot.location )
+		return false;
+
+	std::size_t const bytes = aCount * sizeof(tValue);
+	if( slot.cached && 0 == std::memcmp( slot.value, aValue, bytes ) )
+		return false;
+
+	std::memcpy( slot.value, aValue, bytes );
+	slot.cached = true;
+	aLocation = slot.location;
+	return true;
+}
+
+void ShaderProgram::set( Uniform aUniform, bool aValue )
+{
+	set( aUniform, aValue ? 1 : 0 );
+}
+void ShaderProgram::set( Uniform aUniform, int aValue )
+{
+	GLint location;
+	if( changed_( aUniform, &aValue, 1, location ) )
+		glProgramUniform1i( mProgram, location, aValue );
+}
+void ShaderProgram::set( Uniform aUniform, float aValue )
+{
+	GLint location;
+	if( changed_( aUniform, &aValue, 1, location ) )
+		glProgramUniform1f( mProgram, location, aValue );
+}
+void ShaderProgram::set( Uniform aUniform, Vec2f const& aValue )
+{
+	GLint location;
+	if( changed_( aUniform, &aValue.x, 2, location ) )
+		glProgramUniform2fv( mProgram, location, 1, &aValue.x );
+}
+void ShaderProgram::set( Uniform aUniform, Vec3f const& aValue )
+{
+	GLint location;
+	if( changed_( aUniform, &aValue.x, 3, location ) )
+		glProgramUniform3fv( mProgram, location, 1, &aValue.x );
+}
+void ShaderProgram::set( Uniform aUniform, Vec4f const& aValue )
+{
+	GLint location;
+	if( changed_( aUniform, &aValue.x, 4, location ) )
+		glProgramUniform4fv( mProgram, location, 1, &aValue.x );
+}
+void ShaderProgram::set( Uniform aUniform, Mat33f const& aValue )
+{
+	// Our matrices are row-major, so transpose on upload
+	GLint location;
+	if( changed_( aUniform, aValue.v, 9, location ) )
+		glProgramUniformMatrix3fv( mProgram, location, 1, GL_TRUE, aValue.v );
+}
+void ShaderProgram::set( Uniform aUniform, Mat44f const& aValue )
+{
+	GLint location;
+	if( changed_( aUniform, aValue.v, 16, location ) )
+		glProgramUniformMatrix4fv( mProgram, location, 1, GL_TRUE, aValue.v );
+}
+
+void ShaderProgram::release_pending_() noexcept
+{
+	for( auto const shader : mPending.shaders )
+		glDeleteShader( shader );
+	if( 0 != mPending.program )
+		glDeleteProgram( mPending.program );
+
+	mPending = Pending_{};
+}
+
+void ShaderProgram::finish_first_()
+{
+	if( 0 == mProgram )
+		finish();
+}
+
+ShaderProgram::Uniform ShaderProgram::location_slot_( GLint aLocation )
+{
+	constexpr std::uint32_t kNone = ~std::uint32_t(0);
+
+	if( aLocation < 0 )
+		return Uniform{};
+
+	auto const index = std::size_t(aLocation);
+	if( index < mLocationSlots.size() && kNone != mLocationSlots[index] )
+		return Uniform{ mLocationSlots[index] };
+
+	finish_first_();
+
+	Slot_ slot{};
+	slot.element = 0;
+	slot.fixedLocation = aLocation;
+	resolve_( slot );
+
+	mSlots.emplace_back( std::move(slot) );
+
+	if( index >= mLocationSlots.size() )
+		mLocationSlots.resize( index+1, kNone );
+
+	mLocationSlots[index] = std::uint32_t(mSlots.size()-1);
+	return Uniform{ mLocationSlots[index] };
+}
+
+void ShaderProgram::reflect_()
+{
+	mUniforms.clear();
+	mBlocks.clear();
+
+	// Default block uniforms
+	GLint count = 0, maxNameLength = 0;
+	glGetProgramInterfaceiv( mProgram, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count );
+	glGetProgramInterfaceiv( mProgram, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength );
+
+	std::vector<GLchar> name( std::size_t(std::max( maxNameLength, 1 )) );
+	for( GLint i = 0; i < count; ++i )
+	{
+		GLenum const props[] = { GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX };
+		GLint values[4] = {};
+		glGetProgramResourceiv( mProgram, GL_UNIFORM, GLuint(i), 4, props, 4, nullptr, values );
+
+		// Skip members of uniform blocks; these do not have a location
+		if( -1 != values[3] || -1 == values[2] )
+			continue;
+
+		glGetProgramResourceName( mProgram, GL_UNIFORM, GLuint(i), GLsizei(name.size()), nullptr, name.data() );
+
+		std::string base( name.data() );
+		if( base.size() > 3 && 0 == base.compare( base.size()-3, 3, "[0]" ) )
+			base.resize( base.size()-3 );
+
+		UniformInfo_ info;
+		info.type = GLenum(values[0]);
+		info.locations.emplace_back( values[2] );
+
+		// Locations of array elements are not necessarily consecutive
+		for( GLint j = 1; j < values[1]; ++j )
+		{
+			auto const element = base + "[" + std::to_string( j ) + "]";
+			info.locations.emplace_back( glGetProgramResourceLocation( mProgram, GL_UNIFORM, element.c_str() ) );
+		}
+
+		mUniforms[base] = std::move(info);
+	}
+
+	// Uniform blocks
+	count = maxNameLength = 0;
+	glGetProgramInterfaceiv( mProgram, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count );
+	glGetProgramInterfaceiv( mProgram, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxNameLength );
+
+	name.resize( std::size_t(std::max( maxNameLength, 1 )) );
+	for( GLint i = 0; i < count; ++i )
+	{
+		GLenum const props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+		GLint values[2] = {};
+		glGetProgramResourceiv( mProgram, GL_UNIFORM_BLOCK, GLuint(i), 2, props, 2, nullptr, values );
+		glGetProgramResourceName( mProgram, GL_UNIFORM_BLOCK, GLuint(i), GLsizei(name.size()), nullptr, name.data() );
+
+		mBlocks[name.data()] = UniformBlock{ GLuint(i), values[0], values[1] };
+	}
+
+	// Re-resolve existing handles. Values are uploaded again on the next
+	// set(), since the new program starts out with default values.
+	for( auto& slot : mSlots )
+		resolve_( slot );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void ShaderProgram::resolve_( Slot_& aSlot ) const
+{
+	aSlot.location = -1;
+	aSlot.cached = false;
+
+	// Fixed locations are only used if the program has an active uniform
+	// there (e.g., not in shader variants that leave it out)
+	if( -1 != aSlot.fixedLocation )
+	{
+		for( auto const& [name, info] : mUniforms )
+		{
+			if( info.locations.end() != std::find( info.locations.begin(), info.locations.end(), aSlot.fixedLocation ) )
+				aSlot.location = aSlot.fixedLocation;
+		}
+		return;
+	}
+
+	auto const it = mUniforms.find( aSlot.name );
+	if( mUniforms.end() != it && aSlot.element < it->second.locations.size() )
+		aSlot.location = it->second.locations[aSlot.element];
 }
 
 namespace
 {
-	GLuint load_shader_( GLenum aShaderType, char const* aSourcePath )
+	std::vector<GLchar> read_source_( char const* aSourcePath )
 	{
 		// Load the shader source code from file
 		std::vector<GLchar> source;
@@ -163,9 +594,9 @@ namespace
 				if( 0 == ret )
 				{
 					if( auto const err = std::ferror( fin ) )
-						throw Error( "load_shader_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
+						throw Error( "read_source_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
 					if( std::feof( fin ) )
-						throw Error( "load_shader_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
+						throw Error( "read_source_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
 				}
 			
 				read += ret;
@@ -173,9 +604,128 @@ namespace
 		}
 		else
 		{
-			throw Error( "load_shader_(): unable to open input file '%s'", aSourcePath );
+			throw Error( "read_source_(): unable to open input file '%s'", aSourcePath );
+		}
+
+		return source;
+	}
+
+	void preprocess_( std::string const& aSourcePath, std::vector<GLchar>& aSource, std::vector<std::string>& aFiles )
+	{
+		// Expand #include "file" directives. Files are included relative to
+		// the including file, and at most once per shader stage. Each file
+		// is a separate GLSL source string number (its index in aFiles), and
+		// #line directives keep line numbers in compiler messages pointing
+		// into the right file. Note that includes are expanded regardless of
+		// any surrounding #if.
+		auto const input = read_source_( aSourcePath.c_str() );
+
+		std::size_t const fileIndex = aFiles.size();
+		aFiles.emplace_back( aSourcePath );
+
+		auto const append_ = [&aSource] (std::string_view aText) {
+			aSource.insert( aSource.end(), aText.begin(), aText.end() );
+		};
+
+		std::string_view const text( input.data(), input.size() );
+
+		std::size_t lineNumber = 1;
+		for( std::size_t pos = 0; pos < text.size(); ++lineNumber )
+		{
+			auto const eol = text.find( '\n', pos );
+			auto const next = std::string_view::npos == eol ? text.size() : eol+1;
+			auto const line = text.substr( pos, next-pos );
+			pos = next;
+
+			std::string_view name;
+			if( !parse_include_( line, name, aSourcePath.c_str(), lineNumber ) )
+			{
+				append_( line );
+				continue;
+			}
+
+			auto const path = (fs::path( aSourcePath ).parent_path() / fs::path( name )).lexically_normal().string();
+			if( aFiles.end() == std::find( aFiles.begin(), aFiles.end(), path ) )
+			{
+				append_( "#line 1 " + std::to_string( aFiles.size() ) + "\n" );
+
+				try
+				{
+					preprocess_( path, aSource, aFiles );
+				}
+				catch( Error const& eErr )
+				{
+					throw Error( "%s(%zu): in #include \"%s\":\n%s", aSourcePath.c_str(), lineNumber, path.c_str(), eErr.what() );
+				}
+
+				if( !aSource.empty() && '\n' != aSource.back() )
+					aSource.emplace_back( '\n' );
+			}
+
+			append_( "#line " + std::to_string( lineNumber+1 ) + " " + std::to_string( fileIndex ) + "\n" );
+		}
+	}
+
+	bool parse_include_( std::string_view aLine, std::string_view& aName, char const* aSourcePath, std::size_t aLineNumber )
+	{
+		auto const skip_space_ = [&aLine] {
+			while( !aLine.empty() && (' ' == aLine.front() || '\t' == aLine.front()) )
+				aLine.remove_prefix( 1 );
+		};
+
+		skip_space_();
+		if( aLine.empty() || '#' != aLine.front() )
+			return false;
+
+		aLine.remove_prefix( 1 );
+		skip_space_();
+
+		constexpr std::string_view kInclude = "include";
+		if( 0 != aLine.compare( 0, kInclude.size(), kInclude ) )
+			return false;
+
+		aLine.remove_prefix( kInclude.size() );
+		skip_space_();
+
+		auto const close = aLine.find( '"', 1 );
+		if( aLine.empty() || '"' != aLine.front() || std::string_view::npos == close || 1 == close )
+			throw Error( "%s(%zu): malformed #include, expected #include \"file\"", aSourcePath, aLineNumber );
+
+		aName = aLine.substr( 1, close-1 );
+		return true;
+	}
+
+	void inject_defines_( std::vector<GLchar>& aSource, std::vector<std::string> const& aDefines )
+	{
+		if( aDefines.empty() )
+			return;
+
+		// The defines go after the #version directive, which must come first.
+		// A #line directive afterwards keeps the line numbers in compile
+		// errors matching the file.
+		std::string_view const source( aSource.data(), aSource.size() );
+
+		std::size_t insertAt = 0;
+		if( auto const version = source.find( "#version" ); std::string_view::npos != version )
+		{
+			auto const eol = source.find( '\n', version );
+			insertAt = std::string_view::npos == eol ? source.size() : eol+1;
 		}
 
+		auto const nextLine = 1 + std::count( source.begin(), source.begin() + insertAt, '\n' );
+
+		std::string block;
+		if( insertAt > 0 && '\n' != source[insertAt-1] )
+			block += '\n';
+		for( auto const& define : aDefines )
+			block += "#define " + define + "\n";
+		block += "#line " + std::to_string( nextLine ) + "\n";
+
+		aSource.insert( aSource.begin() + std::ptrdiff_t(insertAt), block.begin(), block.end() );
+	}
+
+	GLuint submit_shader_( GLenum aShaderType, std::vector<GLchar> const& aSource )
+	{
 		// Create shader object
 		OGL_CHECKPOINT_ALWAYS();
 
@@ -183,10 +733,10 @@ namespace
 
 		// Compile shader
 		GLchar const* sources[] = {
-			source.data()
+			aSource.data()
 		};
 		GLsizei lengths[] = {
-			GLsizei(source.size())
+			GLsizei(aSource.size())
 		};
 
 		glShaderSource( shader, sizeof(sources)/sizeof(sources[0]), sources, lengths );
@@ -195,19 +745,24 @@ namespace
 
 		OGL_CHECKPOINT_ALWAYS();
 
+		return shader;
+	}
+
+	void check_shader_( GLuint aShader, GLenum aShaderType, std::vector<std::string> const& aFiles )
+	{
 		// Get compile info log
 		/* The compile log is mainly relevant if there is an error. However, on some
 		 * systems, it can include additional information even if compilation was
 		 * successful. This might include warnings and/or usage hints.
 		 */
 		GLint logLength = 0;
-		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
+		glGetShaderiv( aShader, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetShaderInfoLog( shader, GLsizei(log.size()), nullptr, log.data() );
+			glGetShaderInfoLog( aShader, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		char const* shaderTypeName = "unknown shader";
@@ -223,19 +778,54 @@ namespace
 
 		// Check compile status
 		GLint status = 0;
-		glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+		glGetShaderiv( aShader, GL_COMPILE_STATUS, &status );
+
+		// Messages refer to included files by their source string number
+		std::string legend;
+		for( std::size_t i = 1; i < aFiles.size(); ++i )
+			legend += "  " + std::to_string( i ) + ": " + aFiles[i] + "\n";
+		if( !legend.empty() )
+			legend = "Source strings (0: " + aFiles[0] + "):\n" + legend;
 
 		if( GL_TRUE != status )
-		{
-			glDeleteShader( shader );
-			throw Error( "%s \"%s\" compilation failed:\n%s\n", shaderTypeName, aSourcePath, log.data() );
-		}
+			throw Error( "%s \"%s\" compilation failed:\n%s\n%s", shaderTypeName, aFiles[0].c_str(), log.data(), legend.c_str() );
 
 		if( !log.empty() )
-			std::fprintf( stderr, "Note: %s \"%s\" log:\n%s\n", shaderTypeName, aSourcePath, log.data() );
+			std::fprintf( stderr, "Note: %s \"%s\" log:\n%s\n%s", shaderTypeName, aFiles[0].c_str(), log.data(), legend.c_str() );
 
 		OGL_CHECKPOINT_ALWAYS();
-
-		return shader;
 	}
 }
+
+bool setup_parallel_shader_compile()
+{
+	if( !has_gl_extension( "GL_KHR_parallel_shader_compile" ) && !has_gl_extension( "GL_ARB_parallel_shader_compile" ) )
+		return false;
+
+	// The KHR and ARB entry points are identical
+	auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsKHR_>(glfwGetProcAddress( "glMaxShaderCompilerThreadsKHR" ));
+	if( !maxThreads )
+		maxThreads = reinterpret_cast<MaxShaderCompilerThreadsKHR_>(glfwGetProcAddress( "glMaxShaderCompilerThreadsARB" ));
+	if( !maxThreads )
+		return false;
+
+	// 0xFFFFFFFF lets the implementation pick the number of threads
+	maxThreads( 0xFFFFFFFFu );
+
+	gParallelShaderCompile_ = true;
+	return true;
+}
+
+bool parallel_shader_compile() noexcept
+{
+	return gParallelShaderCompile_;
+}
+
+std::string load_shader_source( std::string const& aSourcePath )
+{
+	std::vector<GLchar> source;
+	std::vector<std::string> files;
+	preprocess_( aSourcePath, source, files );
+
+	return std::string( source.begin(), source.end() );
+}
@@ -5,10 +5,19 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 #include <cstdint>
 #include <cstdlib>
 
+class ProgramBinaryCache;
+
+struct Vec2f;
+struct Vec3f;
+struct Vec4f;
+struct Mat33f;
+struct Mat44f;
+
 class ShaderProgram final
 {
 	public:
@@ -18,9 +27,50 @@ class ShaderProgram final
 			std::string sourcePath;
 		};
 
+		// Handle to a uniform (or one element of a uniform array). Handles
+		// are resolved by name once, and stay valid across reload(). Setting
+		// a uniform that is not active in the program does nothing.
+		struct Uniform
+		{
+			std::uint32_t slot = ~std::uint32_t(0);
+		};
+
+		// Uniform with an explicit layout(location = N) in the shader, see the
+		// generated main/shader_bindings.hpp. Unlike Uniform, this needs no
+		// lookup by name, and the value type is checked at compile time.
+		template< typename tValue >
+		struct Location
+		{
+			GLint value;
+		};
+
+		struct UniformBlock
+		{
+			GLuint index;
+			GLint binding;
+			GLint dataSize;
+		};
+
 	public:
+		// If a cache is given, the linked program is loaded from (and stored
+		// to) it. The cache must outlive the program. Each define ("NAME" or
+		// "NAME VALUE") is injected into every shader stage, right after the
+		// #version line.
+		//
+		// Sources may #include "file" other files, relative to the including
+		// file. Each file is included at most once per stage.
+		//
+		// A separable program (GL_PROGRAM_SEPARABLE) can be combined with
+		// other separable programs in a program pipeline (see
+		// ProgramPipeline); typically it has a single stage.
+		//
+		// The constructor only submits the program (see submit()); compile
+		// and link errors are thrown when the program is first used.
 		explicit ShaderProgram( 
-			std::vector<ShaderSource> = {}
+			std::vector<ShaderSource> = {},
+			ProgramBinaryCache const* = nullptr,
+			std::vector<std::string> aDefines = {},
+			bool aSeparable = false
 		);
 
 		~ShaderProgram();
@@ -32,13 +82,138 @@ class ShaderProgram final
 		ShaderProgram& operator= (ShaderProgram&&) noexcept;
 
 	public:
-		GLuint programId() const noexcept;
+		// Waits for the first build, if it is still pending (see finish())
+		GLuint programId();
+
+		bool separable() const noexcept;
 
+		// The stages of the program, as GL_*_SHADER_BIT flags
+		GLbitfield stage_bits() const noexcept;
+
+		// Starts (re-)building the program from source. The shaders are
+		// compiled and linked without checking their status, so that the
+		// driver can work on several programs at once. The status is checked
+		// by finish(). For the first build, finish() is called implicitly
+		// when the program is first used (programId(), uniform(), set(),
+		// ...). Later builds are only swapped in by finish() or update(); the
+		// previous program remains in use until then.
+		void submit();
+
+		// True if finish() would not have to wait for the driver. This is
+		// only known with GL_KHR_parallel_shader_compile; without it, builds
+		// are always reported as ready, and finish() (and thus update())
+		// compiles and links synchronously. ShaderVariants::update() then
+		// spreads rebuilds over several calls.
+		bool ready() const;
+
+		// Waits for a submitted build and replaces the current program with
+		// it. Throws Error if compilation or linking failed; the current
+		// program (if any) is kept in that case.
+		void finish();
+
+		// Calls finish() if a submitted build is ready(). Returns true if the
+		// program was replaced.
+		bool update();
+
+		// submit() followed by finish()
 		void reload();
 
+		// All files that the last submitted build was made from: the source
+		// files and the files that they #include
+		std::vector<std::string> const& dependencies() const noexcept;
+		bool depends_on( std::string const& aPath ) const noexcept;
+
+		Uniform uniform( char const* aName, std::size_t aElement = 0 );
+
+		// Returns nullptr if there is no active block with that name
+		UniformBlock const* uniform_block( char const* aName );
+
+		// Typed setters. These use glProgramUniform*(), so the program does
+		// not need to be bound. The last value of each uniform is kept, and
+		// the upload is skipped if the value did not change. (Do not mix with
+		// glUniform*() calls for the same uniforms.)
+		void set( Uniform, bool );
+		void set( Uniform, int );
+		void set( Uniform, float );
+		void set( Uniform, Vec2f const& );
+		void set( Uniform, Vec3f const& );
+		void set( Uniform, Vec4f const& );
+		void set( Uniform, Mat33f const& );
+		void set( Uniform, Mat44f const& );
+
+		template< typename tValue >
+		void set( Location<tValue> aLocation, tValue const& aValue )
+		{
+			set( location_slot_( aLocation.value ), aValue );
+		}
+
+	private:
+		// Active uniforms and blocks, as reported by program introspection.
+		// Array uniforms are listed under their base name ("a" for "a[0]").
+		struct UniformInfo_
+		{
+			GLenum type;
+			std::vector<GLint> locations; // one per array element
+		};
+
+		// A submitted build that has not been checked yet
+		struct Pending_
+		{
+			GLuint program = 0;
+			std::vector<GLuint> shaders; // one per source; empty if cached
+			std::uint64_t cacheKey = 0;
+		};
+
+		struct Slot_
+		{
+			std::string name;
+			std::size_t element;
+			GLint fixedLocation; // for Location<>s, -1 otherwise
+
+			GLint location;
+
+			bool cached;
+			std::uint32_t value[16];
+		};
+
+		void release_pending_() noexcept;
+		void finish_first_();
+
+		Uniform location_slot_( GLint );
+
+		void reflect_();
+		void resolve_( Slot_& ) const;
+
+		template< typename tValue >
+		bool changed_( Uniform, tValue const* aValue, std::size_t aCount, GLint& aLocation );
+
 	private:
 		GLuint mProgram;
 		std::vector<ShaderSource> mSources;
+		std::vector<std::string> mDefines;
+		std::vector<std::vector<std::string>> mFiles; // per stage; [0] is the source
+		std::vector<std::string> mDependencies;
+		ProgramBinaryCache const* mCache;
+		bool mSeparable;
+
+		Pending_ mPending;
+
+		std::unordered_map<std::string, UniformInfo_> mUniforms;
+		std::unordered_map<std::string, UniformBlock> mBlocks;
+		std::vector<Slot_> mSlots;
+		std::vector<std::uint32_t> mLocationSlots; // location -> slot
 };
 
+// Reads a shader source and expands its #includes, like ShaderProgram does
+// (but without any defines). Throws Error on failure.
+std::string load_shader_source( std::string const& aSourcePath );
+
+// Enables GL_KHR_parallel_shader_compile, if supported, with as many compiler
+// threads as the driver allows. Call once after loading the GL API. Returns
+// false if the extension is not available.
+bool setup_parallel_shader_compile();
+
+// True if setup_parallel_shader_compile() succeeded
+bool parallel_shader_compile() noexcept;
+
 #endif // PROGRAM_HPP_39793FD2_7845_47A7_9E21_6DDAD42C9A09
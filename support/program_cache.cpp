@@ -0,0 +1,157 @@
+#include "program_cache.hpp"
+
+#include <vector>
+#include <exception>
+#include <filesystem>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+
+#include "error.hpp"
+#include "cooked.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr std::uint32_t kProgramBinaryMagic_ = 0x4e494250; // "PBIN"
+	constexpr std::uint32_t kProgramBinaryVersion_ = 1;
+
+	struct ProgramBinaryHeader_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t format;  // GLenum from glGetProgramBinary()
+		std::uint32_t size;
+	};
+
+	std::uint64_t hash_string_( GLenum aName, std::uint64_t aSeed )
+	{
+		auto const* str = reinterpret_cast<char const*>(glGetString( aName ));
+		if( !str )
+			return aSeed;
+
+		// Include the terminator, so that "ab"+"c" and "a"+"bc" differ
+		return fnv1a64( str, std::strlen( str )+1, aSeed );
+	}
+}
+
+ProgramBinaryCache::ProgramBinaryCache( std::string aDirectory )
+	: mDirectory( std::move(aDirectory) )
+	, mDriverHash( kFnv1aSeed )
+	, mEnabled( false )
+{
+	GLint formats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	if( formats <= 0 )
+	{
+		std::fprintf( stderr, "Note: driver does not support program binaries, not caching programs\n" );
+		return;
+	}
+
+	std::error_code ec;
+	fs::create_directories( mDirectory, ec );
+	if( ec )
+	{
+		std::fprintf( stderr, "Note: unable to create program cache directory '%s': %s\n", mDirectory.c_str(), ec.message().c_str() );
+		return;
+	}
+
+	mDriverHash = hash_string_( GL_VENDOR, mDriverHash );
+	mDriverHash = hash_string_( GL_RENDERER, mDriverHash );
+	mDriverHash = hash_string_( GL_VERSION, mDriverHash );
+	mEnabled = true;
+}
+
+bool ProgramBinaryCache::enabled() const noexcept
+{
+	return mEnabled;
+}
+
+std::uint64_t ProgramBinaryCache::key( std::uint64_t aSourceHash ) const noexcept
+{
+	return fnv1a64( &aSourceHash, sizeof(aSourceHash), mDriverHash );
+}
+
+bool ProgramBinaryCache::load( std::uint64_t aKey, GLuint aProgram ) const
+{
+	if( !mEnabled )
+		return false;
+
+	auto const path = path_( aKey );
+
+	std::vector<std::uint8_t> blob;
+	try
+	{
+		blob = read_file_bytes( path.c_str() );
+	}
+	catch( std::exception const& )
+	{
+		return false; // not cached (yet)
+	}
+
+	ProgramBinaryHeader_ header;
+	if( blob.size() < sizeof(header) )
+		return false;
+
+	std::memcpy( &header, blob.data(), sizeof(header) );
+	if( kProgramBinaryMagic_ != header.magic || kProgramBinaryVersion_ != header.version || aKey != header.key || blob.size() - sizeof(header) != header.size )
+		return false;
+
+	glProgramBinary( aProgram, GLenum(header.format), blob.data() + sizeof(header), GLsizei(header.size) );
+
+	GLint status = 0;
+	glGetProgramiv( aProgram, GL_LINK_STATUS, &status );
+	if( GL_TRUE != status )
+	{
+		std::fprintf( stderr, "Note: cached program binary '%s' was rejected by the driver\n", path.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+void ProgramBinaryCache::store( std::uint64_t aKey, GLuint aProgram ) const
+{
+	if( !mEnabled )
+		return;
+
+	GLint length = 0;
+	glGetProgramiv( aProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return;
+
+	std::vector<std::uint8_t> blob( sizeof(ProgramBinaryHeader_) + std::size_t(length) );
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary( aProgram, length, &written, &format, blob.data() + sizeof(ProgramBinaryHeader_) );
+	if( written <= 0 )
+		return;
+
+	ProgramBinaryHeader_ header{};
+	header.magic = kProgramBinaryMagic_;
+	header.version = kProgramBinaryVersion_;
+	header.key = aKey;
+	header.format = format;
+	header.size = std::uint32_t(written);
+	std::memcpy( blob.data(), &header, sizeof(header) );
+
+	try
+	{
+		write_file_bytes( path_( aKey ).c_str(), blob.data(), sizeof(header) + std::size_t(written) );
+	}
+	catch( std::exception const& eErr )
+	{
+		std::fprintf( stderr, "Note: unable to cache program binary: %s\n", eErr.what() );
+	}
+}
+
+std::string ProgramBinaryCache::path_( std::uint64_t aKey ) const
+{
+	char name[32];
+	std::snprintf( name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(aKey) );
+	return (fs::path( mDirectory ) / name).string();
+}
@@ -0,0 +1,54 @@
+#ifndef PROGRAM_CACHE_HPP_C4A9E702_61D8_4B3F_95E2_0B8F7D1A36C5
+#define PROGRAM_CACHE_HPP_C4A9E702_61D8_4B3F_95E2_0B8F7D1A36C5
+
+#include <glad.h>
+
+#include <string>
+
+#include <cstdint>
+
+/* On-disk cache of linked program binaries
+ *
+ * Programs are stored with glGetProgramBinary() under a key derived from
+ * their final shader sources and the GL vendor, renderer and version
+ * strings. Drivers may reject a binary at any time (e.g., after an update
+ * that did not change the version string); callers then compile from
+ * source as usual and store the result again.
+ *
+ * A cache must be created with a current OpenGL context. If the driver does
+ * not support any program binary formats, the cache does nothing.
+ */
+class ProgramBinaryCache final
+{
+	public:
+		explicit ProgramBinaryCache( std::string aDirectory );
+
+		ProgramBinaryCache( ProgramBinaryCache const& ) = delete;
+		ProgramBinaryCache& operator= (ProgramBinaryCache const&) = delete;
+
+	public:
+		bool enabled() const noexcept;
+
+		// Combines a hash of the program's sources with the driver identity
+		std::uint64_t key( std::uint64_t aSourceHash ) const noexcept;
+
+		// Loads the binary stored under aKey into aProgram. Returns false if
+		// there is none, or if the driver rejected it. In the latter case,
+		// aProgram is left unlinked and should be linked from source.
+		bool load( std::uint64_t aKey, GLuint aProgram ) const;
+
+		// Stores the binary of a linked program. Failures only print a note.
+		// The program should have been linked with
+		// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+		void store( std::uint64_t aKey, GLuint aProgram ) const;
+
+	private:
+		std::string path_( std::uint64_t aKey ) const;
+
+	private:
+		std::string mDirectory;
+		std::uint64_t mDriverHash;
+		bool mEnabled;
+};
+
+#endif // PROGRAM_CACHE_HPP_C4A9E702_61D8_4B3F_95E2_0B8F7D1A36C5
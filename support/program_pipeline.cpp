@@ -0,0 +1,71 @@
+#include "program_pipeline.hpp"
+
+#include <utility>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "gl_state.hpp"
+#include "checkpoint.hpp"
+
+ProgramPipeline::ProgramPipeline( std::vector<ShaderProgram*> aStages )
+	: mStages( std::move(aStages) )
+	, mAttached( mStages.size(), 0 )
+{
+	for( auto const* stage : mStages )
+	{
+		assert( stage );
+		if( !stage->separable() )
+			throw Error( "ProgramPipeline: all stage programs must be separable" );
+	}
+
+	glGenProgramPipelines( 1, &mPipeline );
+}
+
+ProgramPipeline::~ProgramPipeline()
+{
+	if( 0 != mPipeline )
+		glDeleteProgramPipelines( 1, &mPipeline );
+}
+
+ProgramPipeline::ProgramPipeline( ProgramPipeline&& aOther ) noexcept
+	: mPipeline( std::exchange( aOther.mPipeline, 0 ) )
+	, mStages( std::move(aOther.mStages) )
+	, mAttached( std::move(aOther.mAttached) )
+{}
+ProgramPipeline& ProgramPipeline::operator= (ProgramPipeline&& aOther) noexcept
+{
+	std::swap( mPipeline, aOther.mPipeline );
+	std::swap( mStages, aOther.mStages );
+	std::swap( mAttached, aOther.mAttached );
+	return *this;
+}
+
+void ProgramPipeline::bind()
+{
+	// (Re-)attach programs that were built or rebuilt since the last bind
+	for( std::size_t i = 0; i < mStages.size(); ++i )
+	{
+		GLuint const program = mStages[i]->programId();
+		if( program == mAttached[i] )
+			continue;
+
+		glUseProgramStages( mPipeline, mStages[i]->stage_bits(), program );
+		mAttached[i] = program;
+	}
+
+	gl_state::use_program( 0 );
+	gl_state::bind_program_pipeline( mPipeline );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+GLuint ProgramPipeline::pipelineId() const noexcept
+{
+	return mPipeline;
+}
+
+std::vector<ShaderProgram*> const& ProgramPipeline::stages() const noexcept
+{
+	return mStages;
+}
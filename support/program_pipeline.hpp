@@ -0,0 +1,58 @@
+#ifndef PROGRAM_PIPELINE_HPP_9B3E6D14_C27A_4F58_8E01_6A4D2F9C7B35
+#define PROGRAM_PIPELINE_HPP_9B3E6D14_C27A_4F58_8E01_6A4D2F9C7B35
+
+#include <glad.h>
+
+#include <vector>
+
+#include "program.hpp"
+
+/* Program pipeline
+ *
+ * Combines separable programs (see ShaderProgram), each providing one or
+ * more stages, without linking them together. The same stage program can be
+ * part of many pipelines, so e.g. one vertex program can be used with any
+ * number of fragment program variants.
+ *
+ * The pipeline does not own its programs, which must outlive it. Programs
+ * that are rebuilt (e.g. hot reload) are picked up on the next bind().
+ */
+class ProgramPipeline final
+{
+	public:
+		explicit ProgramPipeline( std::vector<ShaderProgram*> aStages );
+		~ProgramPipeline();
+
+		ProgramPipeline( ProgramPipeline const& ) = delete;
+		ProgramPipeline& operator= (ProgramPipeline const&) = delete;
+
+		ProgramPipeline( ProgramPipeline&& ) noexcept;
+		ProgramPipeline& operator= (ProgramPipeline&&) noexcept;
+
+	public:
+		// Binds the pipeline. This unbinds any program bound with
+		// glUseProgram(), which would take precedence otherwise. Waits for
+		// the first build of the stage programs; see ShaderProgram.
+		void bind();
+
+		GLuint pipelineId() const noexcept;
+
+		std::vector<ShaderProgram*> const& stages() const noexcept;
+
+		// Sets the uniform in each stage program. Stage programs that do not
+		// use the uniform ignore it.
+		template< typename tValue >
+		void set( ShaderProgram::Location<tValue> aLocation, tValue const& aValue )
+		{
+			for( auto* stage : mStages )
+				stage->set( aLocation, aValue );
+		}
+
+	private:
+		GLuint mPipeline = 0;
+
+		std::vector<ShaderProgram*> mStages;
+		std::vector<GLuint> mAttached; // program ID of each stage, as attached
+};
+
+#endif // PROGRAM_PIPELINE_HPP_9B3E6D14_C27A_4F58_8E01_6A4D2F9C7B35
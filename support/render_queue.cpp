@@ -0,0 +1,224 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "error.hpp"
+#include "gl_state.hpp"
+#include "checkpoint.hpp"
+
+namespace
+{
+	constexpr unsigned kPassShift_ = 60;
+	constexpr unsigned kPipelineShift_ = 52;
+	constexpr unsigned kTextureShift_ = 40;
+	constexpr unsigned kVaoShift_ = 24;
+
+	constexpr std::uint32_t kMaxPipelines_ = 1u << 8;
+	constexpr std::uint32_t kMaxTextures_ = 1u << 12;
+	constexpr std::uint32_t kMaxVaos_ = 1u << 16;
+	constexpr std::uint32_t kDepthMax_ = (1u << 24) - 1;
+
+	std::uint32_t pass_of_( std::uint64_t aKey )
+	{
+		return std::uint32_t(aKey >> kPassShift_);
+	}
+}
+
+RenderQueue::RenderQueue( GLuint aTextureUnit, ShaderProgram::Location<Mat44f> aModelWorld )
+	: mTextureUnit( aTextureUnit )
+	, mModelWorld( aModelWorld )
+{
+	begin();
+}
+
+void RenderQueue::begin()
+{
+	mDraws.clear();
+	mKeys.clear();
+	mOrder.clear();
+	mSorted = true;
+
+	mPipelines.clear();
+	mVaos.clear();
+
+	// Index 0 is "no texture"
+	mTextures.assign( 1, 0 );
+}
+
+void RenderQueue::submit( std::uint32_t aPass, Draw const& aDraw )
+{
+	assert( aDraw.pipeline );
+
+	if( aPass >= kMaxPasses )
+		throw Error( "RenderQueue: pass %u out of range", aPass );
+
+	auto const pipeline = index_of_( mPipelines, reinterpret_cast<std::uintptr_t>(aDraw.pipeline), kMaxPipelines_, "pipelines" );
+	auto const texture = index_of_( mTextures, aDraw.texture, kMaxTextures_, "textures" );
+	auto const vao = index_of_( mVaos, aDraw.vao, kMaxVaos_, "VAOs" );
+	auto const depth = std::uint32_t(std::clamp( aDraw.depth, 0.f, 1.f ) * kDepthMax_);
+
+	std::uint64_t const key = (std::uint64_t(aPass) << kPassShift_)
+		| (std::uint64_t(pipeline) << kPipelineShift_)
+		| (std::uint64_t(texture) << kTextureShift_)
+		| (std::uint64_t(vao) << kVaoShift_)
+		| depth
+	;
+
+	mOrder.emplace_back( std::uint32_t(mDraws.size()) );
+	mDraws.emplace_back( aDraw );
+	mKeys.emplace_back( key );
+	mSorted = false;
+}
+
+void RenderQueue::execute( std::uint32_t aPass )
+{
+	if( !mSorted )
+		sort_();
+
+	auto const begin = std::partition_point( mOrder.begin(), mOrder.end(), [this,aPass] (std::uint32_t aDraw) {
+		return pass_of_( mKeys[aDraw] ) < aPass;
+	} );
+
+	ProgramPipeline* pipeline = nullptr;
+	GLuint texture = 0;
+	GLuint vao = 0;
+	Mat44f const* model = nullptr;
+
+	for( auto it = begin; it != mOrder.end() && pass_of_( mKeys[*it] ) == aPass; ++it )
+	{
+		Draw const& draw = mDraws[*it];
+
+		if( draw.pipeline != pipeline )
+		{
+			pipeline = draw.pipeline;
+			pipeline->bind();
+			model = nullptr; // uniforms are per program
+			++mStats.pipelineBinds;
+		}
+
+		if( 0 != draw.texture && draw.texture != texture )
+		{
+			texture = draw.texture;
+			gl_state::bind_texture( mTextureUnit, texture );
+			++mStats.textureBinds;
+		}
+
+		if( draw.vao != vao )
+		{
+			vao = draw.vao;
+			gl_state::bind_vertex_array( vao );
+			++mStats.vaoBinds;
+		}
+
+		if( !model || 0 != std::memcmp( model->v, draw.modelWorld.v, sizeof(model->v) ) )
+		{
+			model = &draw.modelWorld;
+			pipeline->set( mModelWorld, draw.modelWorld );
+			++mStats.modelUpdates;
+		}
+
+		// Without waiting, the draw goes ahead if the query's result is not
+		// available yet
+		if( draw.condition )
+		{
+			glBeginConditionalRender( draw.condition, GL_QUERY_NO_WAIT );
+			++mStats.conditionalDraws;
+		}
+
+		if( draw.indirect )
+		{
+			// DrawElementsIndirectCommand is five uints, DrawArrays... four
+			std::size_t const commandSize = (draw.indexed ? 5 : 4) * sizeof(GLuint);
+			void const* const offset = (void const*)(std::size_t(draw.first) * commandSize);
+
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, draw.indirect );
+			if( draw.indexed )
+				glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, offset, draw.count, 0 );
+			else
+				glMultiDrawArraysIndirect( GL_TRIANGLES, offset, draw.count, 0 );
+			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+		}
+		else if( 1 != draw.instanceCount )
+		{
+			if( draw.indexed )
+				glDrawElementsInstanced( GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, (void const*)(std::size_t(draw.first) * sizeof(std::uint32_t)), draw.instanceCount );
+			else
+				glDrawArraysInstanced( GL_TRIANGLES, draw.first, draw.count, draw.instanceCount );
+		}
+		else if( draw.indexed )
+			glDrawElements( GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, (void const*)(std::size_t(draw.first) * sizeof(std::uint32_t)) );
+		else
+			glDrawArrays( GL_TRIANGLES, draw.first, draw.count );
+
+		if( draw.condition )
+			glEndConditionalRender();
+
+		++mStats.draws;
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+RenderQueue::Stats RenderQueue::stats() const noexcept
+{
+	return mStats;
+}
+void RenderQueue::reset_stats() noexcept
+{
+	mStats = Stats{};
+}
+
+void RenderQueue::sort_()
+{
+	// LSD radix sort of the draw indices, eight bits per round. The
+	// histograms of all rounds are gathered in one sweep; rounds where all
+	// keys have the same digit (e.g. the unused pass bits) are skipped.
+	std::uint32_t counts[8][256] = {};
+	for( auto const key : mKeys )
+	{
+		for( unsigned d = 0; d < 8; ++d )
+			++counts[d][(key >> (8*d)) & 0xff];
+	}
+
+	mScratch.resize( mOrder.size() );
+	for( unsigned d = 0; d < 8; ++d )
+	{
+		auto& count = counts[d];
+		if( std::any_of( std::begin(count), std::end(count), [this] (std::uint32_t aCount) { return aCount == mKeys.size(); } ) )
+			continue;
+
+		std::uint32_t offset = 0;
+		for( auto& c : count )
+		{
+			auto const n = c;
+			c = offset;
+			offset += n;
+		}
+
+		for( auto const draw : mOrder )
+			mScratch[count[(mKeys[draw] >> (8*d)) & 0xff]++] = draw;
+
+		std::swap( mOrder, mScratch );
+	}
+
+	mSorted = true;
+}
+
+std::uint32_t RenderQueue::index_of_( std::vector<std::uintptr_t>& aStates, std::uintptr_t aState, std::uint32_t aLimit, char const* aWhat )
+{
+	// Only a handful of distinct states per frame, so a linear search is fine
+	for( std::size_t i = 0; i < aStates.size(); ++i )
+	{
+		if( aStates[i] == aState )
+			return std::uint32_t(i);
+	}
+
+	if( aStates.size() >= aLimit )
+		throw Error( "RenderQueue: more than %u distinct %s", aLimit, aWhat );
+
+	aStates.emplace_back( aState );
+	return std::uint32_t(aStates.size()-1);
+}
@@ -0,0 +1,122 @@
+#ifndef RENDER_QUEUE_HPP_7D4B2E91_0C6A_4F38_B5E7_29A1C8F3D064
+#define RENDER_QUEUE_HPP_7D4B2E91_0C6A_4F38_B5E7_29A1C8F3D064
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "../vmlib/mat44.hpp"
+
+#include "program.hpp"
+#include "program_pipeline.hpp"
+
+/* Render queue
+ *
+ * Draws are submitted in any order, each with a 64-bit sort key packing
+ * (from the most significant bits down):
+ *
+ *   pass       4 bits    e.g. depth pre-pass before opaque
+ *   pipeline   8 bits
+ *   texture   12 bits
+ *   VAO       16 bits
+ *   depth     24 bits    front to back, for early depth rejection
+ *
+ * Pipelines, textures and VAOs are numbered in order of first submission
+ * since begin(). The keys are radix sorted, and execute() replays a pass,
+ * only binding what differs from the previous draw. State changes are thus
+ * proportional to the number of distinct states rather than draws.
+ *
+ * Each draw sets its model-to-world matrix at a fixed uniform location,
+ * which all pipelines in the queue must share.
+ */
+class RenderQueue final
+{
+	public:
+		static constexpr std::uint32_t kMaxPasses = 16;
+
+		struct Draw
+		{
+			ProgramPipeline* pipeline = nullptr;
+			GLuint texture = 0;        // 0: leaves the texture unit alone
+			GLuint vao = 0;
+
+			bool indexed = false;      // GL_UNSIGNED_INT indices
+			GLsizei first = 0;         // first index or vertex
+			GLsizei count = 0;
+
+			Mat44f modelWorld = kIdentity44f;
+			float depth = 0.f;         // 0 (near) to 1 (far), for sorting
+
+			// Occlusion query to draw conditionally on (GL_QUERY_NO_WAIT),
+			// or 0. Not part of the sort key.
+			GLuint condition = 0;
+
+			// Non-zero: draws the `count` indirect commands from `first`
+			// on in this buffer instead (glMultiDraw*Indirect(), tightly
+			// packed). Not part of the sort key.
+			GLuint indirect = 0;
+
+			// Instances of a direct draw (glDraw*Instanced() if not 1).
+			// Not part of the sort key.
+			GLsizei instanceCount = 1;
+		};
+
+		struct Stats
+		{
+			std::size_t draws = 0;
+			std::size_t pipelineBinds = 0;
+			std::size_t textureBinds = 0;
+			std::size_t vaoBinds = 0;
+			std::size_t modelUpdates = 0;
+			std::size_t conditionalDraws = 0;
+		};
+
+	public:
+		RenderQueue( GLuint aTextureUnit, ShaderProgram::Location<Mat44f> aModelWorld );
+
+		RenderQueue( RenderQueue const& ) = delete;
+		RenderQueue& operator= (RenderQueue const&) = delete;
+
+	public:
+		// Starts a new set of draws, e.g. for the next view
+		void begin();
+
+		// Throws Error if aPass is out of range, or if there are more
+		// distinct pipelines, textures or VAOs than the key can hold.
+		void submit( std::uint32_t aPass, Draw const& aDraw );
+
+		// Replays the draws of one pass, in key order. Assumes nothing about
+		// the current bindings, which are left as the last draw set them.
+		void execute( std::uint32_t aPass );
+
+		// Accumulated until reset_stats()
+		Stats stats() const noexcept;
+		void reset_stats() noexcept;
+
+	private:
+		void sort_();
+
+		static std::uint32_t index_of_( std::vector<std::uintptr_t>&, std::uintptr_t, std::uint32_t aLimit, char const* aWhat );
+
+	private:
+		GLuint mTextureUnit;
+		ShaderProgram::Location<Mat44f> mModelWorld;
+
+		std::vector<Draw> mDraws;
+		std::vector<std::uint64_t> mKeys;     // key per draw
+		std::vector<std::uint32_t> mOrder;    // draw indices, sorted by key
+		std::vector<std::uint32_t> mScratch;
+		bool mSorted = true;
+
+		// Distinct states since begin(); the key holds their index
+		std::vector<std::uintptr_t> mPipelines;
+		std::vector<std::uintptr_t> mTextures;
+		std::vector<std::uintptr_t> mVaos;
+
+		Stats mStats;
+};
+
+#endif // RENDER_QUEUE_HPP_7D4B2E91_0C6A_4F38_B5E7_29A1C8F3D064
@@ -0,0 +1,268 @@
+#include "shader_variants.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+#include <cctype>
+#include <cstdio>
+#include <cassert>
+
+#include "error.hpp"
+#include "cooked.hpp"
+
+namespace
+{
+	std::uint64_t hash_defines_( std::vector<std::string> const& aDefines, std::uint64_t aSeed = kFnv1aSeed )
+	{
+		std::uint64_t key = aSeed;
+		for( auto const& define : aDefines )
+			key = fnv1a64( define.c_str(), define.size()+1, key );
+		return key;
+	}
+
+	bool is_identifier_char_( char aChar )
+	{
+		return std::isalnum( static_cast<unsigned char>(aChar) ) || '_' == aChar;
+	}
+
+	// True if aText contains aName as a whole identifier
+	bool mentions_( std::string_view aText, std::string_view aName )
+	{
+		for( auto pos = aText.find( aName ); std::string_view::npos != pos; pos = aText.find( aName, pos+1 ) )
+		{
+			bool const startOk = 0 == pos || !is_identifier_char_( aText[pos-1] );
+			bool const endOk = pos + aName.size() == aText.size() || !is_identifier_char_( aText[pos + aName.size()] );
+			if( startOk && endOk )
+				return true;
+		}
+		return false;
+	}
+}
+
+ShaderVariants::ShaderVariants( std::vector<ShaderProgram::ShaderSource> aSources, ProgramBinaryCache const* aCache, bool aSeparable )
+	: mSources( std::move(aSources) )
+	, mCache( aCache )
+	, mSeparable( aSeparable )
+{}
+
+ShaderVariants::Variant ShaderVariants::variant( std::vector<std::string> aDefines )
+{
+	// The key does not depend on the order of the defines
+	std::sort( aDefines.begin(), aDefines.end() );
+	aDefines.erase( std::unique( aDefines.begin(), aDefines.end() ), aDefines.end() );
+
+	std::uint64_t const key = hash_defines_( aDefines );
+
+	auto const [first, last] = mByKey.equal_range( key );
+	for( auto it = first; it != last; ++it )
+	{
+		if( mVariants[it->second].defines == aDefines )
+			return Variant{ it->second };
+	}
+
+	auto const index = std::uint32_t(mVariants.size());
+	mVariants.emplace_back( Entry_{ std::move(aDefines), nullptr, nullptr } );
+	mByKey.emplace( key, index );
+
+	return Variant{ index };
+}
+
+ShaderProgram& ShaderVariants::program( Variant aVariant )
+{
+	assert( aVariant.index < mVariants.size() );
+
+	if( mSeparable )
+		throw Error( "ShaderVariants: separable variants have no single program; use pipeline()" );
+
+	auto& entry = mVariants[aVariant.index];
+	if( !entry.program )
+		entry.program = std::make_unique<ShaderProgram>( mSources, mCache, entry.defines );
+
+	return *entry.program;
+}
+
+ProgramPipeline& ShaderVariants::pipeline( Variant aVariant )
+{
+	assert( aVariant.index < mVariants.size() );
+
+	if( !mSeparable )
+		throw Error( "ShaderVariants: variants are not separable; use program()" );
+
+	auto& entry = mVariants[aVariant.index];
+	if( !entry.pipeline )
+	{
+		std::vector<ShaderProgram*> stages;
+		for( std::size_t i = 0; i < mSources.size(); ++i )
+			stages.emplace_back( &stage_( i, entry.defines ) );
+
+		entry.pipeline = std::make_unique<ProgramPipeline>( std::move(stages) );
+	}
+
+	return *entry.pipeline;
+}
+
+void ShaderVariants::submit_all()
+{
+	for( std::uint32_t i = 0; i < mVariants.size(); ++i )
+	{
+		if( mSeparable )
+			pipeline( Variant{ i } );
+		else
+			program( Variant{ i } );
+	}
+}
+
+void ShaderVariants::reload()
+{
+	auto const programs = programs_();
+
+	for( auto* program : programs )
+		program->submit();
+
+	for( auto* program : programs )
+		program->finish();
+}
+
+std::size_t ShaderVariants::rebuild( std::vector<std::string> const& aChangedFiles )
+{
+	std::size_t resubmitted = 0;
+	for( auto* program : programs_() )
+	{
+		bool const affected = std::any_of( aChangedFiles.begin(), aChangedFiles.end(), [program] (std::string const& aFile) {
+			return program->depends_on( aFile );
+		} );
+
+		if( !affected )
+			continue;
+
+		if( parallel_shader_compile() )
+		{
+			// Sources that cannot be read or preprocessed (e.g., a bad
+			// #include) fail here rather than in update(). The program is
+			// left as it was, so report it and keep going.
+			try
+			{
+				program->submit();
+			}
+			catch( Error const& eErr )
+			{
+				std::fprintf( stderr, "Shader rebuild failed, keeping the previous program:\n%s\n", eErr.what() );
+				continue;
+			}
+		}
+		else if( mQueued.end() == std::find( mQueued.begin(), mQueued.end(), program ) )
+			mQueued.emplace_back( program );
+
+		++resubmitted;
+	}
+
+	return resubmitted;
+}
+
+std::size_t ShaderVariants::update()
+{
+	// One synchronous build per call. The program leaves the queue first,
+	// so that a failed build is not retried.
+	if( !mQueued.empty() )
+	{
+		ShaderProgram* const program = mQueued.front();
+		mQueued.erase( mQueued.begin() );
+
+		program->reload();
+		return 1;
+	}
+
+	std::size_t replaced = 0;
+	for( auto* program : programs_() )
+	{
+		if( program->update() )
+			++replaced;
+	}
+
+	return replaced;
+}
+
+std::vector<std::string> ShaderVariants::dependencies() const
+{
+	std::vector<std::string> ret;
+	for( auto const* program : programs_() )
+	{
+		for( auto const& file : program->dependencies() )
+		{
+			if( ret.end() == std::find( ret.begin(), ret.end(), file ) )
+				ret.emplace_back( file );
+		}
+	}
+
+	return ret;
+}
+
+std::size_t ShaderVariants::variant_count() const noexcept
+{
+	return mVariants.size();
+}
+
+std::size_t ShaderVariants::compiled_count() const noexcept
+{
+	return std::size_t(std::count_if( mVariants.begin(), mVariants.end(), [] (Entry_ const& aEntry) {
+		return nullptr != aEntry.program || nullptr != aEntry.pipeline;
+	} ));
+}
+
+std::size_t ShaderVariants::program_count() const noexcept
+{
+	return mSeparable ? mStages.size() : compiled_count();
+}
+
+ShaderProgram& ShaderVariants::stage_( std::size_t aSource, std::vector<std::string> const& aDefines )
+{
+	auto const& source = mSources[aSource];
+
+	// Keep only the defines that the stage mentions. ("NAME VALUE" is
+	// matched by NAME.)
+	auto const text = load_shader_source( source.sourcePath );
+
+	std::vector<std::string> defines;
+	for( auto const& define : aDefines )
+	{
+		auto const name = std::string_view( define ).substr( 0, define.find( ' ' ) );
+		if( mentions_( text, name ) )
+			defines.emplace_back( define );
+	}
+
+	std::uint64_t key = fnv1a64( &source.type, sizeof(source.type) );
+	key = fnv1a64( source.sourcePath.c_str(), source.sourcePath.size()+1, key );
+	key = hash_defines_( defines, key );
+
+	auto const [first, last] = mStages.equal_range( key );
+	for( auto it = first; it != last; ++it )
+	{
+		auto const& other = mSources[it->second.source];
+		if( other.type == source.type && other.sourcePath == source.sourcePath && it->second.defines == defines )
+			return *it->second.program;
+	}
+
+	auto program = std::make_unique<ShaderProgram>( std::vector<ShaderProgram::ShaderSource>{ source }, mCache, defines, true );
+	auto& stage = mStages.emplace( key, Stage_{ aSource, std::move(defines), std::move(program) } )->second;
+	return *stage.program;
+}
+
+std::vector<ShaderProgram*> ShaderVariants::programs_() const
+{
+	std::vector<ShaderProgram*> ret;
+	if( mSeparable )
+	{
+		for( auto const& [key, stage] : mStages )
+			ret.emplace_back( stage.program.get() );
+	}
+	else
+	{
+		for( auto const& entry : mVariants )
+		{
+			if( entry.program )
+				ret.emplace_back( entry.program.get() );
+		}
+	}
+
+	return ret;
+}
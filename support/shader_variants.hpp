@@ -0,0 +1,143 @@
+#ifndef SHADER_VARIANTS_HPP_5F2A8C3E_D941_4B07_A6E3_18C7B5F0D294
+#define SHADER_VARIANTS_HPP_5F2A8C3E_D941_4B07_A6E3_18C7B5F0D294
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "program.hpp"
+#include "program_pipeline.hpp"
+
+/* Shader permutations
+ *
+ * A set of shader sources that is specialized at compile time with #defines
+ * (see ShaderProgram). Each distinct set of defines is a variant. Variants
+ * are registered up front, which is cheap, and compiled when their program
+ * is first requested. Registering the same set of defines again (in any
+ * order) returns the existing variant.
+ *
+ * To compile many variants at startup, register them and call submit_all()
+ * before using any of them. The driver can then compile them in parallel
+ * (see setup_parallel_shader_compile()); each program only waits for its
+ * own build when it is first used.
+ *
+ * Separable variants compile each stage into its own separable program, and
+ * combine the stages with a program pipeline (see ProgramPipeline). A stage
+ * only gets the defines that its (expanded) source mentions, so variants
+ * that differ only in defines that a stage ignores share that stage's
+ * program instead of compiling and linking it again. (A define that a stage
+ * starts to use after it was built, e.g. through hot reload, is only picked
+ * up when the variants are created again.)
+ */
+class ShaderVariants final
+{
+	public:
+		struct Variant
+		{
+			std::uint32_t index = ~std::uint32_t(0);
+		};
+
+	public:
+		// The cache, if any, must outlive the variants.
+		explicit ShaderVariants(
+			std::vector<ShaderProgram::ShaderSource>,
+			ProgramBinaryCache const* = nullptr,
+			bool aSeparable = false
+		);
+
+		ShaderVariants( ShaderVariants const& ) = delete;
+		ShaderVariants& operator= (ShaderVariants const&) = delete;
+
+	public:
+		Variant variant( std::vector<std::string> aDefines );
+
+		// Submits the variant's program if this has not happened yet. Errors
+		// are thrown when the returned program is first used. For variants
+		// that are not separable only; throws Error otherwise.
+		ShaderProgram& program( Variant );
+
+		// As program(), but for separable variants only
+		ProgramPipeline& pipeline( Variant );
+
+		// Submits all registered variants that have not been submitted yet
+		void submit_all();
+
+		// Reloads all variants that have been submitted so far. All are
+		// resubmitted before any of them is checked.
+		void reload();
+
+		// Resubmits the variants that have been submitted so far and that
+		// depend on any of the given files (see ShaderProgram::depends_on()),
+		// without waiting for them. The current programs stay in use until
+		// update() swaps in the new ones. Returns the number of variants
+		// that were resubmitted. Variants whose sources cannot be read or
+		// preprocessed are reported on stderr and keep their program.
+		//
+		// Without parallel shader compilation (see parallel_shader_compile())
+		// the programs are only queued, as the driver would compile them
+		// here, synchronously.
+		std::size_t rebuild( std::vector<std::string> const& aChangedFiles );
+
+		// Swaps in rebuilt programs that are ready. Returns the number of
+		// programs that were replaced. Throws Error for the first variant
+		// that failed to build (which keeps its previous program); calling
+		// update() again continues with the remaining ones.
+		//
+		// Without parallel shader compilation, each call instead builds the
+		// next queued program, synchronously, so that a rebuild costs one
+		// program per call (e.g., per frame) rather than all at once.
+		std::size_t update();
+
+		// The files that the submitted variants depend on, including files
+		// that are #included by some variants only
+		std::vector<std::string> dependencies() const;
+
+		std::size_t variant_count() const noexcept;
+		std::size_t compiled_count() const noexcept;
+
+		// Number of separate programs, i.e., links. Without separable
+		// variants, this is the same as compiled_count().
+		std::size_t program_count() const noexcept;
+
+	private:
+		struct Entry_
+		{
+			std::vector<std::string> defines;
+			std::unique_ptr<ShaderProgram> program;    // not separable
+			std::unique_ptr<ProgramPipeline> pipeline; // separable
+		};
+
+		struct Stage_
+		{
+			std::size_t source;
+			std::vector<std::string> defines;          // filtered
+			std::unique_ptr<ShaderProgram> program;
+		};
+
+		ShaderProgram& stage_( std::size_t aSource, std::vector<std::string> const& aDefines );
+
+		std::vector<ShaderProgram*> programs_() const;
+
+	private:
+		std::vector<ShaderProgram::ShaderSource> mSources;
+		ProgramBinaryCache const* mCache;
+		bool mSeparable;
+
+		std::vector<Entry_> mVariants;
+
+		// Both maps are keyed on a hash of the defines. Hashes may collide,
+		// so lookups compare the defines themselves.
+		std::unordered_multimap<std::uint64_t, std::uint32_t> mByKey;
+
+		// Separable stage programs, keyed on source and (filtered) defines
+		std::unordered_multimap<std::uint64_t, Stage_> mStages;
+
+		// Rebuilds queued for update(), without parallel shader compilation
+		std::vector<ShaderProgram*> mQueued;
+};
+
+#endif // SHADER_VARIANTS_HPP_5F2A8C3E_D941_4B07_A6E3_18C7B5F0D294
@@ -0,0 +1,80 @@
+#include "uniform_buffer.hpp"
+
+#include <algorithm>
+
+#include <cstring>
+
+#include "error.hpp"
+#include "checkpoint.hpp"
+
+UniformRingBuffer::UniformRingBuffer( std::size_t aBytesPerFrame, std::size_t aFrameCount )
+	: mBytesPerFrame( aBytesPerFrame )
+	, mFrameCount( std::clamp<std::size_t>( aFrameCount, 1, kMaxFrames_ ) )
+{
+	GLint alignment = 0;
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+	if( alignment > 0 )
+		mAlignment = std::size_t(alignment);
+
+	// Keep segments aligned as well
+	mBytesPerFrame = (mBytesPerFrame + mAlignment-1) / mAlignment * mAlignment;
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_UNIFORM_BUFFER, mBuffer );
+	glBufferData( GL_UNIFORM_BUFFER, GLsizeiptr(mBytesPerFrame * mFrameCount), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+UniformRingBuffer::~UniformRingBuffer()
+{
+	for( auto const fence : mFences )
+	{
+		if( fence )
+			glDeleteSync( fence );
+	}
+
+	glDeleteBuffers( 1, &mBuffer );
+}
+
+void UniformRingBuffer::begin_frame()
+{
+	mFrame = (mFrame+1) % mFrameCount;
+	mOffset = 0;
+
+	// Wait until the GPU is done with this segment. Normally the fence has
+	// long been signaled, as it was placed mFrameCount frames ago.
+	if( GLsync const fence = mFences[mFrame] )
+	{
+		while( GL_TIMEOUT_EXPIRED == glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ) )
+			;
+
+		glDeleteSync( fence );
+		mFences[mFrame] = nullptr;
+	}
+}
+
+void UniformRingBuffer::end_frame()
+{
+	mFences[mFrame] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+void UniformRingBuffer::push( GLuint aBinding, void const* aData, std::size_t aSize )
+{
+	if( mOffset + aSize > mBytesPerFrame )
+		throw Error( "UniformRingBuffer: out of space (%zu of %zu bytes used, %zu requested)", mOffset, mBytesPerFrame, aSize );
+
+	GLintptr const offset = GLintptr(mFrame * mBytesPerFrame + mOffset);
+
+	glBindBuffer( GL_UNIFORM_BUFFER, mBuffer );
+	if( void* dst = glMapBufferRange( GL_UNIFORM_BUFFER, offset, GLsizeiptr(aSize), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT ) )
+	{
+		std::memcpy( dst, aData, aSize );
+		glUnmapBuffer( GL_UNIFORM_BUFFER );
+	}
+
+	glBindBufferRange( GL_UNIFORM_BUFFER, aBinding, mBuffer, offset, GLsizeiptr(aSize) );
+
+	mOffset += (aSize + mAlignment-1) / mAlignment * mAlignment;
+}
@@ -0,0 +1,56 @@
+#ifndef UNIFORM_BUFFER_HPP_A6E1C83F_92B4_4D70_8F1A_5C2D7B094E63
+#define UNIFORM_BUFFER_HPP_A6E1C83F_92B4_4D70_8F1A_5C2D7B094E63
+
+#include <glad.h>
+
+#include <cstdlib>
+
+/* Ring-buffered uniform buffer
+ *
+ * One buffer object is split into a number of per-frame segments. Blocks are
+ * appended to the current frame's segment with unsynchronized mapping, and
+ * bound with glBindBufferRange(). A fence is placed at the end of each frame;
+ * before a segment is reused (aFrameCount frames later) the fence is waited
+ * on, so that data still used by the GPU is never overwritten.
+ *
+ * The C++ structs passed to push() must mirror the std140 layout of the
+ * corresponding GLSL block.
+ */
+class UniformRingBuffer final
+{
+	public:
+		explicit UniformRingBuffer( std::size_t aBytesPerFrame, std::size_t aFrameCount = 3 );
+		~UniformRingBuffer();
+
+		UniformRingBuffer( UniformRingBuffer const& ) = delete;
+		UniformRingBuffer& operator= (UniformRingBuffer const&) = delete;
+
+	public:
+		void begin_frame();
+		void end_frame();
+
+		// Copies a block into the buffer and binds it to a uniform buffer
+		// binding point. Throws Error if the frame's segment is full.
+		void push( GLuint aBinding, void const* aData, std::size_t aSize );
+
+		template< typename tBlock >
+		void push( GLuint aBinding, tBlock const& aBlock )
+		{
+			push( aBinding, &aBlock, sizeof(tBlock) );
+		}
+
+	private:
+		GLuint mBuffer = 0;
+
+		std::size_t mBytesPerFrame;
+		std::size_t mFrameCount;
+		std::size_t mAlignment = 256;
+
+		std::size_t mFrame = 0;   // current segment
+		std::size_t mOffset = 0;  // within the current segment
+
+		static constexpr std::size_t kMaxFrames_ = 4;
+		GLsync mFences[kMaxFrames_] = {};
+};
+
+#endif // UNIFORM_BUFFER_HPP_A6E1C83F_92B4_4D70_8F1A_5C2D7B094E63
@@ -0,0 +1,108 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <limits>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/frustum.hpp"
+
+TEST_CASE( "Axis-aligned bounding boxes", "[aabb]" )
+{
+	static constexpr float kEps_ = 1e-6f;
+	static constexpr float kInf_ = std::numeric_limits<float>::infinity();
+
+	using namespace Catch::Matchers;
+
+	Aabb const unit{ { -1.f, -1.f, -1.f }, { 1.f, 1.f, 1.f } };
+
+	SECTION( "Union with the empty box" )
+	{
+		auto const box = aabb_union( kEmptyAabb, unit );
+
+		REQUIRE_THAT( box.min.x, WithinAbs( -1.f, kEps_ ) );
+		REQUIRE_THAT( box.max.z, WithinAbs( 1.f, kEps_ ) );
+		REQUIRE( contains( box, unit ) );
+		REQUIRE( !overlaps( kEmptyAabb, unit ) );
+	}
+
+	SECTION( "Transform" )
+	{
+		// 90 degrees about y, then a translation: the x and z extents swap
+		Aabb const box{ { 0.f, 0.f, 0.f }, { 2.f, 1.f, 1.f } };
+		auto const t = transform( make_translation( { 10.f, 0.f, 0.f } ) * make_rotation_y( 3.1415926f/2.f ), box );
+
+		REQUIRE_THAT( t.min.x, WithinAbs( 10.f, 1e-5f ) );
+		REQUIRE_THAT( t.max.x, WithinAbs( 11.f, 1e-5f ) );
+		REQUIRE_THAT( t.min.y, WithinAbs( 0.f, 1e-5f ) );
+		REQUIRE_THAT( t.max.y, WithinAbs( 1.f, 1e-5f ) );
+		REQUIRE_THAT( t.min.z, WithinAbs( -2.f, 1e-5f ) );
+		REQUIRE_THAT( t.max.z, WithinAbs( 0.f, 1e-5f ) );
+	}
+
+	SECTION( "Ray" )
+	{
+		// Along +x towards the box
+		REQUIRE_THAT( intersect_ray( unit, { -5.f, 0.f, 0.f }, { 1.f, kInf_, kInf_ }, 100.f ), WithinAbs( 4.f, kEps_ ) );
+
+		// Starting inside
+		REQUIRE_THAT( intersect_ray( unit, { 0.f, 0.f, 0.f }, { 1.f, kInf_, kInf_ }, 100.f ), WithinAbs( 0.f, kEps_ ) );
+
+		// Too short, pointing away, and passing by
+		REQUIRE( intersect_ray( unit, { -5.f, 0.f, 0.f }, { 1.f, kInf_, kInf_ }, 3.f ) < 0.f );
+		REQUIRE( intersect_ray( unit, { -5.f, 0.f, 0.f }, { -1.f, kInf_, kInf_ }, 100.f ) < 0.f );
+		REQUIRE( intersect_ray( unit, { -5.f, 2.f, 0.f }, { 1.f, kInf_, kInf_ }, 100.f ) < 0.f );
+	}
+
+	SECTION( "Distance" )
+	{
+		REQUIRE_THAT( distance_squared( unit, { 0.5f, 0.f, 0.f } ), WithinAbs( 0.f, kEps_ ) );
+		REQUIRE_THAT( distance_squared( unit, { 4.f, 5.f, 0.f } ), WithinAbs( 25.f, kEps_ ) );
+	}
+}
+
+TEST_CASE( "View frustum", "[frustum]" )
+{
+	// Camera at the origin, looking down -z
+	auto const frustum = make_frustum( make_perspective_projection(
+		60.f * 3.1415926f / 180.f,
+		1280/float(720),
+		0.1f, 100.f
+	) );
+
+	auto const box_ = [] (float aX, float aY, float aZ) {
+		return Aabb{ { aX-0.5f, aY-0.5f, aZ-0.5f }, { aX+0.5f, aY+0.5f, aZ+0.5f } };
+	};
+
+	SECTION( "Inside" )
+	{
+		REQUIRE( intersects( frustum, box_( 0.f, 0.f, -10.f ) ) );
+		REQUIRE( contains( frustum, box_( 0.f, 0.f, -10.f ) ) );
+	}
+
+	SECTION( "Straddling" )
+	{
+		// Through the near plane, and through the far plane
+		REQUIRE( intersects( frustum, box_( 0.f, 0.f, 0.f ) ) );
+		REQUIRE( !contains( frustum, box_( 0.f, 0.f, 0.f ) ) );
+		REQUIRE( intersects( frustum, box_( 0.f, 0.f, -100.f ) ) );
+		REQUIRE( !contains( frustum, box_( 0.f, 0.f, -100.f ) ) );
+	}
+
+	SECTION( "Outside" )
+	{
+		// Behind, beyond the far plane, and outside of each side
+		REQUIRE( !intersects( frustum, box_( 0.f, 0.f, 10.f ) ) );
+		REQUIRE( !intersects( frustum, box_( 0.f, 0.f, -101.f ) ) );
+		REQUIRE( !intersects( frustum, box_( -20.f, 0.f, -10.f ) ) );
+		REQUIRE( !intersects( frustum, box_( 20.f, 0.f, -10.f ) ) );
+		REQUIRE( !intersects( frustum, box_( 0.f, -10.f, -10.f ) ) );
+		REQUIRE( !intersects( frustum, box_( 0.f, 10.f, -10.f ) ) );
+	}
+
+	SECTION( "Normalized planes" )
+	{
+		// The left plane passes through the origin; the near plane is at 0.1
+		auto const& nearPlane = frustum.planes[4];
+		REQUIRE_THAT( -nearPlane.z + nearPlane.w, Catch::Matchers::WithinAbs( 0.9f, 1e-4f ) );
+		REQUIRE_THAT( frustum.planes[0].w, Catch::Matchers::WithinAbs( 0.f, 1e-6f ) );
+	}
+}
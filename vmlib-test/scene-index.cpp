@@ -0,0 +1,240 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <limits>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+
+#include "../vmlib/aabb.hpp"
+#include "../vmlib/frustum.hpp"
+
+#include "../main/scene_index.hpp"
+
+namespace
+{
+	struct Object_
+	{
+		SceneIndex::Proxy proxy;
+		Aabb bounds;
+	};
+
+	Aabb random_box_( std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> position( -100.f, 100.f );
+		std::uniform_real_distribution<float> size( 0.1f, 5.f );
+
+		Vec3f const min{ position( aRng ), position( aRng ), position( aRng ) };
+		return Aabb{ min, min + Vec3f{ size( aRng ), size( aRng ), size( aRng ) } };
+	}
+
+	std::vector<std::uint32_t> sorted_( std::vector<std::uint32_t> aObjects )
+	{
+		std::sort( aObjects.begin(), aObjects.end() );
+		return aObjects;
+	}
+
+	// AVL trees are at most about 1.44 log2(n) high; the rotations only run
+	// along the paths that changed, so allow some slack
+	void require_balanced_( SceneIndex const& aIndex )
+	{
+		auto const stats = aIndex.stats();
+		if( stats.objects > 1 )
+			REQUIRE( stats.height <= std::size_t(2.f * std::log2( float(stats.objects) ) + 2.f) );
+	}
+}
+
+TEST_CASE( "Scene index structure", "[scene-index]" )
+{
+	std::mt19937 rng( 1234 );
+
+	SceneIndex index( 0.5f );
+	std::vector<Object_> objects;
+
+	REQUIRE( index.valid() );
+
+	SECTION( "Insert" )
+	{
+		for( std::uint32_t i = 0; i < 500; ++i )
+		{
+			Aabb const bounds = random_box_( rng );
+			objects.push_back( { index.insert( bounds, i ), bounds } );
+		}
+
+		REQUIRE( index.valid() );
+		REQUIRE( index.stats().objects == 500 );
+		require_balanced_( index );
+
+		for( std::uint32_t i = 0; i < objects.size(); ++i )
+		{
+			REQUIRE( index.object( objects[i].proxy ) == i );
+			REQUIRE( contains( index.fat_bounds( objects[i].proxy ), objects[i].bounds ) );
+		}
+	}
+
+	SECTION( "Insert, move and remove" )
+	{
+		std::uniform_real_distribution<float> step( -3.f, 3.f );
+		std::uniform_int_distribution<int> action( 0, 9 );
+
+		std::uint32_t next = 0;
+		std::size_t reinserts = 0;
+
+		for( int round = 0; round < 2000; ++round )
+		{
+			int const what = objects.empty() ? 0 : action( rng );
+			if( what < 3 )
+			{
+				Aabb const bounds = random_box_( rng );
+				objects.push_back( { index.insert( bounds, next++ ), bounds } );
+			}
+			else if( what < 4 )
+			{
+				std::size_t const i = std::uniform_int_distribution<std::size_t>( 0, objects.size()-1 )( rng );
+				index.remove( objects[i].proxy );
+				objects.erase( objects.begin() + i );
+			}
+			else
+			{
+				// Small steps stay within the fat bounds, large ones do not
+				std::size_t const i = std::uniform_int_distribution<std::size_t>( 0, objects.size()-1 )( rng );
+				float const scale = 7 == what ? 10.f : 0.1f;
+
+				Vec3f const offset = Vec3f{ step( rng ), step( rng ), step( rng ) } * scale;
+				objects[i].bounds = Aabb{ objects[i].bounds.min + offset, objects[i].bounds.max + offset };
+
+				if( index.move( objects[i].proxy, objects[i].bounds ) )
+					++reinserts;
+			}
+
+			if( 0 == round % 50 )
+			{
+				REQUIRE( index.valid() );
+				require_balanced_( index );
+			}
+		}
+
+		REQUIRE( index.valid() );
+		REQUIRE( index.stats().objects == objects.size() );
+		REQUIRE( index.stats().reinserts == reinserts );
+		REQUIRE( reinserts > 0 );
+		require_balanced_( index );
+
+		for( auto const& object : objects )
+			REQUIRE( contains( index.fat_bounds( object.proxy ), object.bounds ) );
+
+		// Down to empty
+		for( auto const& object : objects )
+			index.remove( object.proxy );
+
+		REQUIRE( index.valid() );
+		REQUIRE( index.stats().objects == 0 );
+		REQUIRE( index.stats().height == 0 );
+	}
+}
+
+TEST_CASE( "Scene index queries", "[scene-index]" )
+{
+	std::mt19937 rng( 5678 );
+
+	SceneIndex index( 0.5f );
+	std::vector<SceneIndex::Proxy> proxies;
+
+	for( std::uint32_t i = 0; i < 300; ++i )
+		proxies.push_back( index.insert( random_box_( rng ), i ) );
+
+	// Move some, so that the queries also see reinserted leaves
+	for( std::uint32_t i = 0; i < 300; i += 3 )
+		index.move( proxies[i], random_box_( rng ) );
+
+	REQUIRE( index.valid() );
+
+	std::uniform_real_distribution<float> position( -120.f, 120.f );
+	std::uniform_real_distribution<float> angle( -3.14159f, 3.14159f );
+
+	SECTION( "Frustum" )
+	{
+		for( int test = 0; test < 50; ++test )
+		{
+			Vec3f const eye{ position( rng ), position( rng ), position( rng ) };
+			Mat44f const world2camera = make_rotation_x( 0.5f * angle( rng ) ) * make_rotation_y( angle( rng ) ) * make_translation( -eye );
+			Frustum const frustum = make_frustum( make_perspective_projection( 1.f, 1.5f, 0.1f, 80.f ) * world2camera );
+
+			std::vector<std::uint32_t> expected;
+			for( auto const proxy : proxies )
+			{
+				if( intersects( frustum, index.fat_bounds( proxy ) ) )
+					expected.push_back( index.object( proxy ) );
+			}
+
+			std::vector<std::uint32_t> found;
+			index.query_frustum( frustum, found );
+
+			REQUIRE( sorted_( found ) == sorted_( expected ) );
+		}
+	}
+
+	SECTION( "Sphere" )
+	{
+		std::uniform_real_distribution<float> radius( 0.f, 40.f );
+
+		for( int test = 0; test < 50; ++test )
+		{
+			Vec3f const center{ position( rng ), position( rng ), position( rng ) };
+			float const r = radius( rng );
+
+			std::vector<std::uint32_t> expected;
+			for( auto const proxy : proxies )
+			{
+				if( distance_squared( index.fat_bounds( proxy ), center ) <= r * r )
+					expected.push_back( index.object( proxy ) );
+			}
+
+			std::vector<std::uint32_t> found;
+			index.query_sphere( center, r, found );
+
+			REQUIRE( sorted_( found ) == sorted_( expected ) );
+		}
+	}
+
+	SECTION( "Ray" )
+	{
+		std::size_t hits = 0;
+		for( int test = 0; test < 200; ++test )
+		{
+			Vec3f const origin{ position( rng ), position( rng ), position( rng ) };
+			Vec3f const target{ 0.2f * position( rng ), 0.2f * position( rng ), 0.2f * position( rng ) };
+			Vec3f const dir = normalize( target - origin );
+			Vec3f const invDir{ 1.f / dir.x, 1.f / dir.y, 1.f / dir.z };
+			float const maxDistance = 300.f;
+
+			float closest = std::numeric_limits<float>::max();
+			for( auto const proxy : proxies )
+			{
+				float const t = intersect_ray( index.fat_bounds( proxy ), origin, invDir, maxDistance );
+				if( t >= 0.f )
+					closest = std::min( closest, t );
+			}
+
+			SceneIndex::RayHit hit;
+			bool const found = index.raycast( origin, dir, maxDistance, hit );
+
+			REQUIRE( found == (closest <= maxDistance) );
+			if( found )
+			{
+				++hits;
+				REQUIRE( hit.distance == closest );
+
+				// The reported object's bounds are entered at that distance
+				auto const proxy = std::find_if( proxies.begin(), proxies.end(), [&] (SceneIndex::Proxy aProxy) {
+					return index.object( aProxy ) == hit.object;
+				} );
+				REQUIRE( proxy != proxies.end() );
+				REQUIRE( intersect_ray( index.fat_bounds( *proxy ), origin, invDir, maxDistance ) == closest );
+			}
+		}
+
+		REQUIRE( hits > 0 );
+	}
+}
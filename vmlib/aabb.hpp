@@ -0,0 +1,143 @@
+#ifndef AABB_HPP_3C8E1F52_A6D4_4B97_8E20_5F19D7A3C46B
+#define AABB_HPP_3C8E1F52_A6D4_4B97_8E20_5F19D7A3C46B
+
+#include <algorithm>
+
+#include <cmath>
+#include <limits>
+
+#include "vec3.hpp"
+#include "mat44.hpp"
+
+/** Aabb: axis-aligned bounding box
+ *
+ * The box spans [min, max] along each axis. A box with min > max (see
+ * kEmptyAabb) contains nothing; extending it with a box or point gives that
+ * box or point.
+ */
+struct Aabb
+{
+	Vec3f min, max;
+};
+
+constexpr Aabb kEmptyAabb = {
+	{ std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() },
+	{ -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() }
+};
+
+constexpr
+Aabb aabb_union( Aabb const& aLeft, Aabb const& aRight ) noexcept
+{
+	return Aabb{
+		{ std::min( aLeft.min.x, aRight.min.x ), std::min( aLeft.min.y, aRight.min.y ), std::min( aLeft.min.z, aRight.min.z ) },
+		{ std::max( aLeft.max.x, aRight.max.x ), std::max( aLeft.max.y, aRight.max.y ), std::max( aLeft.max.z, aRight.max.z ) }
+	};
+}
+
+constexpr
+Aabb aabb_union( Aabb const& aBox, Vec3f aPoint ) noexcept
+{
+	return aabb_union( aBox, Aabb{ aPoint, aPoint } );
+}
+
+// Grows the box by aMargin on each side
+constexpr
+Aabb aabb_inflate( Aabb const& aBox, float aMargin ) noexcept
+{
+	Vec3f const margin{ aMargin, aMargin, aMargin };
+	return Aabb{ aBox.min - margin, aBox.max + margin };
+}
+
+// Is aInner completely inside of aOuter?
+constexpr
+bool contains( Aabb const& aOuter, Aabb const& aInner ) noexcept
+{
+	return aOuter.min.x <= aInner.min.x && aOuter.min.y <= aInner.min.y && aOuter.min.z <= aInner.min.z
+		&& aInner.max.x <= aOuter.max.x && aInner.max.y <= aOuter.max.y && aInner.max.z <= aOuter.max.z
+	;
+}
+
+constexpr
+bool overlaps( Aabb const& aLeft, Aabb const& aRight ) noexcept
+{
+	return aLeft.min.x <= aRight.max.x && aRight.min.x <= aLeft.max.x
+		&& aLeft.min.y <= aRight.max.y && aRight.min.y <= aLeft.max.y
+		&& aLeft.min.z <= aRight.max.z && aRight.min.z <= aLeft.max.z
+	;
+}
+
+constexpr
+Vec3f center( Aabb const& aBox ) noexcept
+{
+	return (aBox.min + aBox.max) * 0.5f;
+}
+
+constexpr
+float surface_area( Aabb const& aBox ) noexcept
+{
+	Vec3f const d = aBox.max - aBox.min;
+	return 2.f * (d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+// Squared distance from aPoint to the closest point of the box (zero inside)
+constexpr
+float distance_squared( Aabb const& aBox, Vec3f aPoint ) noexcept
+{
+	Vec3f const closest{
+		std::clamp( aPoint.x, aBox.min.x, aBox.max.x ),
+		std::clamp( aPoint.y, aBox.min.y, aBox.max.y ),
+		std::clamp( aPoint.z, aBox.min.z, aBox.max.z )
+	};
+	Vec3f const d = aPoint - closest;
+	return dot( d, d );
+}
+
+/* Ray - box intersection (slab test). aInvDir is the componentwise inverse
+ * of the ray direction (infinite for zero components). Returns the distance,
+ * in units of the direction's length, at which the ray enters the box (zero
+ * if it starts inside), or a negative value if it misses the box within
+ * [0, aMaxT].
+ */
+inline
+float intersect_ray( Aabb const& aBox, Vec3f aOrigin, Vec3f aInvDir, float aMaxT ) noexcept
+{
+	float tmin = 0.f, tmax = aMaxT;
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		float t0 = (aBox.min[i] - aOrigin[i]) * aInvDir[i];
+		float t1 = (aBox.max[i] - aOrigin[i]) * aInvDir[i];
+		if( t0 > t1 )
+			std::swap( t0, t1 );
+
+		// NaN (origin on a slab plane of a parallel ray) keeps the bounds
+		tmin = t0 > tmin ? t0 : tmin;
+		tmax = t1 < tmax ? t1 : tmax;
+		if( tmin > tmax )
+			return -1.f;
+	}
+	return tmin;
+}
+
+// Bounds of the box transformed by aTransform (an affine transform). See
+// J. Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems, 1990.
+inline
+Aabb transform( Mat44f const& aTransform, Aabb const& aBox ) noexcept
+{
+	Aabb ret{
+		{ aTransform(0,3), aTransform(1,3), aTransform(2,3) },
+		{ aTransform(0,3), aTransform(1,3), aTransform(2,3) }
+	};
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			float const a = aTransform(i,j) * aBox.min[j];
+			float const b = aTransform(i,j) * aBox.max[j];
+			ret.min[i] += std::min( a, b );
+			ret.max[i] += std::max( a, b );
+		}
+	}
+	return ret;
+}
+
+#endif // AABB_HPP_3C8E1F52_A6D4_4B97_8E20_5F19D7A3C46B
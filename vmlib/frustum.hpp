@@ -0,0 +1,91 @@
+#ifndef FRUSTUM_HPP_A79D2E04_5C1B_4F83_B6E7_0D4C92F81A35
+#define FRUSTUM_HPP_A79D2E04_5C1B_4F83_B6E7_0D4C92F81A35
+
+#include <cmath>
+
+#include "vec3.hpp"
+#include "vec4.hpp"
+#include "mat44.hpp"
+#include "aabb.hpp"
+
+/** Frustum: the six planes of a view volume
+ *
+ * Each plane is (n, d) with the normal n pointing into the volume, i.e. a
+ * point p is on the inside of the plane if dot(n,p) + d >= 0. Planes are
+ * normalized, so that dot(n,p) + d is the signed distance from the plane.
+ */
+struct Frustum
+{
+	Vec4f planes[6]; // left, right, bottom, top, near, far
+};
+
+/* Extracts the planes from a projection matrix (G. Gribb, K. Hartmann,
+ * "Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+ * Matrix", 2001). With aProj = projection * world2camera, the planes are in
+ * world space.
+ */
+inline
+Frustum make_frustum( Mat44f const& aProj ) noexcept
+{
+	auto const row_ = [&] (std::size_t aI) {
+		return Vec4f{ aProj(aI,0), aProj(aI,1), aProj(aI,2), aProj(aI,3) };
+	};
+
+	Vec4f const r0 = row_( 0 ), r1 = row_( 1 ), r2 = row_( 2 ), r3 = row_( 3 );
+
+	Frustum ret{ {
+		r3 + r0, r3 - r0,
+		r3 + r1, r3 - r1,
+		r3 + r2, r3 - r2
+	} };
+
+	for( auto& plane : ret.planes )
+	{
+		float const len = length( Vec3f{ plane.x, plane.y, plane.z } );
+		plane /= len;
+	}
+
+	return ret;
+}
+
+// Is the box (at least partially) inside of the frustum? Conservative: boxes
+// near a corner of the frustum may be reported as inside although they are
+// not.
+inline
+bool intersects( Frustum const& aFrustum, Aabb const& aBox ) noexcept
+{
+	for( auto const& plane : aFrustum.planes )
+	{
+		// The corner of the box furthest along the plane's normal
+		Vec3f const corner{
+			plane.x >= 0.f ? aBox.max.x : aBox.min.x,
+			plane.y >= 0.f ? aBox.max.y : aBox.min.y,
+			plane.z >= 0.f ? aBox.max.z : aBox.min.z
+		};
+
+		if( plane.x*corner.x + plane.y*corner.y + plane.z*corner.z + plane.w < 0.f )
+			return false;
+	}
+	return true;
+}
+
+// Is the box completely inside of the frustum?
+inline
+bool contains( Frustum const& aFrustum, Aabb const& aBox ) noexcept
+{
+	for( auto const& plane : aFrustum.planes )
+	{
+		// The corner of the box furthest against the plane's normal
+		Vec3f const corner{
+			plane.x >= 0.f ? aBox.min.x : aBox.max.x,
+			plane.y >= 0.f ? aBox.min.y : aBox.max.y,
+			plane.z >= 0.f ? aBox.min.z : aBox.max.z
+		};
+
+		if( plane.x*corner.x + plane.y*corner.y + plane.z*corner.z + plane.w < 0.f )
+			return false;
+	}
+	return true;
+}
+
+#endif // FRUSTUM_HPP_A79D2E04_5C1B_4F83_B6E7_0D4C92F81A35